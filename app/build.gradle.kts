@@ -42,6 +42,10 @@ android {
     buildFeatures {
         viewBinding = true
     }
+    androidResources {
+        // 训练语料需要通过openFd交给native层读取
+        noCompress += "txt"
+    }
 }
 
 dependencies {
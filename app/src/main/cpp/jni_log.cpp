@@ -1,48 +1,60 @@
 #include "jni_log.h"
+#include <algorithm>
 #include <cstdarg>
+#include <cstdio>
 #include <cstring>
-#include <sstream>
+#include <memory>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+
+static_assert(LOG_VERBOSE == ANDROID_LOG_VERBOSE && LOG_FATAL == ANDROID_LOG_FATAL,
+              "LogLevel must match android_LogPriority");
+#endif
+
+// 栈上格式化缓冲区的大小，足够容纳绝大多数日志
+static const size_t LOG_BUFFER_SIZE = 512;
 
 // 静态成员初始化
-bool JniLog::s_isEnable = true;
+std::atomic<bool> JniLog::s_isEnable{true};
+std::atomic<LogSink> JniLog::s_sink{JniLog::defaultSink};
 bool JniLog::s_showThreadId = true;
 bool JniLog::s_showFileLine = true;
 
-std::string JniLog::getThreadId() {
-    std::stringstream ss;
-    ss << pthread_self();  // 获取当前线程ID
-    return ss.str();
+void JniLog::defaultSink(LogLevel level, const char *tag, const char *message) {
+#ifdef __ANDROID__
+    __android_log_write(level, tag, message);
+#else
+    static const char LEVEL_NAMES[] = "??VDIWEF";
+    char name = level >= LOG_VERBOSE && level <= LOG_FATAL ? LEVEL_NAMES[level] : '?';
+    fprintf(stderr, "%c/%s: %s\n", name, tag, message);
+#endif
 }
 
-std::string JniLog::formatPrefix(const char* file, int line) {
-    std::string prefix;
+size_t JniLog::formatPrefix(char *buffer, size_t size, const char *file, int line) {
+    size_t length = 0;
 
     // 添加线程ID
     if (s_showThreadId) {
-        prefix += "[" + getThreadId() + "] ";
+        int written = snprintf(buffer, size, "[%lu] ", (unsigned long) pthread_self());
+        if (written > 0) length = std::min((size_t) written, size - 1);
     }
 
     // 添加文件名和行号
     if (s_showFileLine) {
         // 提取文件名（去掉路径，只保留文件名）
-        const char* fileName = strrchr(file, '/');
-        if (fileName) {
-            fileName++;  // 跳过 '/'
-        } else {
-            fileName = file;  // 如果没有路径分隔符，直接使用文件名
-        }
-
-        // 拼接文件名和行号
-        std::stringstream ss;
-        ss << "[" << fileName << ":" << line << "] ";
-        prefix += ss.str();
+        const char *fileName = strrchr(file, '/');
+        fileName = fileName ? fileName + 1 : file;
+
+        int written = snprintf(buffer + length, size - length, "[%s:%d] ", fileName, line);
+        if (written > 0) length = std::min(length + written, size - 1);
     }
 
-    return prefix;
+    return length;
 }
 
-void JniLog::log(LogLevel level, const char* tag, const char* file, int line,
-                 const char* format, ...) {
+void JniLog::log(LogLevel level, const char *tag, const char *file, int line,
+                 const char *format, ...) {
     if (!JniLog::s_isEnable) {
         return;
     }
@@ -51,35 +63,28 @@ void JniLog::log(LogLevel level, const char* tag, const char* file, int line,
         return;
     }
 
-    // 格式化日志前缀（线程ID、文件行号）
-    std::string prefix = formatPrefix(file, line);
+    // 通常一次格式化到栈上的缓冲区即可，只有超长的日志才再分配一次堆内存
+    char buffer[LOG_BUFFER_SIZE];
+    size_t prefixLength = formatPrefix(buffer, sizeof(buffer), file, line);
 
-    // 处理可变参数
     va_list args;
     va_start(args, format);
-
-    // 计算日志内容长度
-    int contentLength = vsnprintf(nullptr, 0, format, args) + 1;  // +1 包含终止符
-    va_end(args);  // 重置可变参数列表
-
-    // 分配缓冲区：前缀长度 + 日志内容长度
-    int totalLength = prefix.length() + contentLength;
-    char* logBuffer = new char[totalLength];
-    if (!logBuffer) {
+    int contentLength = vsnprintf(buffer + prefixLength, sizeof(buffer) - prefixLength,
+                                  format, args);
+    va_end(args);
+    if (contentLength < 0) {
         return;
     }
 
-    // 复制前缀到缓冲区
-    strcpy(logBuffer, prefix.c_str());
+    if (prefixLength + contentLength < sizeof(buffer)) {
+        s_sink.load()(level, tag, buffer);
+        return;
+    }
 
-    // 格式化日志内容到缓冲区
+    std::unique_ptr<char[]> logBuffer(new char[prefixLength + contentLength + 1]);
+    memcpy(logBuffer.get(), buffer, prefixLength);
     va_start(args, format);
-    vsnprintf(logBuffer + prefix.length(), contentLength, format, args);
+    vsnprintf(logBuffer.get() + prefixLength, contentLength + 1, format, args);
     va_end(args);
-
-    // 输出到Android日志系统
-    __android_log_write(level, tag, logBuffer);
-
-    // 释放缓冲区
-    delete[] logBuffer;
+    s_sink.load()(level, tag, logBuffer.get());
 }
@@ -1,27 +1,35 @@
 #ifndef JNI_LOG_H
 #define JNI_LOG_H
 
-#include <android/log.h>
 #include <pthread.h>
-#include <string>
+#include <atomic>
+#include <cstddef>
 
 // 日志标签，可根据项目修改
 #ifndef LOG_TAG
 #define LOG_TAG "NgramNative"
 #endif
 
-// 日志级别定义
+// 日志级别定义，取值与Android的ANDROID_LOG_*相同
 enum LogLevel {
-    LOG_VERBOSE = ANDROID_LOG_VERBOSE,
-    LOG_DEBUG = ANDROID_LOG_DEBUG,
-    LOG_INFO = ANDROID_LOG_INFO,
-    LOG_WARN = ANDROID_LOG_WARN,
-    LOG_ERROR = ANDROID_LOG_ERROR,
-    LOG_FATAL = ANDROID_LOG_FATAL
+    LOG_VERBOSE = 2,
+    LOG_DEBUG = 3,
+    LOG_INFO = 4,
+    LOG_WARN = 5,
+    LOG_ERROR = 6,
+    LOG_FATAL = 7
 };
 
+// 日志输出后端，message已包含线程ID和文件行号前缀
+using LogSink = void (*)(LogLevel level, const char *tag, const char *message);
+
 class JniLog {
 public:
+    // 替换日志输出后端，传入nullptr恢复默认：Android上写入logcat，其他平台写入stderr
+    static void setSink(LogSink sink) { s_sink = sink ? sink : defaultSink; }
+
+    static void defaultSink(LogLevel level, const char *tag, const char *message);
+
     static void isEnableLogging(bool isEnable) { s_isEnable = isEnable; }
 
     // 配置日志是否显示线程ID
@@ -32,34 +40,43 @@ public:
 
     // 核心日志函数
     static void log(LogLevel level, const char *tag, const char *file, int line,
-                    const char *format, ...);
+                    const char *format, ...) __attribute__((format(printf, 5, 6)));
 
 private:
-    static bool s_isEnable;
+    static std::atomic<bool> s_isEnable;  // 可能在其他线程记录日志时被修改
+    static std::atomic<LogSink> s_sink;
     static bool s_showThreadId;  // 是否显示线程ID
     static bool s_showFileLine;  // 是否显示文件和行号
 
-    // 获取当前线程ID字符串
-    static std::string getThreadId();
-
-    // 格式化日志前缀（线程ID、文件行号）
-    static std::string formatPrefix(const char *file, int line);
+    // 把前缀（线程ID、文件行号）写入buffer，返回写入的长度
+    static size_t formatPrefix(char *buffer, size_t size, const char *file, int line);
 };
 
+// 编译时的最低日志级别，低于此级别的日志调用连同参数求值一起被编译器删除（仍做格式检查）。
+// 由CMake的PREDICTOR_LOG_LEVEL设置，默认全部保留
+#ifndef NGRAM_LOG_LEVEL
+#define NGRAM_LOG_LEVEL LOG_VERBOSE
+#endif
+
+#define NGRAM_LOG(level, tag, ...) \
+    do { \
+        if ((level) >= NGRAM_LOG_LEVEL) JniLog::log(level, tag, __FILE__, __LINE__, __VA_ARGS__); \
+    } while (0)
+
 // 日志宏定义 - 自动包含文件名和行号，使用默认标签
-#define LOGV(...) JniLog::log(LOG_VERBOSE, LOG_TAG, __FILE__, __LINE__, __VA_ARGS__)
-#define LOGD(...) JniLog::log(LOG_DEBUG, LOG_TAG, __FILE__, __LINE__, __VA_ARGS__)
-#define LOGI(...) JniLog::log(LOG_INFO, LOG_TAG, __FILE__, __LINE__, __VA_ARGS__)
-#define LOGW(...) JniLog::log(LOG_WARN, LOG_TAG, __FILE__, __LINE__, __VA_ARGS__)
-#define LOGE(...) JniLog::log(LOG_ERROR, LOG_TAG, __FILE__, __LINE__, __VA_ARGS__)
-#define LOGF(...) JniLog::log(LOG_FATAL, LOG_TAG, __FILE__, __LINE__, __VA_ARGS__)
+#define LOGV(...) NGRAM_LOG(LOG_VERBOSE, LOG_TAG, __VA_ARGS__)
+#define LOGD(...) NGRAM_LOG(LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) NGRAM_LOG(LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) NGRAM_LOG(LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) NGRAM_LOG(LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGF(...) NGRAM_LOG(LOG_FATAL, LOG_TAG, __VA_ARGS__)
 
 // 日志宏定义 - 支持自定义标签
-#define LOGV_TAG(tag, ...) JniLog::log(LOG_VERBOSE, tag, __FILE__, __LINE__, __VA_ARGS__)
-#define LOGD_TAG(tag, ...) JniLog::log(LOG_DEBUG, tag, __FILE__, __LINE__, __VA_ARGS__)
-#define LOGI_TAG(tag, ...) JniLog::log(LOG_INFO, tag, __FILE__, __LINE__, __VA_ARGS__)
-#define LOGW_TAG(tag, ...) JniLog::log(LOG_WARN, tag, __FILE__, __LINE__, __VA_ARGS__)
-#define LOGE_TAG(tag, ...) JniLog::log(LOG_ERROR, tag, __FILE__, __LINE__, __VA_ARGS__)
-#define LOGF_TAG(tag, ...) JniLog::log(LOG_FATAL, tag, __FILE__, __LINE__, __VA_ARGS__)
+#define LOGV_TAG(tag, ...) NGRAM_LOG(LOG_VERBOSE, tag, __VA_ARGS__)
+#define LOGD_TAG(tag, ...) NGRAM_LOG(LOG_DEBUG, tag, __VA_ARGS__)
+#define LOGI_TAG(tag, ...) NGRAM_LOG(LOG_INFO, tag, __VA_ARGS__)
+#define LOGW_TAG(tag, ...) NGRAM_LOG(LOG_WARN, tag, __VA_ARGS__)
+#define LOGE_TAG(tag, ...) NGRAM_LOG(LOG_ERROR, tag, __VA_ARGS__)
+#define LOGF_TAG(tag, ...) NGRAM_LOG(LOG_FATAL, tag, __VA_ARGS__)
 
 #endif // JNI_LOG_H
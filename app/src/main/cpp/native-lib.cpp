@@ -1,42 +1,315 @@
 #include <jni.h>
+#include <pthread.h>
 #include <string>
 #include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_set>
+#include <cstring>
 
 #include "ngram_model.h"
+#include "ngram_predict.h"
+#include "ngram_session.h"
 #include "jni_log.h"
 
-// 存储TextPredictor实例的映射
-static std::unordered_map<jlong, std::unique_ptr<TextPredictor>> predictors;
-static jlong next_predictor_id = 1;
+// TextPredictor句柄表：查找只持有读锁并复制shared_ptr，调用期间即使其他线程
+// destroyPredictor，实例也要等最后一个使用者释放引用后才会析构
+static std::shared_mutex predictors_mutex;
+static std::unordered_map<jlong, std::shared_ptr<TextPredictor>> predictors;
+static std::atomic<jlong> next_predictor_id{1};
+
+static std::shared_ptr<TextPredictor> find_predictor(jlong predictor_id) {
+    std::shared_lock<std::shared_mutex> lock(predictors_mutex);
+    auto it = predictors.find(predictor_id);
+    return it == predictors.end() ? nullptr : it->second;
+}
+
+static jlong register_predictor(std::shared_ptr<TextPredictor> predictor) {
+    jlong id = next_predictor_id++;
+    std::unique_lock<std::shared_mutex> lock(predictors_mutex);
+    predictors[id] = std::move(predictor);
+    return id;
+}
+
+// destroyPredictor交给后台线程释放、尚未析构完的预测器的模型路径。析构会训练完排队的历史并保存，
+// 同一路径上重新创建的预测器要等它写完文件，否则两个实例会同时写同一组文件
+static std::mutex retiring_mutex;
+static std::condition_variable retiring_cv;
+static std::unordered_multiset<std::string> retiring_paths;
+
+static void wait_for_retired(const std::string &model_path) {
+    std::unique_lock<std::mutex> lock(retiring_mutex);
+    retiring_cv.wait(lock, [&model_path] { return retiring_paths.count(model_path) == 0; });
+}
+
+// 输入会话句柄表，规则同predictors；会话持有预测器的引用
+static std::shared_mutex sessions_mutex;
+static std::unordered_map<jlong, std::shared_ptr<TypingSession>> sessions;
+static std::atomic<jlong> next_session_id{1};
+
+static std::shared_ptr<TypingSession> find_session(jlong session_id) {
+    std::shared_lock<std::shared_mutex> lock(sessions_mutex);
+    auto it = sessions.find(session_id);
+    return it == sessions.end() ? nullptr : it->second;
+}
+
+// JNI_OnLoad中解析一次，类保存为全局引用，预测路径上不再调用FindClass/GetMethodID
+static jclass pair_class = nullptr;
+static jmethodID pair_constructor = nullptr;
+static jclass double_class = nullptr;
+static jmethodID double_constructor = nullptr;
+static jclass string_class = nullptr;
+
+static jclass find_global_class(JNIEnv *env, const char *name) {
+    jclass local = env->FindClass(name);
+    if (!local) return nullptr;
+    auto global = static_cast<jclass>(env->NewGlobalRef(local));
+    env->DeleteLocalRef(local);
+    return global;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM *vm, void *reserved) {
+    (void) reserved;
+
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+
+    pair_class = find_global_class(env, "android/util/Pair");
+    double_class = find_global_class(env, "java/lang/Double");
+    string_class = find_global_class(env, "java/lang/String");
+    if (!pair_class || !double_class || !string_class) {
+        LOGE("Failed to resolve JNI classes");
+        return JNI_ERR;
+    }
+    pair_constructor = env->GetMethodID(pair_class, "<init>",
+                                        "(Ljava/lang/Object;Ljava/lang/Object;)V");
+    double_constructor = env->GetMethodID(double_class, "<init>", "(D)V");
+    if (!pair_constructor || !double_constructor) {
+        LOGE("Failed to resolve JNI methods");
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_6;
+}
+
+// 把标准UTF-8转换为Java字符串。模型中的单词可能含4字节字符，NewStringUTF只接受modified UTF-8，
+// 因此先解码为UTF-16（补充平面字符编码为代理对，无效字节替换为U+FFFD）再调用NewString
+static jstring new_java_string(JNIEnv *env, std::string_view text) {
+    static thread_local std::vector<jchar> chars;
+    chars.clear();
+
+    const auto *bytes = reinterpret_cast<const uint8_t *>(text.data());
+    size_t size = text.size();
+    for (size_t i = 0; i < size;) {
+        uint32_t c = bytes[i];
+        int length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+        bool valid = length > 0 && i + length <= size;
+        if (valid && length > 1) {
+            c &= 0x7F >> length;
+            for (int k = 1; k < length; ++k) {
+                if ((bytes[i + k] & 0xC0) != 0x80) {
+                    valid = false;
+                    break;
+                }
+                c = (c << 6) | (bytes[i + k] & 0x3F);
+            }
+            // 拒绝过长编码、代理项和超出范围的码点
+            static const uint32_t min_code_point[] = {0, 0, 0x80, 0x800, 0x10000};
+            valid = valid && c >= min_code_point[length] && c <= 0x10FFFF &&
+                    (c < 0xD800 || c > 0xDFFF);
+        }
+        if (!valid) {
+            chars.push_back(0xFFFD);
+            ++i;
+            continue;
+        }
+
+        if (c >= 0x10000) {
+            c -= 0x10000;
+            chars.push_back(static_cast<jchar>(0xD800 + (c >> 10)));
+            chars.push_back(static_cast<jchar>(0xDC00 + (c & 0x3FF)));
+        } else {
+            chars.push_back(static_cast<jchar>(c));
+        }
+        i += length;
+    }
+    return env->NewString(chars.data(), static_cast<jsize>(chars.size()));
+}
+
+// 转换为android.util.Pair<String, Double>数组，单词为std::string或PredictionView
+template<typename Results>
+static jobjectArray to_pair_array(JNIEnv *env, const Results &results) {
+    jobjectArray result_array = env->NewObjectArray(results.size(), pair_class, nullptr);
+    if (!result_array) return nullptr;
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        jstring word = new_java_string(env, std::string_view(results[i].first));
+        jobject prob_obj = env->NewObject(double_class, double_constructor,
+                                          (jdouble) results[i].second);
+
+        jobject pair = env->NewObject(pair_class, pair_constructor, word, prob_obj);
+        env->SetObjectArrayElement(result_array, i, pair);
+
+        env->DeleteLocalRef(word);
+        env->DeleteLocalRef(prob_obj);
+        env->DeleteLocalRef(pair);
+    }
+    return result_array;
+}
+
+// 把Java字符串按标准UTF-8编码复制到out（复用其容量），null按空字符串处理。
+// 与GetStringUTFChars的modified UTF-8不同，代理对编码为4字节字符，单独的代理项替换为U+FFFD。
+// 所有传入模型的字符串都经过这里，保证各入口的分词一致
+static void copy_utf16_as_utf8(JNIEnv *env, jstring text, std::string &out) {
+    out.clear();
+    if (!text) return;
+
+    static thread_local std::vector<jchar> chars;
+    jsize length = env->GetStringLength(text);
+    chars.resize(length);
+    env->GetStringRegion(text, 0, length, chars.data());
+
+    out.reserve(length * 3);
+    for (jsize i = 0; i < length; ++i) {
+        uint32_t c = chars[i];
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < length &&
+            chars[i + 1] >= 0xDC00 && chars[i + 1] <= 0xDFFF) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (chars[++i] - 0xDC00);
+        } else if (c >= 0xD800 && c <= 0xDFFF) {
+            c = 0xFFFD;
+        }
+
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+        } else if (c < 0x800) {
+            out += static_cast<char>(0xC0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out += static_cast<char>(0xE0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (c >> 18));
+            out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+}
+
+// 后台线程第一次回调时附加到JVM，直到线程退出时才由线程局部键的析构函数分离。
+// 每次回调都附加再分离会为每次进度报告创建一个新的java.lang.Thread
+static pthread_key_t detach_key;
+static pthread_once_t detach_key_once = PTHREAD_ONCE_INIT;
+
+static void detach_current_thread(void *vm) {
+    static_cast<JavaVM *>(vm)->DetachCurrentThread();
+}
+
+static void create_detach_key() {
+    pthread_key_create(&detach_key, detach_current_thread);
+}
+
+// 持有Java监听器的全局引用，回调可能发生在后台训练线程
+class JavaTrainingListener {
+public:
+    JavaTrainingListener(JNIEnv *env, jobject listener) {
+        env->GetJavaVM(&vm_);
+        listener_ = env->NewGlobalRef(listener);
+        jclass clazz = env->GetObjectClass(listener);
+        on_progress_ = env->GetMethodID(clazz, "onTrainingProgress", "(IZZ)V");
+        env->DeleteLocalRef(clazz);
+    }
+
+    ~JavaTrainingListener() {
+        with_env([this](JNIEnv *env) { env->DeleteGlobalRef(listener_); });
+    }
+
+    void operator()(int progress, bool finished, bool success) {
+        if (!on_progress_) return;
+        with_env([&](JNIEnv *env) {
+            env->CallVoidMethod(listener_, on_progress_, (jint) progress,
+                                finished ? JNI_TRUE : JNI_FALSE, success ? JNI_TRUE : JNI_FALSE);
+            if (env->ExceptionCheck()) {
+                LOGE("Training listener threw an exception");
+                env->ExceptionClear();
+            }
+        });
+    }
+
+private:
+    JavaVM *vm_ = nullptr;
+    jobject listener_ = nullptr;
+    jmethodID on_progress_ = nullptr;
+
+    // 未附加到JVM的线程附加一次，线程退出时自动分离
+    template<typename F>
+    void with_env(F f) {
+        JNIEnv *env = nullptr;
+        if (vm_->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) != JNI_OK) {
+            if (vm_->AttachCurrentThread(&env, nullptr) != JNI_OK) return;
+            pthread_once(&detach_key_once, create_detach_key);
+            pthread_setspecific(detach_key, vm_);
+        }
+        f(env);
+    }
+};
 
 extern "C" JNIEXPORT jlong JNICALL
 Java_com_tokyonth_textpredictor_TextPredictorNative_createPredictor(
         JNIEnv *env, jobject thiz, jstring model_path, jint n, jobjectArray sample_texts) {
     (void) thiz;
 
-    const char *path = env->GetStringUTFChars(model_path, nullptr);
-    if (!path) return 0;
+    if (!model_path) return 0;
+    std::string path;
+    copy_utf16_as_utf8(env, model_path, path);
 
     std::vector<std::string> samples;
     if (sample_texts) {
         jsize len = env->GetArrayLength(sample_texts);
         for (jsize i = 0; i < len; ++i) {
             auto text = (jstring) env->GetObjectArrayElement(sample_texts, i);
-            const char *ctext = env->GetStringUTFChars(text, nullptr);
-            if (ctext) {
-                samples.emplace_back(ctext);
-                env->ReleaseStringUTFChars(text, ctext);
+            if (text) {
+                samples.emplace_back();
+                copy_utf16_as_utf8(env, text, samples.back());
+                env->DeleteLocalRef(text);
             }
-            env->DeleteLocalRef(text);
         }
     }
 
-    jlong id = next_predictor_id++;
-    predictors[id] = std::make_unique<TextPredictor>(
-            std::string(path), n, samples.empty() ? nullptr : &samples);
+    wait_for_retired(path);
+    auto predictor = std::make_shared<TextPredictor>(
+            path, n, samples.empty() ? nullptr : &samples);
 
-    env->ReleaseStringUTFChars(model_path, path);
-    return id;
+    return register_predictor(std::move(predictor));
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_createPredictorFromFd(
+        JNIEnv *env, jobject thiz, jstring model_path, jint n,
+        jint corpus_fd, jlong corpus_offset, jlong corpus_length, jint training_threads) {
+    (void) thiz;
+
+    if (!model_path) return 0;
+    std::string path;
+    copy_utf16_as_utf8(env, model_path, path);
+
+    wait_for_retired(path);
+    auto predictor = std::make_shared<TextPredictor>(path, n);
+    predictor->set_training_threads(training_threads);
+
+    // 直接在native层分块读取语料，不经过Java字符串数组
+    if (corpus_fd >= 0) {
+        predictor->train_corpus(corpus_fd, corpus_offset, corpus_length);
+    }
+
+    return register_predictor(std::move(predictor));
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -44,14 +317,12 @@ Java_com_tokyonth_textpredictor_TextPredictorNative_addToHistory(
         JNIEnv *env, jobject thiz, jlong predictor_id, jstring text) {
     (void) thiz;
 
-    auto it = predictors.find(predictor_id);
-    if (it == predictors.end()) return;
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor || !text) return;
 
-    const char *ctext = env->GetStringUTFChars(text, nullptr);
-    if (ctext) {
-        it->second->add_to_history(std::string(ctext));
-        env->ReleaseStringUTFChars(text, ctext);
-    }
+    std::string buffer;
+    copy_utf16_as_utf8(env, text, buffer);
+    predictor->add_to_history(buffer);
 }
 
 extern "C" JNIEXPORT jobjectArray JNICALL
@@ -59,40 +330,227 @@ Java_com_tokyonth_textpredictor_TextPredictorNative_predict(
         JNIEnv *env, jobject thiz, jlong predictor_id, jstring context, jint num_predictions) {
     (void) thiz;
 
-    auto it = predictors.find(predictor_id);
-    if (it == predictors.end()) return nullptr;
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor || !context) return nullptr;
 
-    const char *ccontext = env->GetStringUTFChars(context, nullptr);
-    if (!ccontext) return nullptr;
+    auto snapshot = predictor->snapshot();
+    if (!snapshot) return to_pair_array(env, std::vector<PredictionView>());
 
-    auto results = it->second->predict(std::string(ccontext), num_predictions);
-    env->ReleaseStringUTFChars(context, ccontext);
+    auto &scratch = PredictScratch::local();
+    copy_utf16_as_utf8(env, context, scratch.text);
+    snapshot->predict_views(scratch.text, num_predictions, scratch.results);
 
-    // 创建结果数组
-    jclass pair_class = env->FindClass("android/util/Pair");
-    jmethodID pair_constructor = env->GetMethodID(pair_class, "<init>",
-                                                  "(Ljava/lang/Object;Ljava/lang/Object;)V");
+    return to_pair_array(env, scratch.results);
+}
 
-    jobjectArray result_array = env->NewObjectArray(results.size(), pair_class, nullptr);
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_completeWord(
+        JNIEnv *env, jobject thiz, jlong predictor_id, jstring text, jint num_completions) {
+    (void) thiz;
 
-    for (size_t i = 0; i < results.size(); ++i) {
-        jstring word = env->NewStringUTF(results[i].first.c_str());
-        jdouble prob = results[i].second;
-        jobject prob_obj = env->NewObject(env->FindClass("java/lang/Double"),
-                                          env->GetMethodID(env->FindClass("java/lang/Double"),
-                                                           "<init>", "(D)V"),
-                                          prob);
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor || !text) return nullptr;
 
-        jobject pair = env->NewObject(pair_class, pair_constructor, word, prob_obj);
-        env->SetObjectArrayElement(result_array, i, pair);
+    auto &buffer = PredictScratch::local().text;
+    copy_utf16_as_utf8(env, text, buffer);
+    auto results = predictor->complete_word(buffer, num_completions);
 
-        env->DeleteLocalRef(word);
-        env->DeleteLocalRef(prob_obj);
-        env->DeleteLocalRef(pair);
+    return to_pair_array(env, results);
+}
+
+// 批量预测：第i个上下文的结果位于[i * num_predictions, (i + 1) * num_predictions)，
+// 不足的位置为null。probabilities不为null且长度足够时写入对应的概率
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_predictBatch(
+        JNIEnv *env, jobject thiz, jlong predictor_id, jobjectArray contexts,
+        jint num_predictions, jdoubleArray probabilities) {
+    (void) thiz;
+
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor || !contexts) return nullptr;
+
+    int num = std::max<jint>(num_predictions, 0);
+    jsize count = env->GetArrayLength(contexts);
+    int64_t total_slots = (int64_t) count * num;
+    if (total_slots > INT32_MAX) {
+        jclass exception = env->FindClass("java/lang/IllegalArgumentException");
+        if (exception) {
+            env->ThrowNew(exception, "contexts.size * numPredictions exceeds Int.MAX_VALUE");
+            env->DeleteLocalRef(exception);
+        }
+        return nullptr;
     }
+    auto slots = static_cast<jsize>(total_slots);
+    jobjectArray words = env->NewObjectArray(slots, string_class, nullptr);
+    if (!words) return nullptr;
+
+    bool write_probs = probabilities && env->GetArrayLength(probabilities) >= slots;
+    // 所有上下文使用同一个快照，单词在写入Java数组前一直有效
+    auto snapshot = predictor->snapshot();
+    auto &scratch = PredictScratch::local();
+    for (jsize i = 0; i < count; ++i) {
+        scratch.results.clear();
+        if (snapshot) {
+            auto context = static_cast<jstring>(env->GetObjectArrayElement(contexts, i));
+            copy_utf16_as_utf8(env, context, scratch.text);
+            if (context) env->DeleteLocalRef(context);
+            snapshot->predict_views(scratch.text, num, scratch.results);
+        }
 
-    env->DeleteLocalRef(pair_class);
-    return result_array;
+        for (int j = 0; j < num; ++j) {
+            jsize slot = i * num + j;  // 不超过slots，不会溢出
+            jdouble prob = 0.0;
+            if (j < (int) scratch.results.size()) {
+                jstring word = new_java_string(env, scratch.results[j].first);
+                env->SetObjectArrayElement(words, slot, word);
+                env->DeleteLocalRef(word);
+                prob = scratch.results[j].second;
+            }
+            if (write_probs) env->SetDoubleArrayRegion(probabilities, slot, 1, &prob);
+        }
+    }
+    return words;
+}
+
+// 批量预测写入调用方提供的direct ByteBuffer（本机字节序），不创建任何Java对象。
+// 每个上下文依次写入：int32 结果数，随后每个结果为
+// float32 概率、int32 UTF-8字节数、UTF-8字节（补齐到4字节）。
+// 返回写入的字节数；缓冲区不足时返回所需字节数的相反数，此时缓冲区内容无意义
+extern "C" JNIEXPORT jint JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_predictBatchToBuffer(
+        JNIEnv *env, jobject thiz, jlong predictor_id, jobjectArray contexts,
+        jint num_predictions, jobject buffer) {
+    (void) thiz;
+
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor || !contexts || !buffer) return 0;
+
+    auto *out = static_cast<uint8_t *>(env->GetDirectBufferAddress(buffer));
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (!out || capacity < 0) {
+        LOGE("predictBatchToBuffer requires a direct ByteBuffer");
+        return 0;
+    }
+
+    int num = std::max<jint>(num_predictions, 0);
+    jsize count = env->GetArrayLength(contexts);
+    auto snapshot = predictor->snapshot();
+    auto &scratch = PredictScratch::local();
+
+    // 边预测边写入；空间不足后只继续累计所需字节数
+    auto padded = [](size_t size) { return (size + 3) & ~static_cast<size_t>(3); };
+    size_t needed = 0;
+    auto put = [&](const void *data, size_t size, size_t padded_size) {
+        if (needed + padded_size <= (size_t) capacity) {
+            memcpy(out + needed, data, size);
+            memset(out + needed + size, 0, padded_size - size);
+        }
+        needed += padded_size;
+    };
+    for (jsize i = 0; i < count; ++i) {
+        scratch.results.clear();
+        if (snapshot) {
+            auto context = static_cast<jstring>(env->GetObjectArrayElement(contexts, i));
+            copy_utf16_as_utf8(env, context, scratch.text);
+            if (context) env->DeleteLocalRef(context);
+            snapshot->predict_views(scratch.text, num, scratch.results);
+        }
+
+        auto result_count = static_cast<int32_t>(scratch.results.size());
+        put(&result_count, sizeof(result_count), sizeof(result_count));
+        for (const auto &entry: scratch.results) {
+            auto prob = static_cast<float>(entry.second);
+            auto length = static_cast<int32_t>(entry.first.size());
+            put(&prob, sizeof(prob), sizeof(prob));
+            put(&length, sizeof(length), sizeof(length));
+            put(entry.first.data(), entry.first.size(), padded(entry.first.size()));
+        }
+    }
+    if (needed > (size_t) capacity || needed > INT32_MAX) {
+        return -static_cast<jint>(std::min(needed, (size_t) INT32_MAX));
+    }
+    return static_cast<jint>(needed);
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_createSession(
+        JNIEnv *env, jobject thiz, jlong predictor_id) {
+    (void) env;
+    (void) thiz;
+
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor) return 0;
+
+    jlong id = next_session_id++;
+    auto session = std::make_shared<TypingSession>(std::move(predictor));
+    std::unique_lock<std::shared_mutex> lock(sessions_mutex);
+    sessions[id] = std::move(session);
+    return id;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_sessionAppend(
+        JNIEnv *env, jobject thiz, jlong session_id, jstring text) {
+    (void) thiz;
+
+    auto session = find_session(session_id);
+    if (!session) return;
+
+    auto &buffer = PredictScratch::local().text;
+    copy_utf16_as_utf8(env, text, buffer);
+    session->append(buffer);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_sessionDeleteBackward(
+        JNIEnv *env, jobject thiz, jlong session_id, jint count) {
+    (void) env;
+    (void) thiz;
+
+    auto session = find_session(session_id);
+    if (!session || count <= 0) return;
+
+    session->delete_backward(count);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_sessionReset(
+        JNIEnv *env, jobject thiz, jlong session_id, jstring text) {
+    (void) thiz;
+
+    auto session = find_session(session_id);
+    if (!session) return;
+
+    auto &buffer = PredictScratch::local().text;
+    copy_utf16_as_utf8(env, text, buffer);
+    session->reset(buffer);
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_sessionSuggest(
+        JNIEnv *env, jobject thiz, jlong session_id, jint num_suggestions) {
+    (void) thiz;
+
+    auto session = find_session(session_id);
+    if (!session) return nullptr;
+
+    return to_pair_array(env, session->suggest(num_suggestions));
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_destroySession(
+        JNIEnv *env, jobject thiz, jlong session_id) {
+    (void) env;
+    (void) thiz;
+
+    std::shared_ptr<TypingSession> removed;
+    {
+        std::unique_lock<std::shared_mutex> lock(sessions_mutex);
+        auto it = sessions.find(session_id);
+        if (it == sessions.end()) return;
+        removed = std::move(it->second);
+        sessions.erase(it);
+    }
 }
 
 extern "C" JNIEXPORT jboolean JNICALL
@@ -101,10 +559,73 @@ Java_com_tokyonth_textpredictor_TextPredictorNative_forceTraining(
     (void) env;
     (void) thiz;
 
-    auto it = predictors.find(predictor_id);
-    if (it == predictors.end()) return JNI_FALSE;
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor) return JNI_FALSE;
+
+    return predictor->force_training() ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_setPruneOptions(
+        JNIEnv *env, jobject thiz, jlong predictor_id, jlong memory_budget, jint min_count) {
+    (void) env;
+    (void) thiz;
+
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor) return;
+
+    PruneOptions options;
+    options.memory_budget = memory_budget > 0 ? (size_t) memory_budget : 0;
+    options.min_count = min_count;
+    predictor->set_prune_options(options);
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_pruneModel(
+        JNIEnv *env, jobject thiz, jlong predictor_id) {
+    (void) env;
+    (void) thiz;
+
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor) return 0;
+
+    return (jlong) predictor->prune_model();
+}
+
+extern "C" JNIEXPORT jintArray JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_getTrainingStatus(
+        JNIEnv *env, jobject thiz, jlong predictor_id) {
+    (void) thiz;
+
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor) return nullptr;
+
+    // [状态, 进度, 已完成轮次, 上一轮是否成功]
+    TrainingStatus status = predictor->get_training_status();
+    jint values[4] = {status.state, status.progress, status.completed_rounds,
+                      status.last_succeeded ? 1 : 0};
+    jintArray result = env->NewIntArray(4);
+    env->SetIntArrayRegion(result, 0, 4, values);
+    return result;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_setTrainingListener(
+        JNIEnv *env, jobject thiz, jlong predictor_id, jobject listener) {
+    (void) thiz;
+
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor) return;
+
+    if (!listener) {
+        predictor->set_training_listener(nullptr);
+        return;
+    }
 
-    return it->second->force_training() ? JNI_TRUE : JNI_FALSE;
+    auto java_listener = std::make_shared<JavaTrainingListener>(env, listener);
+    predictor->set_training_listener([java_listener](int progress, bool finished, bool success) {
+        (*java_listener)(progress, finished, success);
+    });
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -113,9 +634,9 @@ Java_com_tokyonth_textpredictor_TextPredictorNative_clearHistory(
     (void) env;
     (void) thiz;
 
-    auto it = predictors.find(predictor_id);
-    if (it != predictors.end()) {
-        it->second->clear_history();
+    auto predictor = find_predictor(predictor_id);
+    if (predictor) {
+        predictor->clear_history();
     }
 }
 
@@ -124,13 +645,31 @@ Java_com_tokyonth_textpredictor_TextPredictorNative_getModelInfo(
         JNIEnv *env, jobject thiz, jlong predictor_id) {
     (void) thiz;
 
-    auto it = predictors.find(predictor_id);
-    if (it == predictors.end()) {
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor) {
         return env->NewStringUTF("No model available");
     }
 
-    std::string info = it->second->get_model_info();
-    return env->NewStringUTF(info.c_str());
+    std::string info = predictor->get_model_info();
+    return new_java_string(env, info);
+}
+
+// 运行统计，布局见ngram_stats.h中的STATS_*常量。会遍历模型统计各阶规模，不要在输入路径上调用
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_tokyonth_textpredictor_TextPredictorNative_getStats(
+        JNIEnv *env, jobject thiz, jlong predictor_id) {
+    (void) thiz;
+
+    auto predictor = find_predictor(predictor_id);
+    if (!predictor) return nullptr;
+
+    StatsArray stats = predictor->get_stats();
+    jlong values[STATS_SIZE];
+    std::copy(stats.begin(), stats.end(), values);
+    jlongArray result = env->NewLongArray(STATS_SIZE);
+    if (!result) return nullptr;
+    env->SetLongArrayRegion(result, 0, STATS_SIZE, values);
+    return result;
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -139,9 +678,32 @@ Java_com_tokyonth_textpredictor_TextPredictorNative_destroyPredictor(
     (void) env;
     (void) thiz;
 
-    LOGD("Destroying predictor: %ld", predictor_id);
+    LOGD("Destroying predictor: %lld", (long long) predictor_id);
 
-    predictors.erase(predictor_id);
+    std::shared_ptr<TextPredictor> removed;
+    {
+        std::unique_lock<std::shared_mutex> lock(predictors_mutex);
+        auto it = predictors.find(predictor_id);
+        if (it == predictors.end()) return;
+        removed = std::move(it->second);
+        predictors.erase(it);
+    }
+
+    // 析构要训练完排队的历史并等待后台线程，可能持续一整轮训练和保存。调用方通常是UI线程，
+    // 因此交给分离的线程释放；销毁后不再回调训练监听器。
+    // 仍有输入会话持有引用时，实例在最后一个会话销毁时才析构
+    removed->set_training_listener(nullptr);
+    std::string path = removed->model_path();
+    {
+        std::lock_guard<std::mutex> lock(retiring_mutex);
+        retiring_paths.insert(path);
+    }
+    std::thread([predictor = std::move(removed), path]() mutable {
+        predictor.reset();
+        std::lock_guard<std::mutex> lock(retiring_mutex);
+        retiring_paths.erase(retiring_paths.find(path));
+        retiring_cv.notify_all();
+    }).detach();
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -1,33 +1,311 @@
+#ifndef NGRAM_MODEL_DATA_H
+#define NGRAM_MODEL_DATA_H
+
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
+#include <deque>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <cstdint>
+#include "ngram_flat_map.h"
+
+// 单词ID，词汇表内稠密编号
+using WordId = uint32_t;
+
+// 未登录词
+const WordId INVALID_WORD_ID = UINT32_MAX;
+
+// 预测结果：单词指向模型内部以'\0'结尾的存储，模型（快照）释放前有效
+using PredictionView = std::pair<std::string_view, double>;
+
+// 词汇表：单词与ID的双向映射，每个单词只存储一份
+struct Vocabulary {
+    // deque扩容时不移动已有元素，ids中的string_view始终有效
+    std::deque<std::string> words;
+    std::unordered_map<std::string_view, WordId> ids;
+
+    Vocabulary() = default;
+
+    Vocabulary(Vocabulary &&) = default;
+
+    Vocabulary &operator=(Vocabulary &&) = default;
+
+    // 拷贝时ids需指向新的words
+    Vocabulary(const Vocabulary &other) : words(other.words) {
+        rebuild_index();
+    }
+
+    Vocabulary &operator=(const Vocabulary &other) {
+        if (this != &other) {
+            words = other.words;
+            rebuild_index();
+        }
+        return *this;
+    }
 
-// 哈希函数用于vector<string>作为unordered_map的键
-struct VectorHash {
-    size_t operator()(const std::vector<std::string> &v) const {
-        std::hash<std::string> hasher;
-        size_t seed = 0;
-        for (const auto &s: v) {
-            seed ^= hasher(s) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    void rebuild_index() {
+        ids.clear();
+        ids.reserve(words.size());
+        for (size_t i = 0; i < words.size(); ++i) {
+            ids.emplace(words[i], static_cast<WordId>(i));
         }
-        return seed;
+    }
+
+    size_t size() const { return words.size(); }
+
+    // 查找单词ID，不存在时返回INVALID_WORD_ID
+    WordId find(std::string_view word) const {
+        auto it = ids.find(word);
+        return it == ids.end() ? INVALID_WORD_ID : it->second;
+    }
+
+    // 查找或分配单词ID
+    WordId intern(std::string_view word) {
+        auto it = ids.find(word);
+        if (it != ids.end()) return it->second;
+
+        auto id = static_cast<WordId>(words.size());
+        words.emplace_back(word);
+        ids.emplace(words.back(), id);
+        return id;
+    }
+
+    const std::string &word(WordId id) const { return words[id]; }
+
+    void clear() {
+        ids.clear();
+        words.clear();
     }
 };
 
+// 每个上下文预先排好序的后继词数量，与界面上可选的最大预测数一致
+const int TOP_K_SUCCESSORS = 20;
+
+// 后继词ID -> 次数
+using SuccessorMap = FlatCountMap;
+
+// 排好序的前K个后继词，存放在所属上下文表的内存池中。
+// 容量按2的幂增长，最大为TOP_K_SUCCESSORS；不自行释放，由ContextEntry管理
+class RankedList {
+public:
+    using value_type = std::pair<WordId, int>;
+
+    RankedList() = default;
+
+    RankedList(const RankedList &) = delete;
+
+    RankedList(RankedList &&other) noexcept
+            : data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+        other.data_ = nullptr;
+        other.size_ = other.capacity_ = 0;
+    }
+
+    RankedList &operator=(RankedList &&other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+        return *this;
+    }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    value_type &operator[](size_t i) { return data_[i]; }
+
+    const value_type &operator[](size_t i) const { return data_[i]; }
+
+    value_type &back() { return data_[size_ - 1]; }
+
+    const value_type *begin() const { return data_; }
+
+    const value_type *end() const { return data_ + size_; }
+
+    void push_back(const value_type &entry, ModelArena &arena) {
+        if (size_ == capacity_) {
+            uint32_t capacity = capacity_ ? capacity_ * 2 : 1;
+            reallocate(std::min(capacity, (uint32_t) TOP_K_SUCCESSORS), arena);
+        }
+        data_[size_++] = entry;
+    }
+
+    // 替换为[first, last)，按实际大小分配
+    template<typename Iterator>
+    void assign(Iterator first, Iterator last, ModelArena &arena) {
+        size_t size = std::distance(first, last);
+        if (size > capacity_ || size < capacity_ / 2) {
+            release(arena);
+            data_ = arena.allocate_array<value_type>(size);
+            capacity_ = size;
+        }
+        std::copy(first, last, data_);
+        size_ = size;
+    }
+
+    void release(ModelArena &arena) {
+        arena.deallocate_array(data_, capacity_);
+        data_ = nullptr;
+        size_ = capacity_ = 0;
+    }
+
+    // 占用的内存池字节数
+    size_t bytes() const { return capacity_ * sizeof(value_type); }
+
+private:
+    void reallocate(uint32_t capacity, ModelArena &arena) {
+        value_type *data = arena.allocate_array<value_type>(capacity);
+        std::copy(data_, data_ + size_, data);
+        arena.deallocate_array(data_, capacity_);
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    value_type *data_ = nullptr;
+    uint32_t size_ = 0;
+    uint32_t capacity_ = 0;
+};
+
+// 单个上下文的统计：后继词计数、总次数以及排好序的前K个后继词。
+// successors和top的存储来自所在表的内存池，修改需通过这里的方法进行
+struct ContextEntry {
+    ModelArena *arena;
+    int total = 0;
+    SuccessorMap successors;
+    // 按次数降序、ID升序排列，长度为min(TOP_K_SUCCESSORS, successors.size())
+    RankedList top;
+
+    explicit ContextEntry(ModelArena &arena) : arena(&arena) {}
+
+    // 复制到另一个内存池，按最小容量分配
+    ContextEntry(const ContextEntry &other, ModelArena &arena) : arena(&arena), total(other.total) {
+        successors.assign(other.successors, arena);
+        top.assign(other.top.begin(), other.top.end(), arena);
+    }
+
+    ContextEntry(const ContextEntry &) = delete;
+
+    ContextEntry(ContextEntry &&) noexcept = default;
+
+    ContextEntry &operator=(ContextEntry &&) noexcept = default;
+
+    static bool ranks_before(const std::pair<WordId, int> &a,
+                             const std::pair<WordId, int> &b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    }
+
+    // 增加后继词次数并增量维护top（delta必须为正）
+    void add(WordId word, int delta) {
+        int &count = successors.insert(word, *arena);
+        count += delta;
+        total += delta;
+
+        size_t i = 0;
+        while (i < top.size() && top[i].first != word) ++i;
+
+        if (i == top.size()) {
+            std::pair<WordId, int> entry(word, count);
+            if (top.size() < (size_t) TOP_K_SUCCESSORS) {
+                top.push_back(entry, *arena);
+            } else if (ranks_before(entry, top.back())) {
+                top.back() = entry;
+                i = top.size() - 1;
+            } else {
+                return;
+            }
+        } else {
+            top[i].second = count;
+        }
+
+        // 次数只增不减，向前冒泡即可恢复有序
+        while (i > 0 && ranks_before(top[i], top[i - 1])) {
+            std::swap(top[i], top[i - 1]);
+            --i;
+        }
+    }
+
+    // 以下直接修改后继词次数，不维护total和top，全部修改完后调用rebuild
+    void set(WordId word, int count) { successors.insert(word, *arena) = count; }
+
+    // 已存在时不修改
+    bool emplace(WordId word, int count) { return successors.emplace(word, count, *arena); }
+
+    void reserve(size_t count) { successors.reserve(count, *arena); }
+
+    bool erase(WordId word) { return successors.erase(word); }
+
+    // 删除pred(const std::pair<WordId, int> &)为真的后继词
+    template<typename Predicate>
+    size_t erase_if(Predicate pred) { return successors.erase_if(pred, *arena); }
+
+    // 根据successors完整重建total和top（加载或计数减少后调用）
+    void rebuild() {
+        // 每次调用都用到的临时数组，复用以免反复申请
+        static thread_local std::vector<std::pair<WordId, int>> all;
+        all.assign(successors.begin(), successors.end());
+        total = 0;
+        for (const auto &entry: all) {
+            total += entry.second;
+        }
+        size_t k = std::min(all.size(), (size_t) TOP_K_SUCCESSORS);
+        std::partial_sort(all.begin(), all.begin() + k, all.end(), ranks_before);
+        top.assign(all.begin(), all.begin() + k, *arena);
+    }
+};
+
+// 上下文 -> 统计，一阶一张表
+using ContextMap = FlatContextMap<ContextEntry>;
+
 // 模型参数封装结构体
 struct NGramModelData {
     int n = 3;
     double smoothing = 0.1;
     int total_words = 0;
-    std::unordered_set<std::string> vocabulary;
-    std::unordered_map<std::string, int> word_count;
-    std::unordered_map<int, std::unordered_map<std::vector<std::string>,
-            std::unordered_map<std::string, int>, VectorHash>> models;
+    Vocabulary vocabulary;
+    std::vector<int> word_count;  // 按WordId索引
+    // 所有单词按次数降序、ID升序排列，用于一元模型回退
+    std::vector<WordId> unigram_rank;
+    std::unordered_map<int, ContextMap> models;
+
+    // 增加单词次数并维护unigram_rank（delta必须为正）
+    void add_word_count(WordId id, int delta) {
+        // 新词次数为0且ID最大，直接追加到末尾即保持有序
+        while (word_count.size() <= id) {
+            unigram_rank.push_back(static_cast<WordId>(word_count.size()));
+            word_count.push_back(0);
+        }
+
+        int old_count = word_count[id];
+        int new_count = old_count + delta;
+        auto ranks_before = [this](WordId a, int count, WordId b) {
+            return word_count[a] > count || (word_count[a] == count && a < b);
+        };
+
+        // 两次二分查找定位旧位置和新位置，再把该词旋转到新位置
+        auto old_pos = std::lower_bound(
+                unigram_rank.begin(), unigram_rank.end(), id,
+                [&](WordId a, WordId b) { return ranks_before(a, old_count, b); });
+        auto new_pos = std::lower_bound(
+                unigram_rank.begin(), old_pos, id,
+                [&](WordId a, WordId b) { return ranks_before(a, new_count, b); });
+        std::rotate(new_pos, old_pos, old_pos + 1);
+        word_count[id] = new_count;
+    }
+
+    // 根据word_count完整重建unigram_rank（加载后调用）
+    void rebuild_unigram_rank() {
+        unigram_rank.resize(word_count.size());
+        std::iota(unigram_rank.begin(), unigram_rank.end(), 0);
+        std::sort(unigram_rank.begin(), unigram_rank.end(), [this](WordId a, WordId b) {
+            return word_count[a] > word_count[b] || (word_count[a] == word_count[b] && a < b);
+        });
+    }
 };
+
+#endif // NGRAM_MODEL_DATA_H
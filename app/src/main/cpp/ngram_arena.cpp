@@ -0,0 +1,109 @@
+#include "ngram_arena.h"
+#include <cstdlib>
+#include <new>
+
+ModelArena::~ModelArena() {
+    for (char *chunk: chunks_) {
+        std::free(chunk);
+    }
+    while (large_) {
+        LargeBlock *next = large_->next;
+        std::free(large_);
+        large_ = next;
+    }
+}
+
+int ModelArena::class_of(size_t bytes, size_t &block_bytes) {
+    if (bytes <= SMALL_BYTES) {
+        block_bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        return (int) (block_bytes / ALIGNMENT) - 1;
+    }
+    int size_class = SMALL_CLASSES;
+    block_bytes = SMALL_BYTES * 2;
+    while (block_bytes < bytes) {
+        block_bytes *= 2;
+        ++size_class;
+    }
+    return size_class;
+}
+
+size_t ModelArena::class_bytes(int size_class) {
+    if (size_class < SMALL_CLASSES) return (size_class + 1) * ALIGNMENT;
+    return SMALL_BYTES << (size_class - SMALL_CLASSES + 1);
+}
+
+void *ModelArena::allocate(size_t bytes) {
+    if (bytes == 0) return nullptr;
+    if (bytes > LARGE_BYTES) return allocate_large(bytes);
+
+    size_t block_bytes;
+    int size_class = class_of(bytes, block_bytes);
+    used_ += block_bytes;
+    if (free_[size_class]) {
+        FreeBlock *block = free_[size_class];
+        free_[size_class] = block->next;
+        return block;
+    }
+
+    if ((size_t) (limit_ - cursor_) < block_bytes) {
+        recycle_tail();
+        char *chunk = static_cast<char *>(std::malloc(CHUNK_BYTES));
+        if (!chunk) throw std::bad_alloc();
+        chunks_.push_back(chunk);
+        reserved_ += CHUNK_BYTES;
+        cursor_ = chunk;
+        limit_ = chunk + CHUNK_BYTES;
+    }
+    void *p = cursor_;
+    cursor_ += block_bytes;
+    return p;
+}
+
+void ModelArena::deallocate(void *p, size_t bytes) {
+    if (!p) return;
+    if (bytes > LARGE_BYTES) {
+        auto *block = reinterpret_cast<LargeBlock *>(static_cast<char *>(p) - sizeof(LargeBlock));
+        if (block->prev) {
+            block->prev->next = block->next;
+        } else {
+            large_ = block->next;
+        }
+        if (block->next) block->next->prev = block->prev;
+        reserved_ -= block->bytes + sizeof(LargeBlock);
+        used_ -= block->bytes;
+        std::free(block);
+        return;
+    }
+
+    size_t block_bytes;
+    int size_class = class_of(bytes, block_bytes);
+    used_ -= block_bytes;
+    auto *block = static_cast<FreeBlock *>(p);
+    block->next = free_[size_class];
+    free_[size_class] = block;
+}
+
+void *ModelArena::allocate_large(size_t bytes) {
+    auto *block = static_cast<LargeBlock *>(std::malloc(sizeof(LargeBlock) + bytes));
+    if (!block) throw std::bad_alloc();
+    block->prev = nullptr;
+    block->next = large_;
+    block->bytes = bytes;
+    if (large_) large_->prev = block;
+    large_ = block;
+    reserved_ += sizeof(LargeBlock) + bytes;
+    used_ += bytes;
+    return block + 1;
+}
+
+void ModelArena::recycle_tail() {
+    for (int size_class = CLASS_COUNT - 1; size_class >= 0 && cursor_ < limit_; --size_class) {
+        size_t block_bytes = class_bytes(size_class);
+        while ((size_t) (limit_ - cursor_) >= block_bytes) {
+            auto *block = reinterpret_cast<FreeBlock *>(cursor_);
+            block->next = free_[size_class];
+            free_[size_class] = block;
+            cursor_ += block_bytes;
+        }
+    }
+}
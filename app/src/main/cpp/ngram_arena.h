@@ -0,0 +1,84 @@
+#ifndef NGRAM_ARENA_H
+#define NGRAM_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 模型计数使用的内存池：从64KB的大块中顺序切分，按大小分级回收复用。
+// 训练和加载时每个上下文的后继词表和top都从所在阶的内存池分配，
+// 不再为每个小对象单独调用malloc；整个模型（或一阶）释放时只需归还这些大块。
+// 超过LARGE_BYTES的请求单独向系统申请，同样随内存池一起释放。
+//
+// 不是线程安全的，同一时间只能由一个线程修改
+class ModelArena {
+public:
+    ModelArena() = default;
+
+    ModelArena(const ModelArena &) = delete;
+
+    ModelArena &operator=(const ModelArena &) = delete;
+
+    ~ModelArena();
+
+    // 8字节对齐，bytes为0时返回空
+    void *allocate(size_t bytes);
+
+    // bytes必须与分配时相同
+    void deallocate(void *p, size_t bytes);
+
+    template<typename T>
+    T *allocate_array(size_t count) {
+        return static_cast<T *>(allocate(count * sizeof(T)));
+    }
+
+    template<typename T>
+    void deallocate_array(T *p, size_t count) {
+        deallocate(p, count * sizeof(T));
+    }
+
+    // 向系统申请的字节数
+    size_t bytes_reserved() const { return reserved_; }
+
+    // 已分配且未归还的字节数（按分级后的大小）
+    size_t bytes_used() const { return used_; }
+
+private:
+    static constexpr size_t CHUNK_BYTES = 64 * 1024;
+    static constexpr size_t ALIGNMENT = 8;
+    static constexpr size_t SMALL_BYTES = 256;             // 以内按8字节分级
+    static constexpr size_t LARGE_BYTES = CHUNK_BYTES / 8; // 以内按2的幂分级
+    static constexpr int SMALL_CLASSES = SMALL_BYTES / ALIGNMENT;
+    static constexpr int CLASS_COUNT = SMALL_CLASSES + 5;  // 512到8K
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    // 单独申请的大块，头部链成双向链表
+    struct LargeBlock {
+        LargeBlock *prev;
+        LargeBlock *next;
+        size_t bytes;
+    };
+
+    // 请求大小所在的级别及该级别的块大小
+    static int class_of(size_t bytes, size_t &block_bytes);
+
+    static size_t class_bytes(int size_class);
+
+    void *allocate_large(size_t bytes);
+
+    // 当前大块剩余部分切成尽量大的块放入空闲链表
+    void recycle_tail();
+
+    std::vector<char *> chunks_;
+    char *cursor_ = nullptr;
+    char *limit_ = nullptr;
+    FreeBlock *free_[CLASS_COUNT] = {};
+    LargeBlock *large_ = nullptr;
+    size_t reserved_ = 0;
+    size_t used_ = 0;
+};
+
+#endif // NGRAM_ARENA_H
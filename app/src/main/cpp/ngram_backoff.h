@@ -0,0 +1,105 @@
+#ifndef NGRAM_BACKOFF_H
+#define NGRAM_BACKOFF_H
+
+#include <algorithm>
+#include <utility>
+#include "ngarm_model_data.h"
+
+// 插值绝对折扣平滑（Kneser-Ney的折扣与回退权重形式，低阶使用原始次数）：
+//   P(w | h) = max(c(h, w) - D, 0) / c(h) + γ(h) · P(w | h')
+//   γ(h) = D · N(h) / c(h)
+// h'是去掉最早一个词的低阶上下文，N(h)是h的后继词数。γ(h)恰好等于本阶折扣掉的概率质量，
+// 因此各阶合起来仍是归一化的分布。不存在的上下文直接使用低阶概率，
+// 最低一阶是加k平滑（k为模型的smoothing）的一元概率。
+//
+// 低阶不使用Kneser-Ney的接续次数：增量日志只累加原始次数，无法维护接续次数。
+const double BACKOFF_DISCOUNT = 0.75;
+
+// 一次查询用到的各阶上下文及其回退权重，按阶数从高到低排列。
+// 每阶上下文只查找一次：最高阶命中后，低阶上下文通过Model::backoff_context取得，
+// 冻结模型中是预先保存的下标，不需要再次查找。
+//
+// Model的要求同predict_word_ids，另需提供
+//   Context backoff_context(int n_size, const WordId *ids, const Context &context) const;
+//       context是ids[0, n_size - 1)对应的上下文，返回去掉ids[0]后的低一阶上下文
+// Context另需提供
+//   double backoff_weight() const;         γ(h)
+template<typename Model>
+class BackoffChain {
+public:
+    using Context = decltype(std::declval<const Model &>().find_context(2, nullptr));
+
+    // 最多使用的上下文阶数，更高阶的上下文被忽略
+    static constexpr int MAX_CONTEXTS = 8;
+
+    BackoffChain(const Model &model, const std::vector<WordId> &words) : model_(model) {
+        int max_n = std::min({model.order(), (int) words.size() + 1, MAX_CONTEXTS + 1});
+        const WordId *end = words.data() + words.size();
+        Context higher;
+        for (int n_size = max_n; n_size >= 2; --n_size) {
+            const WordId *ids = end - (n_size - 1);
+            Context context;
+            if (higher) context = model.backoff_context(n_size + 1, ids - 1, higher);
+            // 含未登录词的上下文不可能命中
+            if (!context && std::find(ids, end, INVALID_WORD_ID) == end) {
+                context = model.find_context(n_size, ids);
+            }
+            higher = context;
+            if (!context) continue;
+
+            if (size_ == 0) highest_order_ = n_size;
+            contexts_[size_] = context;
+            weights_[size_] = unigram_weight_;
+            totals_[size_] = context.total() > 0 ? context.total() : 1;
+            unigram_weight_ *= context.backoff_weight();
+            ++size_;
+        }
+
+        int vocab_size = model.vocabulary_size();
+        unigram_total_ = (model.total_words() > 0 ? model.total_words() : 1) +
+                         model.smoothing() * (vocab_size > 0 ? vocab_size : 1);
+    }
+
+    int size() const { return size_; }
+
+    // 命中的最高阶数，没有命中任何上下文时为1（只用一元概率）
+    int highest_order() const { return highest_order_; }
+
+    const Context &context(int i) const { return contexts_[i]; }
+
+    // 第i个上下文中次数为count的词在P(w | 最高阶上下文)中的份额
+    double discounted(int i, int count) const {
+        return count > BACKOFF_DISCOUNT ? weights_[i] * (count - BACKOFF_DISCOUNT) / totals_[i] : 0.0;
+    }
+
+    // 一元次数为count的词在P(w | 最高阶上下文)中的份额
+    double unigram(int count) const {
+        return unigram_weight_ * (count + model_.smoothing()) / unigram_total_;
+    }
+
+    double probability(WordId word) const {
+        return probability(word, [this, word](int i) { return contexts_[i].count_of(word); });
+    }
+
+    // count_of(i)返回word在第i个上下文中的次数，调用方可以先查已取出的后继词
+    template<typename CountOf>
+    double probability(WordId word, CountOf count_of) const {
+        double probability = unigram(model_.word_count(word));
+        for (int i = 0; i < size_; ++i) {
+            probability += discounted(i, count_of(i));
+        }
+        return probability;
+    }
+
+private:
+    const Model &model_;
+    Context contexts_[MAX_CONTEXTS];
+    double weights_[MAX_CONTEXTS];   // 更高各阶γ的乘积
+    double totals_[MAX_CONTEXTS];
+    double unigram_weight_ = 1.0;
+    double unigram_total_ = 1.0;
+    int size_ = 0;
+    int highest_order_ = 1;
+};
+
+#endif // NGRAM_BACKOFF_H
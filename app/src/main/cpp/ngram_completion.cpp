@@ -0,0 +1,68 @@
+#include "ngram_completion.h"
+
+void PrefixIndex::build(const std::vector<std::string_view> &words, const std::vector<int> &counts) {
+    sorted_ids_.resize(words.size());
+    std::iota(sorted_ids_.begin(), sorted_ids_.end(), 0);
+    std::sort(sorted_ids_.begin(), sorted_ids_.end(), [&words](WordId a, WordId b) {
+        return words[a] < words[b] || (words[a] == words[b] && a < b);
+    });
+
+    sorted_words_.reserve(words.size());
+    for (WordId id: sorted_ids_) {
+        sorted_words_.push_back(words[id]);
+    }
+
+    build_nodes(0, sorted_ids_.size(), 0, counts);
+}
+
+void PrefixIndex::build_nodes(size_t lo, size_t hi, size_t depth, const std::vector<int> &counts) {
+    if (hi - lo <= COMPLETION_SCAN_LIMIT) return;
+
+    std::vector<WordId> ids(sorted_ids_.begin() + lo, sorted_ids_.begin() + hi);
+    std::partial_sort(ids.begin(), ids.begin() + COMPLETION_TOP_K, ids.end(), [&counts](WordId a, WordId b) {
+        return counts[a] > counts[b] || (counts[a] == counts[b] && a < b);
+    });
+    nodes_.emplace(node_key(lo, depth), static_cast<uint32_t>(top_.size()));
+    top_.insert(top_.end(), ids.begin(), ids.begin() + COMPLETION_TOP_K);
+
+    // 与前缀等长的单词排在区间最前面，其余按下一个字符划分子节点
+    size_t i = lo;
+    while (i < hi && sorted_words_[i].size() == depth) ++i;
+    while (i < hi) {
+        char c = sorted_words_[i][depth];
+        size_t j = i + 1;
+        while (j < hi && sorted_words_[j][depth] == c) ++j;
+        build_nodes(i, j, depth + 1, counts);
+        i = j;
+    }
+}
+
+PrefixCandidates PrefixIndex::lookup(std::string_view prefix) const {
+    PrefixCandidates result;
+
+    auto begin = std::lower_bound(sorted_words_.begin(), sorted_words_.end(), prefix);
+    auto end = std::partition_point(begin, sorted_words_.end(), [prefix](std::string_view word) {
+        return word.size() >= prefix.size() && word.compare(0, prefix.size(), prefix) == 0;
+    });
+    size_t lo = begin - sorted_words_.begin();
+    size_t size = end - begin;
+    result.range = sorted_ids_.data() + lo;
+    result.range_size = size;
+
+    if (size <= COMPLETION_SCAN_LIMIT) {
+        result.ids = sorted_ids_.data() + lo;
+        result.size = size;
+        return result;
+    }
+
+    auto it = nodes_.find(node_key(lo, prefix.size()));
+    result.complete = false;
+    if (it != nodes_.end()) {
+        result.ids = top_.data() + it->second;
+        result.size = COMPLETION_TOP_K;
+    } else {
+        result.ids = sorted_ids_.data() + lo;
+        result.size = COMPLETION_SCAN_LIMIT;
+    }
+    return result;
+}
@@ -0,0 +1,131 @@
+#ifndef NGRAM_COMPLETION_H
+#define NGRAM_COMPLETION_H
+
+#include "ngarm_model_data.h"
+#include "ngram_backoff.h"
+#include "ngram_predict.h"
+
+// 前缀区间不超过该数量时直接对区间内全部单词打分
+const size_t COMPLETION_SCAN_LIMIT = 64;
+
+// 区间更大的前缀预先保存一元次数最高的单词数量
+const size_t COMPLETION_TOP_K = 32;
+
+// 区间较大时，为找全上下文中出现过的词最多额外检查的单词数
+const size_t COMPLETION_SCAN_BUDGET = 512;
+
+// 某个前缀的候选词
+struct PrefixCandidates {
+    const WordId *ids = nullptr;
+    size_t size = 0;
+    bool complete = true;  // false表示只是区间内一元次数最高的COMPLETION_TOP_K个词
+    // 以该前缀开头的全部单词（字典序）
+    const WordId *range = nullptr;
+    size_t range_size = 0;
+};
+
+// 前缀补全索引：按字典序排列的单词数组，以某个前缀开头的单词是其中连续的一段。
+// 区间超过COMPLETION_SCAN_LIMIT的前缀（字典树中较浅的节点）额外保存前K个高频词，
+// 因此每次查询只需要一次二分查找，最多返回COMPLETION_SCAN_LIMIT个候选词。
+//
+// 索引引用模型中的单词字符串，只能用于构建时的（不再修改的）模型。
+class PrefixIndex {
+public:
+    // Model需要提供vocabulary_size()、word(WordId)和word_count(WordId)
+    template<typename Model>
+    explicit PrefixIndex(const Model &model) {
+        size_t vocab_size = model.vocabulary_size();
+        std::vector<std::string_view> words;
+        std::vector<int> counts;
+        words.reserve(vocab_size);
+        counts.reserve(vocab_size);
+        for (size_t id = 0; id < vocab_size; ++id) {
+            words.push_back(model.word(static_cast<WordId>(id)));
+            counts.push_back(model.word_count(static_cast<WordId>(id)));
+        }
+        build(words, counts);
+    }
+
+    // prefix需已转换为小写
+    PrefixCandidates lookup(std::string_view prefix) const;
+
+    size_t node_count() const { return nodes_.size(); }
+
+private:
+    void build(const std::vector<std::string_view> &words, const std::vector<int> &counts);
+
+    void build_nodes(size_t lo, size_t hi, size_t depth, const std::vector<int> &counts);
+
+    static uint64_t node_key(size_t lo, size_t depth) {
+        return (static_cast<uint64_t>(lo) << 16) | std::min(depth, (size_t) 0xFFFF);
+    }
+
+    std::vector<std::string_view> sorted_words_;
+    std::vector<WordId> sorted_ids_;
+    // (区间起点, 前缀长度) -> top_中的起始位置
+    std::unordered_map<uint64_t, uint32_t> nodes_;
+    std::vector<WordId> top_;
+};
+
+// 对以prefix开头的单词按插值概率（与predict_word_ids相同）打分，Model的要求同predict_word_ids，
+// 另需提供
+//   std::string_view word(WordId id) const;
+// Context还需提供size()（后继词数量）。
+//
+// 没有在任何一阶上下文中出现的词，概率只取决于一元次数，不会超过区间内一元次数更高的词，
+// 因此由索引中的高频词覆盖。高阶上下文的后继词一定也是最低阶上下文的后继词，
+// 因此只要前缀区间或最低阶上下文的后继词不超过COMPLETION_SCAN_BUDGET，结果与逐词打分
+// 完全一致；两者都更大时（通常是只输入了一两个字母）只检查各阶排名靠前的后继词。
+// 查找了上下文时，用到的最高阶数记录在本线程的PredictScratch::hit_order中（含义同predict_word_ids）
+template<typename Model>
+std::vector<std::pair<WordId, double>> complete_word_ids(
+        const Model &model, const PrefixIndex &index, const std::vector<WordId> &words,
+        std::string_view prefix, int num_completions) {
+
+    std::vector<std::pair<WordId, double>> ranked;
+    if (num_completions <= 0 || prefix.empty()) return ranked;
+
+    PrefixCandidates found = index.lookup(prefix);
+    if (found.size == 0) return ranked;
+    std::vector<WordId> candidates(found.ids, found.ids + found.size);
+
+    BackoffChain<Model> chain(model, words);
+    PredictScratch::local().hit_order = words.empty() ? 0 : chain.highest_order();
+
+    // 索引只给出了一元高频词时，补充上下文中出现过且匹配前缀的词
+    if (!found.complete && chain.size() > 0) {
+        auto add_matching = [&](WordId word, int) {
+            std::string_view text = model.word(word);
+            if (text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0) {
+                candidates.push_back(word);
+            }
+        };
+        const auto &lowest = chain.context(chain.size() - 1);
+        if (lowest.size() <= COMPLETION_SCAN_BUDGET) {
+            lowest.for_each_ranked(SIZE_MAX, add_matching);
+        } else if (found.range_size <= COMPLETION_SCAN_BUDGET) {
+            candidates.assign(found.range, found.range + found.range_size);
+        } else {
+            for (int i = 0; i < chain.size(); ++i) {
+                chain.context(i).for_each_ranked(TOP_K_SUCCESSORS, add_matching);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    }
+
+    ranked.reserve(candidates.size());
+    for (WordId word: candidates) {
+        ranked.emplace_back(word, chain.probability(word));
+    }
+
+    size_t k = std::min(ranked.size(), (size_t) num_completions);
+    std::partial_sort(ranked.begin(), ranked.begin() + k, ranked.end(),
+                      [](const auto &a, const auto &b) {
+                          return a.second > b.second || (a.second == b.second && a.first < b.first);
+                      });
+    ranked.resize(k);
+    return ranked;
+}
+
+#endif // NGRAM_COMPLETION_H
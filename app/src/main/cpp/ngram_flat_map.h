@@ -0,0 +1,585 @@
+#ifndef NGRAM_FLAT_MAP_H
+#define NGRAM_FLAT_MAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "ngram_arena.h"
+
+// 模型计数用的扁平哈希表：开放寻址、线性探测，元素连续存放。
+// std::unordered_map每个元素一个堆节点、每张表一个桶数组，小表浪费大，探测时还要跟随指针；
+// 这里一张表只有一块（或零块）内存，删除时把后面的元素前移填补空位，不留墓碑。
+// 装载率不超过3/4，容量为2的幂。
+
+// 后继词次数表：单词ID -> 次数。UINT32_MAX保留为空槽标记，不能作为键。
+// 不超过INLINE_CAPACITY个元素时直接存放在对象内并线性查找，大部分上下文只有一两个后继词，
+// 不需要任何堆内存。
+// 更大的表从调用方传入的ModelArena分配，同一张表必须始终使用同一个内存池。
+// 表不自行释放内存，随内存池一起释放；移动后原表为空，不能复制，需用assign复制到某个内存池中
+class FlatCountMap {
+public:
+    using value_type = std::pair<uint32_t, int>;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatCountMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+        const_iterator(const value_type *slot, const value_type *end) : slot_(slot), end_(end) {
+            skip_empty();
+        }
+
+        reference operator*() const { return *slot_; }
+
+        pointer operator->() const { return slot_; }
+
+        const_iterator &operator++() {
+            ++slot_;
+            skip_empty();
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator &other) const { return slot_ == other.slot_; }
+
+        bool operator!=(const const_iterator &other) const { return slot_ != other.slot_; }
+
+    private:
+        void skip_empty() {
+            while (slot_ != end_ && slot_->first == EMPTY) ++slot_;
+        }
+
+        const value_type *slot_;
+        const value_type *end_;
+    };
+
+    FlatCountMap() : inline_{{EMPTY, 0}, {EMPTY, 0}} {}
+
+    FlatCountMap(const FlatCountMap &) = delete;
+
+    FlatCountMap(FlatCountMap &&other) noexcept: FlatCountMap() {
+        swap(other);
+    }
+
+    // 原有的表留在内存池中，随内存池释放
+    FlatCountMap &operator=(FlatCountMap &&other) noexcept {
+        FlatCountMap moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
+    void swap(FlatCountMap &other) noexcept {
+        // 内联元素与表指针共用存储，按各自的模式交换
+        value_type saved[INLINE_CAPACITY];
+        value_type *saved_table = nullptr;
+        if (capacity_) {
+            saved_table = table_;
+        } else {
+            std::copy(inline_, inline_ + INLINE_CAPACITY, saved);
+        }
+        if (other.capacity_) {
+            table_ = other.table_;
+        } else {
+            std::copy(other.inline_, other.inline_ + INLINE_CAPACITY, inline_);
+        }
+        if (capacity_) {
+            other.table_ = saved_table;
+        } else {
+            std::copy(saved, saved + INLINE_CAPACITY, other.inline_);
+        }
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+    }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    const_iterator begin() const { return {slots(), slots() + slot_count()}; }
+
+    const_iterator end() const {
+        const value_type *last = slots() + slot_count();
+        return {last, last};
+    }
+
+    const_iterator find(uint32_t key) const {
+        const value_type *slot = locate(key);
+        return slot ? const_iterator(slot, slots() + slot_count()) : end();
+    }
+
+    // 不存在时返回0
+    int count_of(uint32_t key) const {
+        const value_type *slot = locate(key);
+        return slot ? slot->second : 0;
+    }
+
+    // 不存在时插入次数0。返回的引用在下一次插入前有效
+    int &insert(uint32_t key, ModelArena &arena) { return insert(key, 0, arena)->second; }
+
+    // 已存在时不修改，返回是否插入
+    bool emplace(uint32_t key, int count, ModelArena &arena) {
+        size_t old_size = size_;
+        insert(key, count, arena);
+        return size_ != old_size;
+    }
+
+    bool erase(uint32_t key) {
+        value_type *slot = const_cast<value_type *>(locate(key));
+        if (!slot) return false;
+        --size_;
+        if (capacity_ == 0) {
+            slot->first = EMPTY;
+            return true;
+        }
+
+        // 后面同一探测链上的元素前移：初始位置不在(hole, i]之间的元素可以移到hole
+        const uint32_t mask = capacity_ - 1;
+        uint32_t hole = slot - table_;
+        for (uint32_t i = (hole + 1) & mask; table_[i].first != EMPTY; i = (i + 1) & mask) {
+            uint32_t home = home_slot(table_[i].first, capacity_);
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                table_[hole] = table_[i];
+                hole = i;
+            }
+        }
+        table_[hole].first = EMPTY;
+        return true;
+    }
+
+    // 删除pred(const value_type &)为真的元素，返回删除数量
+    template<typename Predicate>
+    size_t erase_if(Predicate pred, ModelArena &arena) {
+        size_t removed = 0;
+        value_type *first = slots();
+        for (uint32_t i = 0; i < slot_count(); ++i) {
+            if (first[i].first != EMPTY && pred(static_cast<const value_type &>(first[i]))) {
+                first[i].first = EMPTY;
+                ++removed;
+            }
+        }
+        // 标记为空后探测链断开，需要重新放置
+        if (removed > 0) {
+            size_ -= removed;
+            rehash(capacity_, arena);
+        }
+        return removed;
+    }
+
+    void reserve(size_t count, ModelArena &arena) {
+        uint32_t capacity = capacity_for(count);
+        if (capacity > capacity_) rehash(capacity, arena);
+    }
+
+    // 收缩到容纳现有元素的最小容量
+    void shrink_to_fit(ModelArena &arena) {
+        uint32_t capacity = capacity_for(size_);
+        if (capacity != capacity_) rehash(capacity, arena);
+    }
+
+    // 替换为other的元素，表按最小容量分配
+    void assign(const FlatCountMap &other, ModelArena &arena) {
+        clear(arena);
+        allocate(capacity_for(other.size_), arena);
+        for (const auto &entry: other) {
+            *free_slot(entry.first) = entry;
+        }
+        size_ = other.size_;
+    }
+
+    void clear(ModelArena &arena) {
+        if (capacity_) arena.deallocate_array(table_, capacity_);
+        capacity_ = 0;
+        size_ = 0;
+        inline_[0] = inline_[1] = {EMPTY, 0};
+    }
+
+    // 表占用的内存池字节数
+    size_t table_bytes() const { return capacity_ * sizeof(value_type); }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    static constexpr uint32_t INLINE_CAPACITY = 2;
+
+    value_type *slots() { return capacity_ ? table_ : inline_; }
+
+    const value_type *slots() const { return capacity_ ? table_ : inline_; }
+
+    uint32_t slot_count() const { return capacity_ ? capacity_ : INLINE_CAPACITY; }
+
+    // 装载率不超过3/4的最小容量，0表示内联
+    static uint32_t capacity_for(size_t count) {
+        if (count <= INLINE_CAPACITY) return 0;
+        uint32_t capacity = 4;
+        while ((size_t) capacity * 3 < count * 4) capacity *= 2;
+        return capacity;
+    }
+
+    // 乘法哈希取高位，连续的单词ID也能均匀分布
+    static uint32_t home_slot(uint32_t key, uint32_t capacity) {
+        return (uint32_t) ((key * 0x9e3779b97f4a7c15ull) >> 32) & (capacity - 1);
+    }
+
+    const value_type *locate(uint32_t key) const {
+        if (key == EMPTY) return nullptr;
+        if (capacity_ == 0) {
+            for (const auto &slot: inline_) {
+                if (slot.first == key) return &slot;
+            }
+            return nullptr;
+        }
+        const uint32_t mask = capacity_ - 1;
+        for (uint32_t i = home_slot(key, capacity_);; i = (i + 1) & mask) {
+            if (table_[i].first == key) return &table_[i];
+            if (table_[i].first == EMPTY) return nullptr;
+        }
+    }
+
+    // 键必须不存在
+    value_type *free_slot(uint32_t key) {
+        if (capacity_ == 0) {
+            for (auto &slot: inline_) {
+                if (slot.first == EMPTY) return &slot;
+            }
+            return nullptr;
+        }
+        const uint32_t mask = capacity_ - 1;
+        uint32_t i = home_slot(key, capacity_);
+        while (table_[i].first != EMPTY) i = (i + 1) & mask;
+        return &table_[i];
+    }
+
+    value_type *insert(uint32_t key, int count, ModelArena &arena) {
+        value_type *slot = const_cast<value_type *>(locate(key));
+        if (slot) return slot;
+        if (capacity_for(size_ + 1) > capacity_) rehash(capacity_for(size_ + 1), arena);
+        slot = free_slot(key);
+        *slot = {key, count};
+        ++size_;
+        return slot;
+    }
+
+    // 表必须为空且没有分配
+    void allocate(uint32_t capacity, ModelArena &arena) {
+        if (capacity == 0) return;
+        table_ = arena.allocate_array<value_type>(capacity);
+        std::fill(table_, table_ + capacity, value_type(EMPTY, 0));
+        capacity_ = capacity;
+    }
+
+    void rehash(uint32_t capacity, ModelArena &arena) {
+        FlatCountMap next;
+        next.allocate(capacity, arena);
+        for (const auto &entry: *this) {
+            *next.free_slot(entry.first) = entry;
+        }
+        next.size_ = size_;
+        if (capacity_) arena.deallocate_array(table_, capacity_);
+        capacity_ = 0;
+        swap(next);
+    }
+
+    uint32_t size_ = 0;
+    uint32_t capacity_ = 0;  // 0表示元素存放在inline_中
+    union {
+        value_type inline_[INLINE_CAPACITY];
+        value_type *table_;
+    };
+};
+
+// 上下文键：指向连续存放的单词ID，不拥有数据
+class ContextKey {
+public:
+    ContextKey() = default;
+
+    ContextKey(const uint32_t *ids, size_t size) : ids_(ids), size_(size) {}
+
+    ContextKey(const std::vector<uint32_t> &ids) : ids_(ids.data()), size_(ids.size()) {}
+
+    const uint32_t *data() const { return ids_; }
+
+    size_t size() const { return size_; }
+
+    const uint32_t *begin() const { return ids_; }
+
+    const uint32_t *end() const { return ids_ + size_; }
+
+    uint32_t operator[](size_t i) const { return ids_[i]; }
+
+    uint64_t hash() const {
+        uint64_t hash = size_;
+        for (size_t i = 0; i < size_; ++i) {
+            hash = (hash ^ ids_[i]) * 0x9e3779b97f4a7c15ull;
+        }
+        return hash ^ (hash >> 32);
+    }
+
+    friend bool operator==(ContextKey a, ContextKey b) {
+        return a.size_ == b.size_ && std::equal(a.begin(), a.end(), b.begin());
+    }
+
+    friend bool operator<(ContextKey a, ContextKey b) {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+    }
+
+private:
+    const uint32_t *ids_ = nullptr;
+    size_t size_ = 0;
+};
+
+// FlatContextMap占用的堆内存（字节）
+struct TableMemory {
+    size_t entries = 0;         // Entry数组
+    size_t keys = 0;            // 打包的键
+    size_t slots = 0;           // 哈希槽位
+    size_t arena_reserved = 0;  // 内存池向系统申请的字节数
+    size_t arena_used = 0;      // 其中已分配出去的字节数（按分级后的大小）
+
+    size_t bytes() const { return entries + keys + slots + arena_reserved; }
+};
+
+// 一阶上下文的统计表：上下文 -> Entry。同一张表中的键长度相同，由第一次插入决定。
+// 上下文统计按插入顺序存放在entries_中，键依次打包在keys_中；
+// 槽位只保存下标和哈希，探测时不需要访问键，遍历时按下标顺序连续访问。
+// 插入或删除后，之前取得的Entry指针和ContextKey失效。
+//
+// 每张表有自己的内存池，Entry内部的小对象从中分配，不同阶可以由不同线程同时修改。
+// Entry需提供
+//   explicit Entry(ModelArena &arena);
+//   Entry(const Entry &other, ModelArena &arena);   复制到另一个内存池
+// 并且可以移动。复制表或shrink_to_fit时所有Entry复制到新的内存池，旧内存池整体释放
+template<typename Entry>
+class FlatContextMap {
+public:
+    // 遍历时的元素，second引用表中的统计
+    template<typename E>
+    struct Item {
+        ContextKey first;
+        E &second;
+    };
+
+    template<typename E, typename Map>
+    class basic_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Item<E>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Item<E>;
+
+        basic_iterator(Map *map, size_t index) : map_(map), index_(index) {}
+
+        Item<E> operator*() const { return {map_->key_at(index_), map_->entries_[index_]}; }
+
+        basic_iterator &operator++() {
+            ++index_;
+            return *this;
+        }
+
+        bool operator==(const basic_iterator &other) const { return index_ == other.index_; }
+
+        bool operator!=(const basic_iterator &other) const { return index_ != other.index_; }
+
+    private:
+        Map *map_;
+        size_t index_;
+    };
+
+    using iterator = basic_iterator<Entry, FlatContextMap>;
+    using const_iterator = basic_iterator<const Entry, const FlatContextMap>;
+
+    FlatContextMap() : arena_(new ModelArena()) {}
+
+    FlatContextMap(const FlatContextMap &other)
+            : arena_(new ModelArena()), keys_(other.keys_), slots_(other.slots_),
+              width_(other.width_) {
+        entries_.reserve(other.entries_.size());
+        for (const auto &entry: other.entries_) {
+            entries_.emplace_back(entry, *arena_);
+        }
+    }
+
+    // 内存池由unique_ptr持有，移动后Entry中的指针仍然有效
+    FlatContextMap(FlatContextMap &&) noexcept = default;
+
+    FlatContextMap &operator=(const FlatContextMap &other) {
+        if (this != &other) *this = FlatContextMap(other);
+        return *this;
+    }
+
+    FlatContextMap &operator=(FlatContextMap &&) noexcept = default;
+
+    size_t size() const { return entries_.size(); }
+
+    bool empty() const { return entries_.empty(); }
+
+    // 键长度，空表为0
+    size_t width() const { return width_; }
+
+    iterator begin() { return {this, 0}; }
+
+    iterator end() { return {this, entries_.size()}; }
+
+    const_iterator begin() const { return {this, 0}; }
+
+    const_iterator end() const { return {this, entries_.size()}; }
+
+    ContextKey key_at(size_t index) const { return {keys_.data() + index * width_, width_}; }
+
+    // 不存在时返回空
+    const Entry *find(ContextKey key) const {
+        if (entries_.empty() || key.size() != width_) return nullptr;
+        uint32_t hash = (uint32_t) key.hash();
+        const uint32_t mask = slots_.size() - 1;
+        for (uint32_t i = hash & mask; slots_[i].index != EMPTY; i = (i + 1) & mask) {
+            if (slots_[i].hash == hash && key_at(slots_[i].index) == key) {
+                return &entries_[slots_[i].index];
+            }
+        }
+        return nullptr;
+    }
+
+    Entry *find(ContextKey key) {
+        return const_cast<Entry *>(static_cast<const FlatContextMap *>(this)->find(key));
+    }
+
+    // 不存在时插入默认值。key的长度必须与表中已有的键相同
+    Entry &operator[](ContextKey key) {
+        Entry *entry = find(key);
+        if (entry) return *entry;
+
+        if (entries_.empty()) width_ = key.size();
+        if (!arena_) arena_.reset(new ModelArena());  // 被移动过的表
+        if (capacity_for(entries_.size() + 1) > slots_.size()) {
+            rehash(capacity_for(entries_.size() + 1));
+        }
+        uint32_t index = entries_.size();
+        keys_.insert(keys_.end(), key.begin(), key.end());
+        entries_.emplace_back(*arena_);
+        place(index, (uint32_t) key.hash());
+        return entries_.back();
+    }
+
+    void reserve(size_t count) {
+        entries_.reserve(count);
+        uint32_t capacity = capacity_for(count);
+        if (capacity > slots_.size()) rehash(capacity);
+    }
+
+    // 删除pred(const Entry &)为真的上下文，其余保持原有顺序，返回删除数量。
+    // 删除的Entry占用的内存池空间在shrink_to_fit或表释放时才归还
+    template<typename Predicate>
+    size_t erase_if(Predicate pred) {
+        size_t kept = 0;
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            if (pred(static_cast<const Entry &>(entries_[i]))) continue;
+            if (kept != i) {
+                entries_[kept] = std::move(entries_[i]);
+                std::copy(keys_.begin() + i * width_, keys_.begin() + (i + 1) * width_,
+                          keys_.begin() + kept * width_);
+            }
+            ++kept;
+        }
+        size_t removed = entries_.size() - kept;
+        if (removed > 0) {
+            entries_.erase(entries_.begin() + kept, entries_.end());
+            keys_.resize(kept * width_);
+            rehash(slots_.size());
+        }
+        return removed;
+    }
+
+    // 收缩到容纳现有上下文的最小容量：Entry按最小容量复制到新的内存池，旧内存池整体释放
+    void shrink_to_fit() {
+        std::unique_ptr<ModelArena> arena(new ModelArena());
+        std::vector<Entry> entries;
+        entries.reserve(entries_.size());
+        for (const auto &entry: entries_) {
+            entries.emplace_back(entry, *arena);
+        }
+        entries_.swap(entries);
+        entries.clear();
+        arena_.swap(arena);
+
+        keys_.shrink_to_fit();
+        uint32_t capacity = capacity_for(entries_.size());
+        if (capacity != slots_.size()) rehash(capacity);
+        slots_.shrink_to_fit();
+    }
+
+    void clear() {
+        entries_.clear();
+        keys_.clear();
+        slots_.clear();
+        width_ = 0;
+        arena_.reset(new ModelArena());
+    }
+
+    const ModelArena &arena() const { return *arena_; }
+
+    // 各部分按容量计算的堆内存
+    TableMemory memory() const {
+        TableMemory memory;
+        memory.entries = entries_.capacity() * sizeof(Entry);
+        memory.keys = keys_.capacity() * sizeof(uint32_t);
+        memory.slots = slots_.capacity() * sizeof(Slot);
+        if (arena_) {
+            memory.arena_reserved = arena_->bytes_reserved();
+            memory.arena_used = arena_->bytes_used();
+        }
+        return memory;
+    }
+
+    // 占用的堆内存字节数，包括内存池
+    size_t heap_bytes() const { return memory().bytes(); }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct Slot {
+        uint32_t index;
+        uint32_t hash;
+    };
+
+    static uint32_t capacity_for(size_t count) {
+        if (count == 0) return 0;
+        uint32_t capacity = 8;
+        while ((size_t) capacity * 3 < count * 4) capacity *= 2;
+        return capacity;
+    }
+
+    void place(uint32_t index, uint32_t hash) {
+        const uint32_t mask = slots_.size() - 1;
+        uint32_t i = hash & mask;
+        while (slots_[i].index != EMPTY) i = (i + 1) & mask;
+        slots_[i] = {index, hash};
+    }
+
+    void rehash(size_t capacity) {
+        slots_.assign(capacity, {EMPTY, 0});
+        if (capacity == 0) return;
+        for (uint32_t i = 0; i < entries_.size(); ++i) {
+            place(i, (uint32_t) key_at(i).hash());
+        }
+    }
+
+    // 最先构造、最后析构，Entry析构时内存池仍然有效
+    std::unique_ptr<ModelArena> arena_;
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> keys_;  // 第i个上下文的键为[i * width_, (i + 1) * width_)
+    std::vector<Slot> slots_;
+    size_t width_ = 0;
+};
+
+#endif // NGRAM_FLAT_MAP_H
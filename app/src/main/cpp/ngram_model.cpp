@@ -1,202 +1,712 @@
 #include <regex>
 #include <chrono>
 #include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 
 #include "ngram_model.h"
+#include "ngram_predict.h"
 #include "jni_log.h"
 
 // NGramModel成员函数实现（仅修改参数访问方式）
 std::vector<std::string> NGramModel::preprocess_text(const std::string &text) {
-    std::vector<std::string> words;
-    if (text.empty()) return words;
-
-    // 转换为小写并替换标点符号
-    std::string clean_text;
-    clean_text.reserve(text.size());
-    for (char c: text) {
-        if (isalpha(c) || isdigit(c) || c == '\'' || c == ' ') {
-            clean_text += tolower(c);
-        } else {
-            clean_text += ' ';
+    TokenBuffer buffer;
+    tokenize_text(text, buffer);
+    return std::vector<std::string>(buffer.tokens.begin(), buffer.tokens.end());
+}
+
+bool NGramModel::split_partial_word(std::string_view text, std::string_view &context,
+                                    std::string &prefix) {
+    size_t start = text.size();
+    bool word = false;
+    while (start > 0) {
+        size_t length = previous_char(text, start, word);
+        if (!word) break;
+        start -= length;
+    }
+
+    context = text.substr(0, start);
+    prefix.resize(text.size() - start);
+    lower_word(text.data() + start, prefix.size(), &prefix[0]);
+    return !prefix.empty();
+}
+
+void NGramModel::train(const std::string &text) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto start = std::chrono::high_resolution_clock::now();
+
+    count_text(text);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    LOGD("Training completed in %f seconds", elapsed.count());
+}
+
+namespace {
+
+// 分片中单个上下文的后继词计数，存储来自所在表的内存池
+struct ShardEntry {
+    ModelArena *arena;
+    SuccessorMap successors;
+
+    explicit ShardEntry(ModelArena &arena) : arena(&arena) {}
+
+    ShardEntry(const ShardEntry &other, ModelArena &arena) : arena(&arena) {
+        successors.assign(other.successors, arena);
+    }
+
+    ShardEntry(ShardEntry &&) noexcept = default;
+
+    ShardEntry &operator=(ShardEntry &&) noexcept = default;
+};
+
+// 单个训练线程的私有计数表，单词按在分片中首次出现的顺序编号
+struct ShardCounts {
+    Vocabulary vocabulary;
+    std::vector<int> word_count;
+    int total_words = 0;
+    size_t lines = 0;
+    // 下标i对应i+2元模型
+    std::vector<FlatContextMap<ShardEntry>> orders;
+};
+
+// 逐行统计[begin, end)中的语料，与count_text的规则一致
+void count_shard(const char *begin, const char *end, int n, ShardCounts &shard) {
+    shard.orders.resize(std::max(n - 1, 0));
+
+    TokenBuffer buffer;
+    const auto &words = buffer.tokens;
+    std::vector<WordId> ids;
+    std::vector<WordId> context;
+    const char *p = begin;
+    while (p < end) {
+        const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+        const char *line_end = newline ? newline : end;
+        tokenize_text(std::string_view(p, line_end - p), buffer);
+        p = newline ? newline + 1 : end;
+        ++shard.lines;
+
+        if (words.empty()) continue;
+
+        ids.clear();
+        for (std::string_view word: words) {
+            WordId id = shard.vocabulary.intern(word);
+            if (id >= shard.word_count.size()) {
+                shard.word_count.push_back(0);
+            }
+            shard.word_count[id]++;
+            ids.push_back(id);
         }
+        shard.total_words += words.size();
+
+        for (int i = 2; i <= n; ++i) {
+            auto &context_map = shard.orders[i - 2];
+            for (size_t pos = 0; pos + i <= ids.size(); ++pos) {
+                context.assign(ids.begin() + pos, ids.begin() + pos + i - 1);
+                ShardEntry &entry = context_map[context];
+                ++entry.successors.insert(ids[pos + i - 1], *entry.arena);
+            }
+        }
+    }
+}
+
+// 按分片顺序合并计数表。分片内单词ID按首次出现顺序分配，因此按分片顺序
+// 合并词表得到的全局ID与串行训练相同；top列表和unigram_rank只取决于最终计数，
+// 与合并顺序无关，所以合并结果与串行train完全一致。
+void merge_shards(NGramModelData &data, std::vector<ShardCounts> &shards) {
+    std::vector<std::vector<WordId>> remap(shards.size());
+    for (size_t s = 0; s < shards.size(); ++s) {
+        const Vocabulary &vocabulary = shards[s].vocabulary;
+        remap[s].resize(vocabulary.size());
+        for (WordId id = 0; id < vocabulary.size(); ++id) {
+            remap[s][id] = data.vocabulary.intern(vocabulary.word(id));
+        }
+    }
+
+    // 先在主线程创建各阶容器，之后每个合并任务只写自己的那一阶
+    std::vector<ContextMap *> targets(std::max(data.n - 1, 0), nullptr);
+    for (int i = 2; i <= data.n; ++i) {
+        bool any = std::any_of(shards.begin(), shards.end(), [i](const ShardCounts &shard) {
+            return !shard.orders[i - 2].empty();
+        });
+        if (any) targets[i - 2] = &data.models[i];
     }
 
-    // 分词
-    std::stringstream ss(clean_text);
-    std::string word;
-    while (ss >> word) {
-        if (!word.empty()) {
-            words.push_back(word);
+    auto merge_unigrams = [&]() {
+        for (size_t s = 0; s < shards.size(); ++s) {
+            for (WordId id = 0; id < shards[s].word_count.size(); ++id) {
+                data.add_word_count(remap[s][id], shards[s].word_count[id]);
+            }
+            data.total_words += shards[s].total_words;
+        }
+    };
+
+    auto merge_order = [&](int index) {
+        ContextMap &context_map = *targets[index];
+        std::vector<WordId> context;
+        for (size_t s = 0; s < shards.size(); ++s) {
+            const auto &local = remap[s];
+            for (const auto &entry: shards[s].orders[index]) {
+                context.clear();
+                for (WordId id: entry.first) {
+                    context.push_back(local[id]);
+                }
+                ContextEntry &target = context_map[context];
+                for (const auto &successor: entry.second.successors) {
+                    target.add(local[successor.first], successor.second);
+                }
+            }
         }
+    };
+
+    // 一元统计和每一阶互不相交，可以并行合并
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (targets[i]) workers.emplace_back(merge_order, (int) i);
+    }
+    merge_unigrams();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+} // namespace
+
+size_t NGramModel::train_batch(const char *text, size_t size, int threads) {
+    // 在行边界切分，每个线程统计一个分片
+    std::vector<const char *> bounds;
+    bounds.push_back(text);
+    const char *end = text + size;
+    for (int t = 1; t < threads; ++t) {
+        const char *cut = std::max(text + size * t / threads, bounds.back());
+        const char *newline = static_cast<const char *>(memchr(cut, '\n', end - cut));
+        bounds.push_back(newline ? newline + 1 : end);
+    }
+    bounds.push_back(end);
+
+    std::vector<ShardCounts> shards(threads);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(count_shard, bounds[t], bounds[t + 1], data_.n, std::ref(shards[t]));
+    }
+    count_shard(bounds[0], bounds[1], data_.n, shards[0]);
+    for (auto &worker: workers) {
+        worker.join();
     }
 
-    return words;
+    merge_shards(data_, shards);
+
+    size_t lines = 0;
+    for (const auto &shard: shards) {
+        lines += shard.lines;
+    }
+    return lines;
 }
 
-std::vector<std::vector<std::string>> NGramModel::build_ngrams(
-        const std::vector<std::string> &words, int n) {
+size_t NGramModel::train_corpus(int fd, int64_t offset, int64_t length, int threads) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (threads > 1) {
+        return train_corpus_parallel(fd, offset, length, threads);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
 
-    std::vector<std::vector<std::string>> ngrams;
-    if (words.size() < (size_t) n) return ngrams;
+    // 固定大小的读缓冲区，跨块的行暂存在line中
+    std::unique_ptr<char[]> buffer(new char[CORPUS_CHUNK_SIZE]);
+    std::string line;
+    size_t lines = 0;
+    int64_t remaining = length < 0 ? INT64_MAX : length;
 
-    ngrams.reserve(words.size() - n + 1);
-    for (size_t i = 0; i <= words.size() - n; ++i) {
-        std::vector<std::string> ngram(words.begin() + i, words.begin() + i + n);
-        ngrams.push_back(ngram);
+    while (remaining > 0) {
+        size_t want = std::min<int64_t>(CORPUS_CHUNK_SIZE, remaining);
+        ssize_t got = pread(fd, buffer.get(), want, offset);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            LOGE("Failed to read corpus: %s", strerror(errno));
+            break;
+        }
+        if (got == 0) break;
+        offset += got;
+        remaining -= got;
+
+        // 每行单独训练，与逐行训练的结果一致
+        const char *p = buffer.get();
+        const char *end = p + got;
+        while (p < end) {
+            const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!newline) {
+                line.append(p, end);
+                break;
+            }
+            line.append(p, newline);
+            count_text(line);
+            line.clear();
+            ++lines;
+            p = newline + 1;
+        }
+    }
+
+    if (!line.empty()) {
+        count_text(line);
+        ++lines;
     }
 
-    return ngrams;
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    LOGD("Trained %zu corpus lines in %f seconds", lines, elapsed.count());
+    return lines;
 }
 
-void NGramModel::train(const std::string &text) {
+size_t NGramModel::train_corpus_parallel(int fd, int64_t offset, int64_t length, int threads) {
     auto start = std::chrono::high_resolution_clock::now();
 
-    std::vector<std::string> words = preprocess_text(text);
+    // 每批读取threads个分片的数据，批尾不完整的行留到下一批
+    const size_t batch_size = PARALLEL_SHARD_SIZE * threads;
+    std::string batch;
+    size_t lines = 0;
+    int64_t remaining = length < 0 ? INT64_MAX : length;
+    bool eof = false;
+    bool need_more = false;
+
+    while (!eof || !batch.empty()) {
+        while (!eof && (batch.size() < batch_size || need_more)) {
+            need_more = false;
+            size_t used = batch.size();
+            size_t want = std::min<int64_t>(CORPUS_CHUNK_SIZE, remaining);
+            batch.resize(used + want);
+            ssize_t got = want > 0 ? pread(fd, &batch[used], want, offset) : 0;
+            if (got < 0 && errno == EINTR) {
+                batch.resize(used);
+                continue;
+            }
+            if (got < 0) {
+                LOGE("Failed to read corpus: %s", strerror(errno));
+            }
+            batch.resize(used + std::max<ssize_t>(got, 0));
+            if (got <= 0) {
+                eof = true;
+                break;
+            }
+            offset += got;
+            remaining -= got;
+        }
+
+        size_t usable = batch.size();
+        if (!eof) {
+            size_t last_newline = batch.rfind('\n');
+            // 单行超过一批时继续读取
+            if (last_newline == std::string::npos) {
+                need_more = true;
+                continue;
+            }
+            usable = last_newline + 1;
+        }
+        if (usable == 0) break;
+
+        lines += train_batch(batch.data(), usable, threads);
+        batch.erase(0, usable);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    LOGD("Trained %zu corpus lines with %d threads in %f seconds", lines, threads, elapsed.count());
+    return lines;
+}
+
+size_t NGramModel::train_corpus(const std::string &file_path, int threads) {
+    int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("Failed to open corpus: %s", file_path.c_str());
+        return 0;
+    }
+    size_t lines = train_corpus(fd, 0, -1, threads);
+    close(fd);
+    return lines;
+}
+
+void NGramModel::count_text(const std::string &text) {
+    // 逐行训练时复用分词缓冲区
+    static thread_local TokenBuffer buffer;
+    tokenize_text(text, buffer);
+    const auto &words = buffer.tokens;
     if (words.empty()) return;
 
     // 更新词汇表和词频统计
-    for (const auto &word: words) {
-        data_.vocabulary.insert(word);
-        data_.word_count[word]++;
+    std::vector<WordId> ids;
+    ids.reserve(words.size());
+    for (std::string_view word: words) {
+        WordId id = data_.vocabulary.intern(word);
+        data_.add_word_count(id, 1);
+        ids.push_back(id);
     }
     data_.total_words += words.size();
 
     // 训练不同大小的n元语法模型
+    std::vector<WordId> context;
     for (int i = 2; i <= data_.n; ++i) {
-        auto ngrams = build_ngrams(words, i);
-        if (ngrams.empty()) continue;
+        if (ids.size() < (size_t) i) continue;
 
         // 确保模型容器存在
-        if (data_.models.find(i) == data_.models.end()) {
-            data_.models[i] = std::unordered_map<std::vector<std::string>,
-                    std::unordered_map<std::string, int>, VectorHash>();
-        }
+        auto &context_map = data_.models[i];
 
         // 统计n元语法出现次数
-        for (const auto &ngram: ngrams) {
-            std::vector<std::string> context(ngram.begin(), ngram.end() - 1);
-            const std::string &word = ngram.back();
-
-            data_.models[i][context][word]++;
+        for (size_t pos = 0; pos + i <= ids.size(); ++pos) {
+            context.assign(ids.begin() + pos, ids.begin() + pos + i - 1);
+            context_map[context].add(ids[pos + i - 1], 1);
         }
     }
-
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> elapsed = end - start;
-    LOGD("Training completed in %f seconds", elapsed.count());
 }
 
-std::vector<std::pair<std::string, double>> NGramModel::predict_next_word(
-        const std::string &context, int num_predictions) {
+bool NGramModel::apply_delta(const ModelDelta &delta) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (data_.vocabulary.size() != delta.base_vocab_size) {
+        LOGE("Delta does not match model vocabulary: %zu != %u",
+             data_.vocabulary.size(), delta.base_vocab_size);
+        return false;
+    }
 
-    auto words = preprocess_text(context);
-    std::unordered_map<std::string, double> candidates;
+    // 新词按日志中的顺序分配，ID与增量中的全局ID一致
+    for (const auto &word: delta.new_words.words) {
+        data_.vocabulary.intern(word);
+    }
+    for (const auto &entry: delta.word_count) {
+        data_.add_word_count(entry.first, entry.second);
+    }
+    data_.total_words += delta.total_words;
 
-    // 如果没有上下文，返回最常见的词
-    if (words.empty()) {
-        std::vector<std::pair<std::string, int>> common_words;
-        for (const auto &entry: data_.word_count) {
-            common_words.emplace_back(entry.first, entry.second);
+    for (const auto &model: delta.models) {
+        auto &context_map = data_.models[model.first];
+        for (const auto &context: model.second) {
+            ContextEntry &entry = context_map[context.first];
+            for (const auto &successor: context.second.successors) {
+                entry.add(successor.first, successor.second);
+            }
         }
+    }
+    return true;
+}
 
-        std::sort(common_words.begin(), common_words.end(),
-                  [](const auto &a, const auto &b) { return a.second > b.second; });
+namespace {
 
-        std::vector<std::pair<std::string, double>> result;
-        int total = data_.total_words > 0 ? data_.total_words : 1;
-        for (size_t i = 0; i < common_words.size() && i < (size_t) num_predictions; ++i) {
-            double prob = static_cast<double>(common_words[i].second) / total;
-            result.emplace_back(common_words[i].first, prob);
-        }
-        return result;
-    }
+// 内存模型中单个上下文的视图
+class MemoryContext {
+public:
+    explicit MemoryContext(const ContextEntry *entry = nullptr) : entry_(entry) {}
 
-    // 尝试使用最大可能的n元模型
-    int max_n = std::min(data_.n, (int) words.size() + 1);
-    for (int n_size = max_n; n_size >= 2; --n_size) {
-        int context_size = n_size - 1;
-        std::vector<std::string> context_words(
-                words.end() - context_size, words.end());
+    explicit operator bool() const { return entry_ != nullptr; }
 
-        auto it = data_.models.find(n_size);
-        if (it == data_.models.end()) continue;
-
-        auto &context_map = it->second;
-        auto ctx_it = context_map.find(context_words);
-        if (ctx_it == context_map.end()) continue;
-
-        // 计算概率
-        auto &word_counts = ctx_it->second;
-        int total = std::accumulate(word_counts.begin(), word_counts.end(), 0,
-                                    [](int sum, const auto &entry) { return sum + entry.second; });
-        int vocab_size = data_.vocabulary.size();
-
-        for (const auto &entry: word_counts) {
-            double prob = (entry.second + data_.smoothing) /
-                          (total + data_.smoothing * vocab_size);
-            candidates[entry.first] += prob;
-        }
+    int total() const { return entry_->total; }
 
-        if (candidates.size() >= (size_t) num_predictions) {
-            break;
-        }
+    size_t size() const { return entry_->successors.size(); }
+
+    double backoff_weight() const {
+        return BACKOFF_DISCOUNT * entry_->successors.size() / std::max(entry_->total, 1);
     }
 
-    // 如果预测不够，使用一元模型补充
-    if (candidates.size() < (size_t) num_predictions) {
-        int remaining = num_predictions - candidates.size();
-        int total = data_.total_words > 0 ? data_.total_words : 1;
-        int vocab_size = data_.vocabulary.size() > 0 ? data_.vocabulary.size() : 1;
+    int count_of(WordId id) const { return entry_->successors.count_of(id); }
 
-        std::vector<std::pair<std::string, int>> common_words;
-        for (const auto &entry: data_.word_count) {
-            if (candidates.find(entry.first) == candidates.end()) {
-                common_words.emplace_back(entry.first, entry.second);
+    // 请求数量不超过top长度时只遍历top的前limit项，否则遍历全部后继词
+    template<typename F>
+    void for_each_ranked(size_t limit, F f) const {
+        if (limit <= (size_t) TOP_K_SUCCESSORS || entry_->top.size() == entry_->successors.size()) {
+            size_t count = std::min(limit, entry_->top.size());
+            for (size_t i = 0; i < count; ++i) {
+                f(entry_->top[i].first, entry_->top[i].second);
+            }
+        } else {
+            for (const auto &successor: entry_->successors) {
+                f(successor.first, successor.second);
             }
         }
+    }
 
-        std::sort(common_words.begin(), common_words.end(),
-                  [](const auto &a, const auto &b) { return a.second > b.second; });
+private:
+    const ContextEntry *entry_;
+};
 
-        for (size_t i = 0; i < common_words.size() && i < (size_t) remaining; ++i) {
-            double prob = (common_words[i].second + data_.smoothing) /
-                          (total + data_.smoothing * vocab_size);
-            candidates[common_words[i].first] = prob;
-        }
+// 供predict_word_ids使用的内存模型视图
+class MemoryModelView {
+public:
+    explicit MemoryModelView(const NGramModelData &data) : data_(data) {}
+
+    int order() const { return data_.n; }
+
+    double smoothing() const { return data_.smoothing; }
+
+    int total_words() const { return data_.total_words; }
+
+    size_t vocabulary_size() const { return data_.vocabulary.size(); }
+
+    std::string_view word(WordId id) const { return data_.vocabulary.word(id); }
+
+    WordId find_word(std::string_view word) const { return data_.vocabulary.find(word); }
+
+    int word_count(WordId id) const { return data_.word_count[id]; }
+
+    WordId unigram_at(size_t rank) const { return data_.unigram_rank[rank]; }
+
+    MemoryContext find_context(int n_size, const WordId *ids) const {
+        auto it = data_.models.find(n_size);
+        if (it == data_.models.end()) return MemoryContext(nullptr);
+        return MemoryContext(it->second.find(ContextKey(ids, n_size - 1)));
     }
 
-    // 排序并返回结果
+    MemoryContext backoff_context(int n_size, const WordId *ids, const MemoryContext &) const {
+        return find_context(n_size - 1, ids + 1);
+    }
+
+private:
+    const NGramModelData &data_;
+};
+
+} // namespace
+
+void NGramModel::predict_views(std::string_view context, int num_predictions,
+                               std::vector<PredictionView> &out) const {
+    auto &scratch = PredictScratch::local();
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    predict_word_views(MemoryModelView(data_), context, num_predictions, scratch, out);
+}
+
+void NGramModel::predict_views(const std::vector<WordId> &words, int num_predictions,
+                               std::vector<PredictionView> &out) const {
+    auto &scratch = PredictScratch::local();
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    predict_id_views(MemoryModelView(data_), words, num_predictions, scratch, out);
+}
+
+std::vector<std::pair<std::string, double>> NGramModel::predict_next_word(
+        const std::string &context, int num_predictions) const {
+    std::vector<PredictionView> views;
+    predict_views(context, num_predictions, views);
+    // 仅在返回前转换为字符串
+    return to_string_results(views);
+}
+
+std::vector<std::pair<std::string, double>> NGramModel::complete_word(
+        const std::vector<WordId> &words, std::string_view prefix,
+        const PrefixIndex &index, int num_completions) const {
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto ranked = complete_word_ids(MemoryModelView(data_), index, words, prefix,
+                                    num_completions);
+
     std::vector<std::pair<std::string, double>> result;
-    for (const auto &entry: candidates) {
-        result.push_back(entry);
+    result.reserve(ranked.size());
+    for (const auto &entry: ranked) {
+        result.emplace_back(data_.vocabulary.word(entry.first), entry.second);
     }
+    return result;
+}
+
+PrefixIndex NGramModel::build_prefix_index() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return PrefixIndex(MemoryModelView(data_));
+}
+
+namespace {
+
+// 冻结文件存在且不早于可训练模型文件时才可直接映射
+bool is_frozen_model_current(const std::string &frozen_path, const std::string &model_path) {
+    struct stat frozen_st{};
+    if (stat(frozen_path.c_str(), &frozen_st) != 0) return false;
+
+    struct stat model_st{};
+    if (stat(model_path.c_str(), &model_st) != 0) return true;
+    return frozen_st.st_mtime >= model_st.st_mtime;
+}
 
-    std::sort(result.begin(), result.end(),
-              [](const auto &a, const auto &b) { return a.second > b.second; });
+} // namespace
 
-    if (result.size() > (size_t) num_predictions) {
-        result.resize(num_predictions);
+ModelSnapshot::ModelSnapshot(std::shared_ptr<const FrozenNGramModel> frozen,
+                             std::shared_ptr<const ModelDelta> delta,
+                             std::shared_ptr<PredictorStats> stats)
+        : frozen_(std::move(frozen)), stats_(std::move(stats)) {
+    if (delta && !delta->empty()) {
+        overlay_ = std::make_unique<OverlayNGramModel>(frozen_, std::move(delta));
     }
+}
+
+int ModelSnapshot::order() const {
+    return model_ ? model_->order() : frozen_->order();
+}
+
+ModelSummary ModelSnapshot::summary() const {
+    if (model_) return model_->summary();
 
+    ModelSummary summary;
+    summary.order = frozen_->order();
+    summary.smoothing = frozen_->smoothing();
+    summary.total_words = frozen_->total_words();
+    summary.vocabulary_size = frozen_->vocabulary_size();
+    if (overlay_) {
+        summary.total_words += overlay_->delta().total_words;
+        summary.vocabulary_size = overlay_->delta().vocabulary_end();
+    }
+    return summary;
+}
+
+ModelMemory ModelSnapshot::memory_usage() const {
+    if (frozen_) return measure_memory(*frozen_, overlay_ ? &overlay_->delta() : nullptr);
+    return model_->memory_usage();
+}
+
+WordId ModelSnapshot::find_word(std::string_view word) const {
+    if (overlay_) return overlay_->find_word(word);
+    if (frozen_) return frozen_->find_word(word);
+    return model_->find_word(word);
+}
+
+void ModelSnapshot::predict_views(std::string_view context, int num_predictions,
+                                  std::vector<PredictionView> &out) const {
+    ScopedLatency latency(stats_ ? &stats_->histogram(STATS_PREDICT) : nullptr);
+    if (overlay_) {
+        overlay_->predict_views(context, num_predictions, out);
+    } else if (frozen_) {
+        frozen_->predict_views(context, num_predictions, out);
+    } else {
+        model_->predict_views(context, num_predictions, out);
+    }
+    if (stats_) stats_->record_hit(PredictScratch::local().hit_order);
+}
+
+void ModelSnapshot::predict_views(const std::vector<WordId> &words, int num_predictions,
+                                  std::vector<PredictionView> &out) const {
+    ScopedLatency latency(stats_ ? &stats_->histogram(STATS_PREDICT) : nullptr);
+    if (overlay_) {
+        overlay_->predict_views(words, num_predictions, out);
+    } else if (frozen_) {
+        frozen_->predict_views(words, num_predictions, out);
+    } else {
+        model_->predict_views(words, num_predictions, out);
+    }
+    if (stats_) stats_->record_hit(PredictScratch::local().hit_order);
+}
+
+std::vector<std::pair<std::string, double>> ModelSnapshot::predict_next_word(
+        std::string_view context, int num_predictions) const {
+    std::vector<PredictionView> views;
+    predict_views(context, num_predictions, views);
+    return to_string_results(views);
+}
+
+std::vector<std::pair<std::string, double>> ModelSnapshot::complete_word(
+        std::string_view context, std::string_view prefix, int num_completions) const {
+    auto &scratch = PredictScratch::local();
+    lookup_tail_ids(*this, context, scratch);
+    return complete_word(scratch.ids, prefix, num_completions);
+}
+
+std::vector<std::pair<std::string, double>> ModelSnapshot::complete_word(
+        const std::vector<WordId> &words, std::string_view prefix, int num_completions) const {
+    // 首次调用构建前缀索引的时间同样计入
+    ScopedLatency latency(stats_ ? &stats_->histogram(STATS_COMPLETE) : nullptr);
+    std::call_once(index_once_, [this] {
+        if (overlay_) {
+            index_ = std::make_unique<PrefixIndex>(overlay_->build_prefix_index());
+        } else if (frozen_) {
+            index_ = std::make_unique<PrefixIndex>(frozen_->build_prefix_index());
+        } else {
+            index_ = std::make_unique<PrefixIndex>(model_->build_prefix_index());
+        }
+    });
+
+    // 前缀没有候选词时不查找上下文，不计入命中次数
+    int &hit_order = PredictScratch::local().hit_order;
+    hit_order = -1;
+    std::vector<std::pair<std::string, double>> result;
+    if (overlay_) {
+        result = overlay_->complete_word(words, prefix, *index_, num_completions);
+    } else if (frozen_) {
+        result = frozen_->complete_word(words, prefix, *index_, num_completions);
+    } else {
+        result = model_->complete_word(words, prefix, *index_, num_completions);
+    }
+    if (stats_ && hit_order >= 0) stats_->record_hit(hit_order);
     return result;
 }
 
-// TextPredictor实现（保持不变）
+std::string ModelSnapshot::describe() const {
+    ModelSummary summary = this->summary();
+    std::stringstream ss;
+    ss << "n: " << summary.order << "\n"
+       << "Vocabulary size: " << summary.vocabulary_size << "\n"
+       << "Total words: " << summary.total_words << "\n"
+       << "Smoothing: " << summary.smoothing;
+    if (overlay_) {
+        ss << "\n" << "Journal words: " << overlay_->delta().total_words;
+    }
+
+    ModelMemory memory = memory_usage();
+    ss << "\n" << "Heap bytes: " << memory.heap_bytes()
+       << " (strings " << memory.string_bytes
+       << ", vocabulary " << memory.vocabulary_bytes
+       << ", unigrams " << memory.unigram_bytes << ")";
+    if (memory.mapped_bytes > 0) {
+        ss << "\n" << "Mapped bytes: " << memory.mapped_bytes
+           << " (strings " << memory.mapped_string_bytes << ")";
+    }
+    for (size_t k = 2; k < memory.orders.size(); ++k) {
+        const OrderMemory &order = memory.orders[k];
+        ss << "\n" << "Order " << k << ": " << order.contexts << " contexts, "
+           << order.ngrams << " n-grams, heap " << order.heap_bytes()
+           << " (entries " << order.entry_bytes
+           << ", keys " << order.key_bytes
+           << ", slots " << order.slot_bytes
+           << ", successors " << order.successor_bytes
+           << ", top " << order.ranked_bytes
+           << ", pool overhead " << order.arena_overhead << ")";
+        if (order.mapped_bytes > 0) ss << ", mapped " << order.mapped_bytes;
+    }
+    return ss.str();
+}
+
+// TextPredictor实现
 TextPredictor::TextPredictor(const std::string &model_path, int n,
                              const std::vector<std::string> *sample_texts)
-        : model_path_(model_path) {
+        : model_path_(model_path), frozen_path_(model_path + ".frozen"),
+          journal_path_(model_path + ".journal"), n_(n) {
 
     LOGD("Initializing predictor with model path: %s", model_path.c_str());
 
+    // 构造期间后台线程尚未启动，仍按单写者约定持锁
+    std::lock_guard<std::mutex> model_lock(model_mutex_);
+
+    // 冷启动优先直接映射冻结模型并重放增量日志，可训练模型推迟到合并时再加载
+    if (is_frozen_model_current(frozen_path_, model_path_) && open_frozen_base()) {
+        return;
+    }
+
     // 检查模型文件是否存在
     std::ifstream ifs(model_path);
     if (ifs.good()) {
         LOGD("Loading existing model...");
         model_ = std::make_unique<NGramModel>();
         if (!model_->load(model_path)) {
+            // .bin损坏时不能从空模型开始：第一轮训练会覆盖冻结文件并清空日志，之前的数据全部丢失。
+            // 冻结文件即使早于.bin也比空模型好，日志与它不匹配时重放会丢弃日志
+            model_.reset();
+            if (open_frozen_base()) {
+                LOGW("Failed to load model, using frozen model instead");
+                return;
+            }
             LOGE("Failed to load model, creating new one");
             model_ = std::make_unique<NGramModel>(n);
+        } else {
+            // 冻结文件无法映射（如格式升级）时，日志仍然基于与.bin相同的模型
+            auto delta = read_journal(journal_path_, model_->vocabulary_size(),
+                                      model_->total_words(), model_->order());
+            if (delta && !delta->empty() && model_->apply_delta(*delta)) {
+                LOGD("Merged %d journal words into loaded model", delta->total_words);
+                model_->save(model_path_);
+            }
         }
+        // 生成冻结文件，下次冷启动无需反序列化
+        publish_model();
     } else {
         LOGD("Creating new model with n=%d", n);
         model_ = std::make_unique<NGramModel>(n);
@@ -204,72 +714,400 @@ TextPredictor::TextPredictor(const std::string &model_path, int n,
         // 如果提供了样本文本，进行预训练
         if (sample_texts && !sample_texts->empty()) {
             LOGD("Training with %zu sample texts", sample_texts->size());
-            for (size_t i = 0; i < sample_texts->size(); ++i) {
-                LOGD("Training sample %zu/%zu", i + 1, sample_texts->size());
-                model_->train((*sample_texts)[i]);
+            for (const auto &text: *sample_texts) {
+                model_->train(text);
             }
-            save_model();
+            model_->save(model_path_);
+        }
+        publish_model();
+    }
+}
+
+TextPredictor::~TextPredictor() {
+    {
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        stopping_ = true;
+    }
+    training_cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void TextPredictor::publish_snapshot(std::shared_ptr<const ModelSnapshot> snapshot) {
+    std::atomic_store(&snapshot_, std::move(snapshot));
+    stats_->increment(STATS_SNAPSHOTS);
+}
+
+bool TextPredictor::ensure_model() {
+    if (model_) return true;
+
+    // 冻结文件和日志包含全部计数，且单词ID与日志一致
+    if (base_) {
+        LOGD("Thawing trainable model from %s", frozen_path_.c_str());
+        model_ = std::make_unique<NGramModel>(n_);
+        model_->load_frozen(*base_);
+        if (delta_ && !model_->apply_delta(*delta_)) {
+            // 不能在缺少增量的模型上继续训练，否则发布时会清空日志丢失数据
+            LOGE("Failed to apply journal to trainable model");
+            model_.reset();
+            return false;
         }
+        return true;
+    }
+
+    LOGD("Loading trainable model from %s", model_path_.c_str());
+    model_ = std::make_unique<NGramModel>(n_);
+    if (!model_->load(model_path_)) {
+        LOGE("Failed to load trainable model, starting from empty model");
+        model_ = std::make_unique<NGramModel>(n_);
+    }
+    return true;
+}
+
+bool TextPredictor::open_frozen_base() {
+    std::shared_ptr<const FrozenNGramModel> frozen = FrozenNGramModel::open(frozen_path_);
+    if (!frozen) return false;
+
+    LOGD("Using frozen model: %s", frozen_path_.c_str());
+    base_ = frozen;
+    delta_ = replay_journal(journal_path_, *base_);
+    publish_snapshot(std::make_shared<ModelSnapshot>(base_, delta_, stats_));
+    return true;
+}
+
+void TextPredictor::publish_model() {
+    if (!model_) return;
+
+    // 空模型（首次启动且没有样本文本）不能保存也不冻结，先发布内存快照，第一轮训练后再冻结。
+    // 新文件通过rename替换，仍在使用旧映射的读者不受影响
+    bool empty = model_->total_words() <= 0;
+    std::shared_ptr<const ModelSnapshot> snapshot;
+    std::shared_ptr<const FrozenNGramModel> frozen =
+            !empty && model_->freeze(frozen_path_) ? FrozenNGramModel::open(frozen_path_) : nullptr;
+    if (frozen) {
+        // 新的基础模型已包含日志中的全部增量。先替换冻结文件再清空日志，
+        // 中途退出时旧日志与新基础模型不匹配，重放时会被丢弃
+        base_ = frozen;
+        auto delta = std::make_shared<ModelDelta>();
+        delta->base_vocab_size = static_cast<uint32_t>(base_->vocabulary_size());
+        delta_ = delta;
+        reset_journal(journal_path_, *base_);
+        snapshot = std::make_shared<ModelSnapshot>(base_, nullptr, stats_);
+        // 之后的训练只写日志，需要时再从冻结文件还原
+        model_.reset();
+    } else {
+        // 无法生成冻结文件时退回到内存模型的副本，之后每轮完整保存
+        if (!empty) LOGW("Publishing in-memory snapshot");
+        base_.reset();
+        delta_.reset();
+        snapshot = std::make_shared<ModelSnapshot>(std::make_unique<NGramModel>(*model_), stats_);
+    }
+    publish_snapshot(std::move(snapshot));
+}
+
+bool TextPredictor::compact_model() {
+    if (!ensure_model()) return false;
+    LOGD("Compacting journal into %s", model_path_.c_str());
+    bool saved = model_->save(model_path_);
+    publish_model();
+    return saved && base_ != nullptr;
+}
+
+bool TextPredictor::over_memory_budget() const {
+    if (prune_options_.memory_budget == 0) return false;
+
+    ModelFootprint footprint;
+    if (model_) {
+        footprint = model_->footprint();
+    } else if (base_) {
+        footprint = measure_model(*base_, delta_.get());
+    }
+    return footprint.bytes() > prune_options_.memory_budget;
+}
+
+PruneOptions TextPredictor::auto_prune_options() const {
+    PruneOptions options = prune_options_;
+    options.memory_budget -= options.memory_budget * PRUNE_HEADROOM_PERCENT / 100;
+    return options;
+}
+
+PruneResult TextPredictor::prune_locked(const PruneOptions &options, bool &saved) {
+    saved = false;
+    if (!ensure_model()) return {};
+
+    PruneResult result = model_->prune(options);
+    stats_->increment(STATS_PRUNES);
+    LOGD("Reclaimed %zu bytes by pruning", result.bytes_reclaimed());
+    saved = model_->save(model_path_);
+    publish_model();
+    return result;
+}
+
+uint64_t TextPredictor::schedule_training_locked() {
+    pending_history_.insert(pending_history_.end(),
+                            std::make_move_iterator(user_history_.begin()),
+                            std::make_move_iterator(user_history_.end()));
+    user_history_.clear();
+    ++scheduled_rounds_;
+
+    if (!worker_.joinable()) {
+        worker_ = std::thread(&TextPredictor::training_loop, this);
+    }
+    training_cv_.notify_one();
+    return scheduled_rounds_;
+}
+
+void TextPredictor::training_loop() {
+    std::unique_lock<std::mutex> lock(history_mutex_);
+    while (true) {
+        training_cv_.wait(lock, [this] { return stopping_ || !pending_history_.empty(); });
+        // 退出前先训练完已提交的历史，避免丢失用户输入
+        if (pending_history_.empty()) break;
+
+        std::vector<std::string> history;
+        history.swap(pending_history_);
+        uint64_t round = scheduled_rounds_;
+        lock.unlock();
+
+        bool ok = run_training(history);
+
+        if (!ok) stats_->increment(STATS_TRAINING_FAILURES);
+        lock.lock();
+        finished_rounds_ = round;
+        last_training_ok_ = ok;
+        ++completed_rounds_;
+        finished_cv_.notify_all();
+    }
+}
+
+bool TextPredictor::run_training(const std::vector<std::string> &history) {
+    // 拿到锁后才算开始：剪枝或保存持锁期间，本轮仍在等待，不报告为运行中
+    std::lock_guard<std::mutex> model_lock(model_mutex_);
+    training_running_ = true;
+    report_progress(0, false, false);
+    ScopedLatency latency(&stats_->histogram(STATS_TRAINING));
+
+    LOGD("Training on %zu history entries", history.size());
+    std::string all_text;
+    for (const auto &text: history) {
+        all_text += text + " ";
+    }
+
+    bool saved;
+    if (base_) {
+        // 只统计本轮文本的增量并追加到日志，写入量与新文本成正比
+        ModelDelta batch = build_model_delta(all_text, *base_, *delta_);
+        report_progress(20, false, false);
+
+        size_t journal_size = 0;
+        saved = append_journal_record(journal_path_, *base_, batch, &journal_size);
+        report_progress(60, false, false);
+
+        auto delta = std::make_shared<ModelDelta>(*delta_);
+        delta->merge(batch);
+        delta_ = delta;
+        publish_snapshot(std::make_shared<ModelSnapshot>(base_, delta_, stats_));
+        report_progress(80, false, false);
+
+        // 超出内存预算时剪枝（同时合并日志）；日志过大或追加失败时合并成新的基础模型
+        if (over_memory_budget()) {
+            prune_locked(auto_prune_options(), saved);
+        } else if (!saved || journal_size >= JOURNAL_COMPACT_SIZE) {
+            saved = compact_model();
+        }
+    } else {
+        ensure_model();
+        report_progress(20, false, false);
+
+        model_->train(all_text);
+        report_progress(60, false, false);
+
+        if (over_memory_budget()) {
+            prune_locked(auto_prune_options(), saved);
+        } else {
+            saved = model_->save(model_path_);
+            report_progress(80, false, false);
+            publish_model();
+        }
+    }
+    training_running_ = false;
+    report_progress(100, true, saved);
+    return saved;
+}
+
+void TextPredictor::report_progress(int progress, bool finished, bool success) {
+    training_progress_ = progress;
+
+    TrainingListener listener;
+    {
+        std::lock_guard<std::mutex> lock(listener_mutex_);
+        listener = listener_;
+    }
+    if (listener) {
+        listener(progress, finished, success);
     }
 }
 
 void TextPredictor::add_to_history(const std::string &text) {
+    std::lock_guard<std::mutex> lock(history_mutex_);
     user_history_.push_back(text);
-    LOGD("Added to history. Current size: %zu/%d",
+    LOGV("Added to history. Current size: %zu/%d",
          user_history_.size(), HISTORY_THRESHOLD);
 
     if (user_history_.size() >= HISTORY_THRESHOLD) {
-        LOGD("History threshold reached, training model...");
-        force_training();
+        LOGD("History threshold reached, scheduling background training...");
+        schedule_training_locked();
     }
 }
 
 std::vector<std::pair<std::string, double>> TextPredictor::predict(
         const std::string &context, int num_predictions) {
 
-    LOGD("Predicting for context: %s", context.c_str());
-    return model_->predict_next_word(context, num_predictions);
+    LOGV("Predicting for context: %s", context.c_str());
+    auto current = snapshot();
+    if (!current) return {};
+    return current->predict_next_word(context, num_predictions);
 }
 
-bool TextPredictor::save_model() {
-    if (model_) {
-        return model_->save(model_path_);
+std::vector<std::vector<std::pair<std::string, double>>> TextPredictor::predict_batch(
+        const std::vector<std::string> &contexts, int num_predictions) {
+
+    std::vector<std::vector<std::pair<std::string, double>>> results(contexts.size());
+    auto current = snapshot();
+    if (!current) return results;
+
+    auto &views = PredictScratch::local().results;
+    for (size_t i = 0; i < contexts.size(); ++i) {
+        current->predict_views(contexts[i], num_predictions, views);
+        results[i] = to_string_results(views);
+    }
+    return results;
+}
+
+std::vector<std::pair<std::string, double>> TextPredictor::complete_word(
+        const std::string &text, int num_completions) {
+
+    std::string_view context;
+    std::string prefix;
+    if (!NGramModel::split_partial_word(text, context, prefix)) return {};
+
+    auto current = snapshot();
+    if (!current) return {};
+    return current->complete_word(context, prefix, num_completions);
+}
+
+bool TextPredictor::train_corpus(int fd, int64_t offset, int64_t length) {
+    std::lock_guard<std::mutex> model_lock(model_mutex_);
+    ScopedLatency latency(&stats_->histogram(STATS_CORPUS_TRAINING));
+    if (!ensure_model()) return false;
+
+    int threads = training_threads_.load(std::memory_order_relaxed);
+    LOGD("Training from corpus fd %d, offset %lld, length %lld, threads %d",
+         fd, (long long) offset, (long long) length, threads);
+    if (model_->train_corpus(fd, offset, length, threads) == 0) {
+        return false;
     }
-    return false;
+    bool saved = model_->save(model_path_);
+    publish_model();
+    return saved;
+}
+
+bool TextPredictor::save_model() {
+    std::lock_guard<std::mutex> model_lock(model_mutex_);
+    if (!model_ && !base_) return false;
+    ScopedLatency latency(&stats_->histogram(STATS_SAVE));
+    return compact_model();
 }
 
 bool TextPredictor::force_training() {
-    if (user_history_.empty()) {
+    std::unique_lock<std::mutex> lock(history_mutex_);
+    uint64_t round = scheduled_rounds_;
+    if (!user_history_.empty()) {
+        round = schedule_training_locked();
+    } else if (finished_rounds_ >= round) {
         LOGD("No history to train on");
         return false;
     }
+    // 没有新历史时也等待已排队的轮次完成
+    finished_cv_.wait(lock, [this, round] { return finished_rounds_ >= round; });
+    return last_training_ok_;
+}
 
-    LOGD("Training on %zu history entries", user_history_.size());
-    std::string all_text;
-    for (const auto &text: user_history_) {
-        all_text += text + " ";
-    }
+void TextPredictor::set_prune_options(const PruneOptions &options) {
+    std::lock_guard<std::mutex> model_lock(model_mutex_);
+    prune_options_ = options;
+}
 
-    model_->train(all_text);
-    bool saved = save_model();
-    user_history_.clear();
-    return saved;
+size_t TextPredictor::prune_model() {
+    std::lock_guard<std::mutex> model_lock(model_mutex_);
+    if (!model_ && !base_) return 0;
+
+    bool saved;
+    PruneResult result = prune_locked(prune_options_, saved);
+    if (!saved) LOGE("Failed to save pruned model");
+    return result.bytes_reclaimed();
 }
 
 void TextPredictor::clear_history() {
+    std::lock_guard<std::mutex> lock(history_mutex_);
     size_t count = user_history_.size();
     user_history_.clear();
     LOGD("Cleared %zu history entries", count);
 }
 
+TrainingStatus TextPredictor::get_training_status() const {
+    TrainingStatus status;
+    status.state = training_running_ ? TRAINING_RUNNING : TRAINING_IDLE;
+    status.progress = training_progress_;
+    status.completed_rounds = completed_rounds_;
+    status.last_succeeded = last_training_ok_;
+    return status;
+}
+
+void TextPredictor::set_training_listener(TrainingListener listener) {
+    std::lock_guard<std::mutex> lock(listener_mutex_);
+    listener_ = std::move(listener);
+}
+
 std::string TextPredictor::get_model_info() const {
-    if (!model_) return "No model available";
+    auto snapshot = std::atomic_load(&snapshot_);
+    if (!snapshot) return "No model available";
+
+    size_t history_size;
+    {
+        std::lock_guard<std::mutex> lock(history_mutex_);
+        history_size = user_history_.size();
+    }
 
     std::stringstream ss;
-    ss << "n: " << model_->get_model_data().n << "\n"
-       << "Vocabulary size: " << model_->get_model_data().vocabulary.size() << "\n"
-       << "Total words: " << model_->get_model_data().total_words << "\n"
-       << "History entries: " << user_history_.size() << "\n"
-       << "Smoothing: " << model_->get_model_data().smoothing;
+    ss << snapshot->describe() << "\n"
+       << "History entries: " << history_size;
     return ss.str();
 }
+
+StatsArray TextPredictor::get_stats() const {
+    StatsArray stats{};
+    stats[0] = STATS_FORMAT_VERSION;
+    stats_->export_to(stats);
+
+    auto snapshot = std::atomic_load(&snapshot_);
+    if (!snapshot) return stats;
+    ModelSummary summary = snapshot->summary();
+    stats[1] = summary.order;
+    stats[2] = (int64_t) summary.vocabulary_size;
+
+    ModelMemory memory = snapshot->memory_usage();
+    stats[STATS_MEMORY_INDEX] = (int64_t) memory.heap_bytes();
+    stats[STATS_MEMORY_INDEX + 1] = (int64_t) memory.mapped_bytes;
+    stats[STATS_MEMORY_INDEX + 2] = (int64_t) (memory.string_bytes + memory.vocabulary_bytes +
+                                               memory.unigram_bytes);
+    for (size_t k = 2; k < memory.orders.size() && k <= (size_t) STATS_MAX_ORDER; ++k) {
+        const OrderMemory &order = memory.orders[k];
+        stats[STATS_CONTEXTS_INDEX + k] = (int64_t) order.contexts;
+        stats[STATS_NGRAMS_INDEX + k] = (int64_t) order.ngrams;
+        stats[STATS_ORDER_HEAP_INDEX + k] = (int64_t) order.heap_bytes();
+        stats[STATS_ORDER_MAPPED_INDEX + k] = (int64_t) order.mapped_bytes;
+    }
+    return stats;
+}
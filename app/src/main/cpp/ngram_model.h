@@ -11,19 +11,50 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include "ngram_model_io.h"
+#include "ngram_model_frozen.h"
+#include "ngram_model_journal.h"
+#include "ngram_model_prune.h"
+#include "ngram_model_memory.h"
+#include "ngram_completion.h"
+#include "ngram_stats.h"
+
+// 训练语料每次读取的块大小
+const size_t CORPUS_CHUNK_SIZE = 256 * 1024;
+
+// 多线程训练时每个线程每批处理的语料大小
+const size_t PARALLEL_SHARD_SIZE = 1024 * 1024;
+
+// 模型概要，取得时不复制模型
+struct ModelSummary {
+    int order = 0;
+    double smoothing = 0.0;
+    int total_words = 0;
+    size_t vocabulary_size = 0;
+};
 
 // N元语法模型类
+//
+// 多读者/单写者：const方法（预测、保存、冻结）可以并发调用，
+// 训练和加载独占模型。两者由内部读写锁保证，调用方无需额外加锁。
 class NGramModel {
 private:
     NGramModelData data_;  // 封装的模型参数
+    mutable std::shared_mutex mutex_;
 
-    // 文本预处理和分词
-    std::vector<std::string> preprocess_text(const std::string &text);
+    // 统计一段文本的词频和n元语法（不记录日志）
+    void count_text(const std::string &text);
+
+    // 多线程统计一批完整的行并合并到模型，返回行数
+    size_t train_batch(const char *text, size_t size, int threads);
 
-    // 生成n元语法
-    std::vector<std::vector<std::string>>
-    build_ngrams(const std::vector<std::string> &words, int n);
+    size_t train_corpus_parallel(int fd, int64_t offset, int64_t length, int threads);
 
 public:
     NGramModel(int n = 3, double smoothing = 0.1) {
@@ -31,51 +62,344 @@ public:
         data_.smoothing = smoothing;
     }
 
+    NGramModel(const NGramModel &other) {
+        std::shared_lock<std::shared_mutex> lock(other.mutex_);
+        data_ = other.data_;
+    }
+
+    NGramModel &operator=(const NGramModel &) = delete;
+
+    // 文本预处理和分词
+    static std::vector<std::string> preprocess_text(const std::string &text);
+
+    // 拆出末尾尚未输入完的单词（已转为小写），文本以分隔符结尾时返回false
+    static bool split_partial_word(std::string_view text, std::string_view &context,
+                                   std::string &prefix);
+
     // 训练模型
     void train(const std::string &text);
 
+    // 从文件描述符分块读取语料并逐行训练，length为负时读到文件末尾，返回训练的行数。
+    // threads大于1时各线程统计私有计数表后按顺序合并，结果与单线程完全一致
+    size_t train_corpus(int fd, int64_t offset, int64_t length, int threads = 1);
+
+    size_t train_corpus(const std::string &file_path, int threads = 1);
+
     // 预测下一个词
     std::vector<std::pair<std::string, double>> predict_next_word(
-            const std::string &context, int num_predictions = 3);
+            const std::string &context, int num_predictions = 3) const;
+
+    // 不分配内存的预测，结果中的单词在模型重新加载前有效
+    void predict_views(std::string_view context, int num_predictions,
+                       std::vector<PredictionView> &out) const;
+
+    // 上下文已转换为单词ID（只用到最后n-1个）
+    void predict_views(const std::vector<WordId> &words, int num_predictions,
+                       std::vector<PredictionView> &out) const;
+
+    // 补全以prefix开头的单词，index需由build_prefix_index在模型不再修改后构建
+    std::vector<std::pair<std::string, double>> complete_word(
+            const std::vector<WordId> &words, std::string_view prefix,
+            const PrefixIndex &index, int num_completions = 3) const;
+
+    int order() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return data_.n;
+    }
+
+    size_t vocabulary_size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return data_.vocabulary.size();
+    }
+
+    int total_words() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return data_.total_words;
+    }
+
+    WordId find_word(std::string_view word) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return data_.vocabulary.find(word);
+    }
+
+    PrefixIndex build_prefix_index() const;
 
     // 序列化相关方法（调用工具函数）
-    bool save(const std::string &file_path) {
+    bool save(const std::string &file_path) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
         return save_model_data(data_, file_path);
     }
 
     bool load(const std::string &file_path) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
         return load_model_data(data_, file_path);
     }
 
-    auto get_model_data() {
-        return data_;
+    // 从冻结模型还原，单词ID与冻结文件一致
+    void load_frozen(const FrozenNGramModel &frozen) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        frozen.thaw(data_);
+    }
+
+    // 合并基于当前模型的增量，词汇表大小与delta.base_vocab_size不一致时返回false
+    bool apply_delta(const ModelDelta &delta);
+
+    // 按内存预算或最小次数剪枝，并收缩哈希表
+    PruneResult prune(const PruneOptions &options) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        return prune_model_data(data_, options);
+    }
+
+    ModelFootprint footprint() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return measure_model(data_);
+    }
+
+    // 实际占用的内存，需要遍历所有上下文
+    ModelMemory memory_usage() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return measure_memory(data_);
+    }
+
+    ModelSummary summary() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return {data_.n, data_.smoothing, data_.total_words, data_.vocabulary.size()};
+    }
+
+    // 写出只读冻结格式，供FrozenNGramModel映射
+    bool freeze(const std::string &file_path) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return save_frozen_model_data(data_, file_path);
+    }
+
+    // 持有读锁期间以const引用访问模型数据，不复制；f中不能调用本模型的其他方法
+    template<typename F>
+    auto read(F f) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return f(static_cast<const NGramModelData &>(data_));
     }
 };
 
-// 文本预测器类（保持不变）
+// 预测使用的只读模型快照，发布后不再修改；读者持有shared_ptr期间不会被释放。
+// stats不为空时，预测和补全的耗时及命中的最高阶数记入其中
+class ModelSnapshot {
+public:
+    // delta为空时直接查询冻结模型，否则查询两者的叠加视图
+    ModelSnapshot(std::shared_ptr<const FrozenNGramModel> frozen,
+                  std::shared_ptr<const ModelDelta> delta,
+                  std::shared_ptr<PredictorStats> stats = nullptr);
+
+    explicit ModelSnapshot(std::unique_ptr<NGramModel> model,
+                           std::shared_ptr<PredictorStats> stats = nullptr)
+            : model_(std::move(model)), stats_(std::move(stats)) {}
+
+    int order() const;
+
+    // 叠加日志时，次数和词汇表包含增量
+    ModelSummary summary() const;
+
+    // 叠加日志时为冻结文件的映射加上增量占用的堆内存。需要遍历所有上下文
+    ModelMemory memory_usage() const;
+
+    // 单词ID只在同一个快照内有意义
+    WordId find_word(std::string_view word) const;
+
+    // 结果中的单词指向快照内部存储，持有快照期间有效
+    void predict_views(std::string_view context, int num_predictions,
+                       std::vector<PredictionView> &out) const;
+
+    void predict_views(const std::vector<WordId> &words, int num_predictions,
+                       std::vector<PredictionView> &out) const;
+
+    std::vector<std::pair<std::string, double>> predict_next_word(
+            std::string_view context, int num_predictions) const;
+
+    // 补全前缀，首次调用时构建前缀索引
+    std::vector<std::pair<std::string, double>> complete_word(
+            std::string_view context, std::string_view prefix, int num_completions) const;
+
+    std::vector<std::pair<std::string, double>> complete_word(
+            const std::vector<WordId> &words, std::string_view prefix, int num_completions) const;
+
+    // 模型概要信息，每行一项
+    std::string describe() const;
+
+private:
+    std::shared_ptr<const FrozenNGramModel> frozen_;
+    std::unique_ptr<OverlayNGramModel> overlay_;
+    std::unique_ptr<NGramModel> model_;
+    std::shared_ptr<PredictorStats> stats_;
+
+    mutable std::once_flag index_once_;
+    mutable std::unique_ptr<PrefixIndex> index_;
+};
+
+// 后台训练状态
+enum TrainingState {
+    TRAINING_IDLE = 0,
+    TRAINING_RUNNING = 1
+};
+
+struct TrainingStatus {
+    int state = TRAINING_IDLE;
+    int progress = 0;            // 当前轮次进度，0-100
+    int completed_rounds = 0;
+    bool last_succeeded = false;
+};
+
+// 训练进度回调：progress为0-100，finished表示本轮结束，success表示是否保存成功
+using TrainingListener = std::function<void(int progress, bool finished, bool success)>;
+
+// 文本预测器类
+//
+// 所有公有方法都可以从多个线程并发调用。预测只读取原子发布的ModelSnapshot，
+// 不加锁；训练和保存在后台线程完成（唯一写者，持有model_mutex_），
+// 结束后用新快照替换旧快照（RCU方式），旧快照在最后一个读者释放后销毁。
+//
+// 持久化：冻结文件是基础模型，每轮历史训练只把新增计数追加到增量日志，
+// 日志超过JOURNAL_COMPACT_SIZE后才合并成新的基础模型（同时重写.bin和冻结文件）。
 class TextPredictor {
 private:
+    // 可训练模型，仅在持有model_mutex_时访问；有基础模型时只在合并或语料训练时加载
     std::unique_ptr<NGramModel> model_;
+    std::shared_ptr<const ModelSnapshot> snapshot_;  // 通过std::atomic_load/store访问
+    // 以下两项仅在持有model_mutex_时访问；base_为空时退回到每轮完整保存
+    std::shared_ptr<const FrozenNGramModel> base_;
+    std::shared_ptr<const ModelDelta> delta_;    // 日志中累计的增量
     std::string model_path_;
-    std::vector<std::string> user_history_;
+    std::string frozen_path_;
+    std::string journal_path_;
+    int n_;
+    std::atomic<int> training_threads_{1};  // 可在训练进行中修改，下次语料训练生效
     static const int HISTORY_THRESHOLD = 100;
+    static const size_t JOURNAL_COMPACT_SIZE = 512 * 1024;
+    // 自动剪枝到预算以下这个比例，避免之后每轮训练都再次超出预算
+    static const size_t PRUNE_HEADROOM_PERCENT = 10;
+    PruneOptions prune_options_;  // 仅在持有model_mutex_时访问
+
+    std::mutex model_mutex_;
+
+    // 以下成员受history_mutex_保护
+    mutable std::mutex history_mutex_;
+    std::condition_variable training_cv_;
+    std::condition_variable finished_cv_;
+    std::vector<std::string> user_history_;
+    std::vector<std::string> pending_history_;  // 已提交给后台线程、尚未训练的历史
+    uint64_t scheduled_rounds_ = 0;
+    uint64_t finished_rounds_ = 0;
+    bool stopping_ = false;
+    std::thread worker_;
+
+    std::atomic<bool> training_running_{false};
+    std::atomic<int> training_progress_{0};
+    std::atomic<int> completed_rounds_{0};
+    std::atomic<bool> last_training_ok_{false};
+
+    // 与发布的快照共享，快照可能比预测器晚释放
+    std::shared_ptr<PredictorStats> stats_ = std::make_shared<PredictorStats>();
+
+    std::mutex listener_mutex_;
+    TrainingListener listener_;
+
+    // 映射冻结文件作为基础模型，重放日志并发布（需持有model_mutex_），无法打开时返回false
+    bool open_frozen_base();
+
+    // 原子替换当前快照
+    void publish_snapshot(std::shared_ptr<const ModelSnapshot> snapshot);
+
+    // 确保可训练模型已加载，有基础模型时还原基础模型并合并增量（需持有model_mutex_）
+    bool ensure_model();
+
+    // 由可训练模型生成冻结文件作为新的基础模型并发布，同时清空日志（需持有model_mutex_）
+    void publish_model();
+
+    // 把基础模型和增量合并写回.bin和冻结文件（需持有model_mutex_）
+    bool compact_model();
+
+    // 估算的模型内存是否超过预算（需持有model_mutex_）
+    bool over_memory_budget() const;
+
+    // 自动剪枝使用的选项：目标为预算减去余量
+    PruneOptions auto_prune_options() const;
+
+    // 剪枝可训练模型后写回.bin并发布（需持有model_mutex_）
+    PruneResult prune_locked(const PruneOptions &options, bool &saved);
+
+    // 把当前历史交给后台线程，返回本次提交对应的轮次（需持有history_mutex_）
+    uint64_t schedule_training_locked();
+
+    // 后台训练线程主循环
+    void training_loop();
+
+    // 训练一批历史并保存、发布
+    bool run_training(const std::vector<std::string> &history);
+
+    void report_progress(int progress, bool finished, bool success);
 
 public:
     TextPredictor(const std::string &model_path, int n = 3,
                   const std::vector<std::string> *sample_texts = nullptr);
 
+    // 等待排队中的训练完成后停止后台线程
+    ~TextPredictor();
+
+    TextPredictor(const TextPredictor &) = delete;
+
+    TextPredictor &operator=(const TextPredictor &) = delete;
+
+    // 达到阈值时提交后台训练，不阻塞调用线程
     void add_to_history(const std::string &text);
 
     std::vector<std::pair<std::string, double>>
     predict(const std::string &context, int num_predictions = 3);
 
+    // 创建时指定的n元模型阶数
+    int order() const { return n_; }
+
+    const std::string &model_path() const { return model_path_; }
+
+    // 当前模型快照，可能为空。持有期间快照中的单词存储不会被释放
+    std::shared_ptr<const ModelSnapshot> snapshot() const { return std::atomic_load(&snapshot_); }
+
+    // 在同一个模型快照上依次预测多个上下文
+    std::vector<std::vector<std::pair<std::string, double>>>
+    predict_batch(const std::vector<std::string> &contexts, int num_predictions = 3);
+
+    // 补全text末尾正在输入的单词，并按前面的上下文加权排序
+    std::vector<std::pair<std::string, double>>
+    complete_word(const std::string &text, int num_completions = 3);
+
+    // 语料训练使用的线程数
+    void set_training_threads(int threads) {
+        training_threads_.store(std::max(threads, 1), std::memory_order_relaxed);
+    }
+
+    // 首次启动时从语料文件训练并保存，fd由调用方负责关闭
+    bool train_corpus(int fd, int64_t offset, int64_t length);
+
+    // 合并日志并完整保存模型
     bool save_model();
 
+    // 立即提交当前历史训练，并等待后台线程完成本轮及之前排队的轮次。
+    // 设置了内存预算时，每轮训练后超出预算会自动剪枝
     bool force_training();
 
+    // memory_budget为0时不自动剪枝；min_count只在剪枝时生效
+    void set_prune_options(const PruneOptions &options);
+
+    // 立即按当前选项剪枝并保存，返回回收的估算字节数
+    size_t prune_model();
+
     void clear_history();
 
+    TrainingStatus get_training_status() const;
+
+    void set_training_listener(TrainingListener listener);
+
     std::string get_model_info() const;
+
+    // 运行统计和当前快照各阶的规模，布局见ngram_stats.h。规模需要遍历模型，不要在输入路径上调用
+    StatsArray get_stats() const;
 };
 
 #endif // NGRAM_MODEL_H
@@ -0,0 +1,610 @@
+#include "ngram_model_frozen.h"
+#include "ngram_model.h"
+#include "ngram_predict.h"
+#include "jni_log.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+size_t align_up(size_t value) {
+    return (value + 7) & ~static_cast<size_t>(7);
+}
+
+// 冻结模型中一阶的各个数组
+struct FrozenOrderSections {
+    std::vector<uint32_t> context_words;
+    std::vector<FrozenContext> contexts;
+    std::vector<FrozenSuccessor> successors;
+    std::vector<FrozenOverflow> overflow;
+};
+
+// 能容纳0..vocab_size-1的最少位数
+uint32_t word_bits_for(size_t vocab_size) {
+    uint32_t bits = 1;
+    while (bits < 32 && (size_t(1) << bits) < vocab_size) ++bits;
+    return bits;
+}
+
+// 顺序写入各段，每段结尾补齐到8字节
+class SectionWriter {
+public:
+    explicit SectionWriter(FILE *fp) : fp_(fp) {}
+
+    bool write(const void *data, size_t bytes) {
+        if (bytes > 0 && fwrite(data, bytes, 1, fp_) != 1) return false;
+        offset_ += bytes;
+
+        static const char zeros[8] = {};
+        size_t padding = align_up(offset_) - offset_;
+        if (padding > 0 && fwrite(zeros, padding, 1, fp_) != 1) return false;
+        offset_ += padding;
+        return true;
+    }
+
+    template<typename T>
+    bool write(const std::vector<T> &values) {
+        return write(values.data(), values.size() * sizeof(T));
+    }
+
+private:
+    FILE *fp_;
+    size_t offset_ = 0;
+};
+
+bool build_order_sections(const ContextMap *context_map, int order, uint32_t word_bits,
+                          FrozenOrderSections &sections) {
+    const uint32_t count_escape = UINT32_MAX >> word_bits;
+    auto push = [&](WordId word, int count) {
+        uint32_t packed = std::min((uint32_t) count, count_escape);
+        if (packed == count_escape) {
+            sections.overflow.push_back({(uint32_t) sections.successors.size(), (uint32_t) count});
+        }
+        sections.successors.push_back(word | packed << word_bits);
+    };
+
+    // 上下文按字典序排列，查询时二分查找
+    std::vector<std::pair<ContextKey, const ContextEntry *>> entries;
+    if (context_map && !context_map->empty()) {
+        if ((int) context_map->width() != order - 1) {
+            LOGE("Context length %zu does not match order %d", context_map->width(), order);
+            return false;
+        }
+        entries.reserve(context_map->size());
+        for (const auto &entry: *context_map) {
+            entries.emplace_back(entry.first, &entry.second);
+        }
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    sections.context_words.reserve(entries.size() * (order - 1));
+    sections.contexts.reserve(entries.size() + 1);
+
+    std::vector<std::pair<WordId, int>> sorted;
+    for (const auto &entry: entries) {
+        const ContextEntry &context = *entry.second;
+        sections.context_words.insert(sections.context_words.end(),
+                                      entry.first.begin(), entry.first.end());
+        sections.contexts.push_back({(uint32_t) context.total,
+                                     (uint32_t) sections.successors.size(), FROZEN_NO_CONTEXT});
+
+        // top包含全部后继词时不必再存一份按ID排列的列表
+        for (const auto &successor: context.top) {
+            push(successor.first, successor.second);
+        }
+        if (context.top.size() == context.successors.size()) continue;
+
+        sorted.assign(context.successors.begin(), context.successors.end());
+        std::sort(sorted.begin(), sorted.end());
+        for (const auto &successor: sorted) {
+            push(successor.first, successor.second);
+        }
+        if (sections.successors.size() > UINT32_MAX) {
+            LOGE("Too many successors to freeze for order %d", order);
+            return false;
+        }
+    }
+    sections.contexts.push_back({0, (uint32_t) sections.successors.size(), FROZEN_NO_CONTEXT});
+    return true;
+}
+
+// 为order阶的每个上下文找到去掉第一个词后在低一阶中的下标。
+// 高阶上下文的后继词一定也是低阶后继词，低阶上下文总是存在
+void link_backoff(FrozenOrderSections &sections, const FrozenOrderSections &lower, int order) {
+    const size_t width = order - 1;
+    const size_t lower_count = lower.contexts.size() - 1;
+    const uint32_t *lower_words = lower.context_words.data();
+    for (size_t c = 0; c + 1 < sections.contexts.size(); ++c) {
+        const uint32_t *suffix = sections.context_words.data() + c * width + 1;
+        size_t lo = 0;
+        size_t hi = lower_count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            const uint32_t *key = lower_words + mid * (width - 1);
+            if (std::lexicographical_compare(key, key + width - 1, suffix, suffix + width - 1)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < lower_count &&
+            std::equal(suffix, suffix + width - 1, lower_words + lo * (width - 1))) {
+            sections.contexts[c].backoff_index = (uint32_t) lo;
+        }
+    }
+}
+
+} // namespace
+
+bool save_frozen_model_data(const NGramModelData &data, const std::string &file_path) {
+    if (data.n < 1 || data.n - 1 > FROZEN_MAX_ORDERS) {
+        LOGE("Cannot freeze model with n=%d", data.n);
+        return false;
+    }
+
+    uint32_t vocab_size = data.vocabulary.size();
+    if (data.word_count.size() != vocab_size || data.unigram_rank.size() != vocab_size) {
+        LOGE("Inconsistent vocabulary tables, cannot freeze model");
+        return false;
+    }
+
+    // 词汇表相关数组
+    std::vector<uint32_t> word_offsets;
+    std::vector<char> string_pool;
+    word_offsets.reserve(vocab_size + 1);
+    for (WordId id = 0; id < vocab_size; ++id) {
+        const std::string &word = data.vocabulary.word(id);
+        word_offsets.push_back(string_pool.size());
+        string_pool.insert(string_pool.end(), word.begin(), word.end());
+        string_pool.push_back('\0');
+    }
+    word_offsets.push_back(string_pool.size());
+
+    // 单词查找表：完美哈希位置 -> 单词ID
+    std::vector<std::string_view> keys(data.vocabulary.words.begin(),
+                                       data.vocabulary.words.end());
+    PerfectHashTables hash_tables;
+    if (!build_perfect_hash(keys, hash_tables)) {
+        LOGE("Failed to build word hash, cannot freeze model");
+        return false;
+    }
+    PerfectHash word_hash(hash_tables, vocab_size);
+    std::vector<uint32_t> word_slots(vocab_size);
+    for (WordId id = 0; id < vocab_size; ++id) {
+        word_slots[word_hash.position(keys[id])] = id;
+    }
+
+    std::vector<uint32_t> word_count(data.word_count.begin(), data.word_count.end());
+    std::vector<uint32_t> unigram_rank(data.unigram_rank.begin(), data.unigram_rank.end());
+
+    // 各阶数组
+    uint32_t word_bits = word_bits_for(vocab_size);
+    int order_count = data.n - 1;
+    std::vector<FrozenOrderSections> orders(order_count);
+    for (int i = 0; i < order_count; ++i) {
+        int order = i + 2;
+        auto it = data.models.find(order);
+        if (!build_order_sections(it == data.models.end() ? nullptr : &it->second,
+                                  order, word_bits, orders[i])) {
+            return false;
+        }
+        if (i > 0) link_backoff(orders[i], orders[i - 1], order);
+    }
+
+    // 计算各段偏移量
+    FrozenHeader header{};
+    memcpy(header.magic, FROZEN_MODEL_MAGIC, sizeof(header.magic));
+    header.version = FROZEN_MODEL_VERSION;
+    header.n = data.n;
+    header.smoothing = data.smoothing;
+    header.total_words = data.total_words;
+    header.vocab_size = vocab_size;
+    header.order_count = order_count;
+    header.word_bits = word_bits;
+    header.top_k = TOP_K_SUCCESSORS;
+    header.hash_seed = hash_tables.seed;
+    header.hash_buckets = hash_tables.bucket_count;
+    header.hash_slots = hash_tables.slot_count;
+
+    size_t offset = align_up(sizeof(FrozenHeader));
+    auto place = [&offset](uint64_t &field, size_t bytes) {
+        field = offset;
+        offset = align_up(offset + bytes);
+    };
+    place(header.word_offsets_offset, word_offsets.size() * sizeof(uint32_t));
+    place(header.string_pool_offset, string_pool.size());
+    place(header.word_slots_offset, word_slots.size() * sizeof(uint32_t));
+    place(header.hash_pilots_offset, hash_tables.pilots.size() * sizeof(uint16_t));
+    place(header.hash_remap_offset, hash_tables.remap.size() * sizeof(uint32_t));
+    place(header.word_count_offset, word_count.size() * sizeof(uint32_t));
+    place(header.unigram_rank_offset, unigram_rank.size() * sizeof(uint32_t));
+    for (int i = 0; i < order_count; ++i) {
+        FrozenOrder &order = header.orders[i];
+        order.order = i + 2;
+        order.context_count = orders[i].contexts.size() - 1;
+        order.successor_total = orders[i].successors.size();
+        order.overflow_count = orders[i].overflow.size();
+        place(order.context_words_offset, orders[i].context_words.size() * sizeof(uint32_t));
+        place(order.contexts_offset, orders[i].contexts.size() * sizeof(FrozenContext));
+        place(order.successors_offset, orders[i].successors.size() * sizeof(FrozenSuccessor));
+        place(order.overflow_offset, orders[i].overflow.size() * sizeof(FrozenOverflow));
+    }
+    header.file_size = offset;
+
+    // 写临时文件后rename，保证读者看到的总是完整文件
+    std::string tmp_path = file_path + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "wb");
+    if (!fp) {
+        LOGE("Failed to open file for freezing: %s", tmp_path.c_str());
+        return false;
+    }
+
+    SectionWriter writer(fp);
+    bool ok = writer.write(&header, sizeof(header)) &&
+              writer.write(word_offsets) &&
+              writer.write(string_pool) &&
+              writer.write(word_slots) &&
+              writer.write(hash_tables.pilots) &&
+              writer.write(hash_tables.remap) &&
+              writer.write(word_count) &&
+              writer.write(unigram_rank);
+    for (int i = 0; ok && i < order_count; ++i) {
+        ok = writer.write(orders[i].context_words) &&
+             writer.write(orders[i].contexts) &&
+             writer.write(orders[i].successors) &&
+             writer.write(orders[i].overflow);
+    }
+
+    if (!close_synced(fp)) ok = false;
+    if (!ok) {
+        LOGE("Failed to write frozen model: %s", tmp_path.c_str());
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    if (rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+        LOGE("Failed to rename frozen model to %s", file_path.c_str());
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    LOGD("Frozen model saved: %zu bytes", (size_t) header.file_size);
+    return true;
+}
+
+std::unique_ptr<FrozenNGramModel> FrozenNGramModel::open(const std::string &file_path) {
+    int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGD("No frozen model at %s", file_path.c_str());
+        return nullptr;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(FrozenHeader)) {
+        LOGE("Frozen model too small: %s", file_path.c_str());
+        close(fd);
+        return nullptr;
+    }
+
+    size_t size = st.st_size;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        LOGE("Failed to mmap frozen model: %s", file_path.c_str());
+        return nullptr;
+    }
+
+    // 查询是随机访问，按需分页
+    madvise(mapped, size, MADV_RANDOM);
+
+    std::unique_ptr<FrozenNGramModel> model(new FrozenNGramModel());
+    model->base_ = static_cast<const uint8_t *>(mapped);
+    model->size_ = size;
+
+    // 只校验头部和各段边界，与模型大小无关
+    const auto *header = reinterpret_cast<const FrozenHeader *>(model->base_);
+    auto section_ok = [size](uint64_t offset, uint64_t count, uint64_t element_size) {
+        return offset % 4 == 0 && offset <= size &&
+               (element_size == 0 || count <= (size - offset) / element_size);
+    };
+
+    uint32_t vocab_size = header->vocab_size;
+    bool valid = memcmp(header->magic, FROZEN_MODEL_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == FROZEN_MODEL_VERSION &&
+                 header->file_size == size &&
+                 header->n >= 1 &&
+                 header->order_count == header->n - 1 &&
+                 header->order_count <= (uint32_t) FROZEN_MAX_ORDERS &&
+                 header->word_bits >= 1 && header->word_bits < 32 &&
+                 (header->word_bits == 31 || vocab_size <= (1u << header->word_bits)) &&
+                 header->top_k >= 1 &&
+                 section_ok(header->word_offsets_offset, (uint64_t) vocab_size + 1, 4) &&
+                 (vocab_size == 0 ? header->hash_buckets == 0
+                                  : header->hash_buckets >= 1 &&
+                                    header->hash_slots >= vocab_size) &&
+                 section_ok(header->word_slots_offset, vocab_size, 4) &&
+                 section_ok(header->hash_pilots_offset, header->hash_buckets, 2) &&
+                 section_ok(header->hash_remap_offset,
+                            (uint64_t) header->hash_slots - vocab_size, 4) &&
+                 section_ok(header->word_count_offset, vocab_size, 4) &&
+                 section_ok(header->unigram_rank_offset, vocab_size, 4) &&
+                 section_ok(header->string_pool_offset, 0, 0);
+
+    for (uint32_t i = 0; valid && i < header->order_count; ++i) {
+        const FrozenOrder &order = header->orders[i];
+        valid = order.order == i + 2 &&
+                order.context_count < UINT64_MAX / order.order &&
+                order.successor_total <= UINT32_MAX &&
+                section_ok(order.context_words_offset,
+                           order.context_count * (order.order - 1), 4) &&
+                section_ok(order.contexts_offset, order.context_count + 1, sizeof(FrozenContext)) &&
+                section_ok(order.successors_offset, order.successor_total,
+                           sizeof(FrozenSuccessor)) &&
+                section_ok(order.overflow_offset, order.overflow_count, sizeof(FrozenOverflow));
+    }
+
+    if (!valid) {
+        LOGE("Invalid frozen model header: %s", file_path.c_str());
+        return nullptr;
+    }
+
+    model->header_ = header;
+    model->word_offsets_ = reinterpret_cast<const uint32_t *>(
+            model->base_ + header->word_offsets_offset);
+    model->string_pool_ = reinterpret_cast<const char *>(
+            model->base_ + header->string_pool_offset);
+    model->word_slots_ = reinterpret_cast<const uint32_t *>(
+            model->base_ + header->word_slots_offset);
+    model->word_hash_ = PerfectHash(
+            header->hash_seed, vocab_size, header->hash_buckets, header->hash_slots,
+            reinterpret_cast<const uint16_t *>(model->base_ + header->hash_pilots_offset),
+            reinterpret_cast<const uint32_t *>(model->base_ + header->hash_remap_offset));
+    model->word_count_ = reinterpret_cast<const uint32_t *>(
+            model->base_ + header->word_count_offset);
+    model->unigram_rank_ = reinterpret_cast<const uint32_t *>(
+            model->base_ + header->unigram_rank_offset);
+
+    if (!section_ok(header->string_pool_offset, model->word_offsets_[vocab_size], 1)) {
+        LOGE("Invalid frozen model string pool: %s", file_path.c_str());
+        return nullptr;
+    }
+
+    LOGD("Frozen model mapped: %zu bytes, vocabulary %u", size, vocab_size);
+    return model;
+}
+
+FrozenNGramModel::~FrozenNGramModel() {
+    if (base_) {
+        munmap(const_cast<uint8_t *>(base_), size_);
+    }
+}
+
+std::string_view FrozenNGramModel::word(WordId id) const {
+    if (id >= header_->vocab_size) return {};
+
+    uint32_t begin = word_offsets_[id];
+    uint32_t end = word_offsets_[id + 1];
+    if (begin >= end || end > word_offsets_[header_->vocab_size]) return {};
+    return {string_pool_ + begin, end - begin - 1};
+}
+
+WordId FrozenNGramModel::find_word(std::string_view target) const {
+    // remap损坏时位置可能越界
+    uint32_t slot = word_hash_.position(target);
+    if (slot >= header_->vocab_size) return INVALID_WORD_ID;
+
+    WordId id = word_slots_[slot];
+    return word(id) == target ? id : INVALID_WORD_ID;
+}
+
+int FrozenNGramModel::Context::count_at(uint32_t i) const {
+    uint32_t count = successors_[i] >> word_bits_;
+    if (count != UINT32_MAX >> word_bits_) return (int) count;
+
+    uint32_t index = first_index_ + i;
+    const FrozenOverflow *end = overflow_ + overflow_count_;
+    const FrozenOverflow *it = std::lower_bound(overflow_, end, index, [](const FrozenOverflow &o, uint32_t v) {
+        return o.index < v;
+    });
+    return it != end && it->index == index ? (int) it->count : (int) count;
+}
+
+int FrozenNGramModel::Context::count_of(WordId id) const {
+    // 全部后继词都在按次数排列的部分时项数不超过top_k，直接顺序查找
+    if (ranked_ == range_) {
+        for (uint32_t i = 0; i < range_; ++i) {
+            if (word_at(i) == id) return count_at(i);
+        }
+        return 0;
+    }
+
+    uint32_t lo = ranked_;
+    uint32_t hi = range_;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (word_at(mid) < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < range_ && word_at(lo) == id ? count_at(lo) : 0;
+}
+
+FrozenNGramModel::Context FrozenNGramModel::context_at(uint32_t order_index, uint64_t index) const {
+    const FrozenOrder &order = header_->orders[order_index];
+    const auto *contexts = reinterpret_cast<const FrozenContext *>(
+            base_ + order.contexts_offset) + index;
+    uint32_t begin = contexts[0].successor_index;
+    uint32_t end = contexts[1].successor_index;
+    if (begin > end || end > order.successor_total) {
+        LOGE("Corrupt successor range in frozen model");
+        return {};
+    }
+
+    Context context;
+    context.successors_ = reinterpret_cast<const FrozenSuccessor *>(
+            base_ + order.successors_offset) + begin;
+    context.overflow_ = reinterpret_cast<const FrozenOverflow *>(base_ + order.overflow_offset);
+    context.overflow_count_ = order.overflow_count;
+    context.first_index_ = begin;
+    context.range_ = end - begin;
+    context.ranked_ = std::min(context.range_, header_->top_k);
+    context.total_ = contexts[0].total;
+    context.backoff_index_ = contexts[0].backoff_index;
+    context.word_bits_ = header_->word_bits;
+    context.word_mask_ = (1u << header_->word_bits) - 1;
+    return context;
+}
+
+FrozenNGramModel::Context FrozenNGramModel::find_context(int n_size, const WordId *ids) const {
+    if (n_size < 2 || n_size - 2 >= (int) header_->order_count) return {};
+
+    const FrozenOrder &order = header_->orders[n_size - 2];
+    const size_t width = n_size - 1;
+    const auto *context_words = reinterpret_cast<const uint32_t *>(
+            base_ + order.context_words_offset);
+
+    // 在按字典序排列的上下文中二分查找
+    size_t lo = 0;
+    size_t hi = order.context_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const uint32_t *key = context_words + mid * width;
+        if (std::lexicographical_compare(key, key + width, ids, ids + width)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == order.context_count || !std::equal(ids, ids + width, context_words + lo * width)) {
+        return {};
+    }
+
+    return context_at(n_size - 2, lo);
+}
+
+FrozenNGramModel::Context FrozenNGramModel::backoff_context(int n_size, const WordId *ids,
+                                                            const Context &context) const {
+    if (n_size < 3 || n_size - 2 > (int) header_->order_count) return {};
+
+    // 下标损坏或缺失时退回查找
+    uint32_t lower = n_size - 3;
+    if (context.backoff_index_ >= header_->orders[lower].context_count) {
+        return find_context(n_size - 1, ids + 1);
+    }
+    return context_at(lower, context.backoff_index_);
+}
+
+void FrozenNGramModel::predict_views(std::string_view context, int num_predictions,
+                                     std::vector<PredictionView> &out) const {
+    predict_word_views(*this, context, num_predictions, PredictScratch::local(), out);
+}
+
+void FrozenNGramModel::predict_views(const std::vector<WordId> &words, int num_predictions,
+                                     std::vector<PredictionView> &out) const {
+    predict_id_views(*this, words, num_predictions, PredictScratch::local(), out);
+}
+
+std::vector<std::pair<std::string, double>> FrozenNGramModel::predict_next_word(
+        const std::string &context, int num_predictions) const {
+    std::vector<PredictionView> views;
+    predict_views(context, num_predictions, views);
+    return to_string_results(views);
+}
+
+std::vector<std::pair<std::string, double>> FrozenNGramModel::complete_word(
+        const std::vector<WordId> &words, std::string_view prefix,
+        const PrefixIndex &index, int num_completions) const {
+
+    auto ranked = complete_word_ids(*this, index, words, prefix, num_completions);
+
+    std::vector<std::pair<std::string, double>> result;
+    result.reserve(ranked.size());
+    for (const auto &entry: ranked) {
+        result.emplace_back(std::string(word(entry.first)), entry.second);
+    }
+    return result;
+}
+
+void FrozenNGramModel::count_entries(size_t &contexts, size_t &successors,
+                                     size_t &ranked) const {
+    contexts = successors = ranked = 0;
+    for (uint32_t i = 0; i < header_->order_count; ++i) {
+        const FrozenOrder &order = header_->orders[i];
+        for (uint64_t c = 0; c < order.context_count; ++c) {
+            Context context = context_at(i, c);
+            successors += context.size();
+            ranked += std::min(context.size(), (size_t) TOP_K_SUCCESSORS);
+        }
+        contexts += order.context_count;
+    }
+}
+
+void FrozenNGramModel::count_order(int n_size, size_t &contexts, size_t &successors) const {
+    contexts = successors = 0;
+    for (uint32_t i = 0; i < header_->order_count; ++i) {
+        const FrozenOrder &order = header_->orders[i];
+        if ((int) order.order != n_size) continue;
+        for (uint64_t c = 0; c < order.context_count; ++c) {
+            successors += context_at(i, c).size();
+        }
+        contexts += order.context_count;
+    }
+}
+
+size_t FrozenNGramModel::order_bytes(int n_size) const {
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < header_->order_count; ++i) {
+        const FrozenOrder &order = header_->orders[i];
+        if ((int) order.order != n_size) continue;
+        bytes += order.context_count * (order.order - 1) * sizeof(uint32_t) +
+                 (order.context_count + 1) * sizeof(FrozenContext) +
+                 order.successor_total * sizeof(FrozenSuccessor) +
+                 order.overflow_count * sizeof(FrozenOverflow);
+    }
+    return bytes;
+}
+
+void FrozenNGramModel::thaw(NGramModelData &data) const {
+    data = NGramModelData();
+    data.n = header_->n;
+    data.smoothing = header_->smoothing;
+    data.total_words = (int) header_->total_words;
+
+    const uint32_t vocab_size = header_->vocab_size;
+    data.word_count.resize(vocab_size);
+    data.vocabulary.ids.reserve(vocab_size);
+    for (uint32_t id = 0; id < vocab_size; ++id) {
+        data.vocabulary.intern(word(id));
+        data.word_count[id] = (int) word_count_[id];
+    }
+    data.rebuild_unigram_rank();
+
+    for (uint32_t i = 0; i < header_->order_count; ++i) {
+        const FrozenOrder &order = header_->orders[i];
+        const size_t width = order.order - 1;
+        const auto *context_words = reinterpret_cast<const uint32_t *>(
+                base_ + order.context_words_offset);
+
+        auto &context_map = data.models[order.order];
+        context_map.reserve(order.context_count);
+        for (uint64_t c = 0; c < order.context_count; ++c) {
+            Context context = context_at(i, c);
+            if (!context) continue;
+
+            const uint32_t *key = context_words + c * width;
+            ContextEntry &entry = context_map[ContextKey(key, width)];
+            entry.reserve(context.size());
+            context.for_each_ranked(SIZE_MAX, [&entry](WordId word, int count) {
+                entry.emplace(word, count);
+            });
+            entry.rebuild();
+        }
+    }
+}
@@ -0,0 +1,233 @@
+#ifndef NGRAM_MODEL_FROZEN_H
+#define NGRAM_MODEL_FROZEN_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ngarm_model_data.h"
+#include "ngram_backoff.h"
+#include "ngram_completion.h"
+#include "ngram_perfect_hash.h"
+
+// 只读冻结模型格式：所有数据均为定长、8字节对齐的数组，通过偏移量互相引用，
+// 可直接mmap后查询，无需反序列化。
+//
+// 文件布局（偏移量均相对文件开头）：
+//   FrozenHeader
+//   word_offsets   uint32[vocab_size + 1]  单词在字符串池中的起始位置
+//   string_pool    char[]                   以'\0'结尾的单词
+//   word_slots     uint32[vocab_size]       完美哈希位置对应的单词ID
+//   hash_pilots    uint16[hash_buckets]     完美哈希各桶的pilot
+//   hash_remap     uint32[hash_slots - vocab_size]
+//   word_count     uint32[vocab_size]
+//   unigram_rank   uint32[vocab_size]       按次数降序、ID升序排列的单词ID
+//   每一阶：
+//     context_words  uint32[context_count * (order - 1)]  按字典序排列的上下文
+//     contexts       FrozenContext[context_count + 1]     最后一项只用于确定区间终点
+//     successors     FrozenSuccessor[successor_total]
+//     overflow       FrozenOverflow[overflow_count]       按下标排列的大次数
+
+const char FROZEN_MODEL_MAGIC[8] = {'N', 'G', 'R', 'A', 'M', 'F', 'Z', 'N'};
+// 版本2：后继词打包为4字节，后继词不多的上下文不再重复存储top
+// 版本3：单词查找由按字典序二分改为最小完美哈希
+// 版本4：上下文保存低一阶上下文的下标，用于插值平滑
+const uint32_t FROZEN_MODEL_VERSION = 4;
+const int FROZEN_MAX_ORDERS = 8;  // 最多支持9元模型
+
+// 后继词：低word_bits位是单词ID，其余高位是次数。
+// 次数放不下时高位全为1，真实次数在本阶的overflow表中按后继词下标查找
+using FrozenSuccessor = uint32_t;
+
+struct FrozenOverflow {
+    uint32_t index;
+    uint32_t count;
+};
+
+// 上下文的后继词区间为[successor_index, 下一个上下文的successor_index)。
+// 后继词不超过top_k个时，区间内是按次数降序、ID升序排列的全部后继词；
+// 否则先是top_k个按次数排列的词，随后是按ID升序排列的全部后继词。
+// backoff_index是去掉第一个词后的上下文在低一阶中的下标，二阶上下文为FROZEN_NO_CONTEXT
+struct FrozenContext {
+    uint32_t total;
+    uint32_t successor_index;
+    uint32_t backoff_index;
+};
+
+const uint32_t FROZEN_NO_CONTEXT = UINT32_MAX;
+
+struct FrozenOrder {
+    uint32_t order;
+    uint32_t overflow_count;
+    uint64_t context_count;
+    uint64_t context_words_offset;
+    uint64_t contexts_offset;
+    uint64_t successors_offset;
+    uint64_t successor_total;
+    uint64_t overflow_offset;
+};
+
+struct FrozenHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t n;
+    double smoothing;
+    uint64_t total_words;
+    uint64_t file_size;
+    uint32_t vocab_size;
+    uint32_t order_count;
+    uint32_t word_bits;
+    uint32_t top_k;
+    uint64_t hash_seed;
+    uint32_t hash_buckets;
+    uint32_t hash_slots;
+    uint64_t word_offsets_offset;
+    uint64_t string_pool_offset;
+    uint64_t word_slots_offset;
+    uint64_t hash_pilots_offset;
+    uint64_t hash_remap_offset;
+    uint64_t word_count_offset;
+    uint64_t unigram_rank_offset;
+    FrozenOrder orders[FROZEN_MAX_ORDERS];
+};
+
+// 将模型写成冻结格式（先写临时文件再rename，已映射的旧文件不受影响）
+bool save_frozen_model_data(const NGramModelData &data, const std::string &file_path);
+
+// mmap冻结模型并直接在映射内存上查询
+class FrozenNGramModel {
+public:
+    // 映射并校验文件，失败返回nullptr
+    static std::unique_ptr<FrozenNGramModel> open(const std::string &file_path);
+
+    ~FrozenNGramModel();
+
+    FrozenNGramModel(const FrozenNGramModel &) = delete;
+
+    FrozenNGramModel &operator=(const FrozenNGramModel &) = delete;
+
+    // 预测下一个词
+    std::vector<std::pair<std::string, double>> predict_next_word(
+            const std::string &context, int num_predictions = 3) const;
+
+    void predict_views(std::string_view context, int num_predictions,
+                       std::vector<PredictionView> &out) const;
+
+    void predict_views(const std::vector<WordId> &words, int num_predictions,
+                       std::vector<PredictionView> &out) const;
+
+    std::vector<std::pair<std::string, double>> complete_word(
+            const std::vector<WordId> &words, std::string_view prefix,
+            const PrefixIndex &index, int num_completions = 3) const;
+
+    PrefixIndex build_prefix_index() const { return PrefixIndex(*this); }
+
+    // 完美哈希查找单词ID，再比较一次单词确认，不存在时返回INVALID_WORD_ID
+    WordId find_word(std::string_view word) const;
+
+    std::string_view word(WordId id) const;
+
+    // 还原为可训练的内存模型数据，单词ID保持不变
+    void thaw(NGramModelData &data) const;
+
+    // 供predict_word_ids使用的接口
+    class Context {
+    public:
+        Context() = default;
+
+        explicit operator bool() const { return successors_ != nullptr; }
+
+        int total() const { return total_; }
+
+        size_t size() const { return ranked_ < range_ ? range_ - ranked_ : range_; }
+
+        double backoff_weight() const {
+            return BACKOFF_DISCOUNT * size() / std::max(total_, 1u);
+        }
+
+        int count_of(WordId id) const;
+
+        template<typename F>
+        void for_each_ranked(size_t limit, F f) const {
+            uint32_t begin = 0;
+            uint32_t end = (uint32_t) std::min<size_t>(ranked_, limit);
+            // 按次数排列的部分不足limit且不完整时遍历按ID排序的全部后继词
+            if (limit > ranked_ && ranked_ < range_) {
+                begin = ranked_;
+                end = range_;
+            }
+            for (uint32_t i = begin; i < end; ++i) {
+                f(word_at(i), count_at(i));
+            }
+        }
+
+    private:
+        friend class FrozenNGramModel;
+
+        WordId word_at(uint32_t i) const { return successors_[i] & word_mask_; }
+
+        int count_at(uint32_t i) const;
+
+        const FrozenSuccessor *successors_ = nullptr;
+        const FrozenOverflow *overflow_ = nullptr;
+        uint32_t overflow_count_ = 0;
+        uint32_t first_index_ = 0;   // successors_[0]在本阶中的下标
+        uint32_t range_ = 0;
+        uint32_t ranked_ = 0;        // 开头按次数排列的项数
+        uint32_t total_ = 0;
+        uint32_t backoff_index_ = FROZEN_NO_CONTEXT;
+        uint32_t word_bits_ = 0;
+        uint32_t word_mask_ = 0;
+    };
+
+    int order() const { return header_->n; }
+
+    double smoothing() const { return header_->smoothing; }
+
+    int total_words() const { return (int) header_->total_words; }
+
+    size_t vocabulary_size() const { return header_->vocab_size; }
+
+    int word_count(WordId id) const {
+        return id < header_->vocab_size ? (int) word_count_[id] : 0;
+    }
+
+    WordId unigram_at(size_t rank) const { return unigram_rank_[rank]; }
+
+    Context find_context(int n_size, const WordId *ids) const;
+
+    // 沿context保存的下标取低一阶上下文，不需要再查找
+    Context backoff_context(int n_size, const WordId *ids, const Context &context) const;
+
+    // 第order_index阶（0为二阶）的第index个上下文，区间损坏时返回空
+    Context context_at(uint32_t order_index, uint64_t index) const;
+
+    size_t mapped_size() const { return size_; }
+
+    // 字符串池字节数（含每个单词末尾的'\0'）
+    size_t string_pool_size() const { return word_offsets_[header_->vocab_size]; }
+
+    // 各阶上下文数、后继词数以及内存模型中top的项数之和
+    void count_entries(size_t &contexts, size_t &successors, size_t &ranked) const;
+
+    // 第n_size阶的上下文数和后继词数，没有这一阶时都为0
+    void count_order(int n_size, size_t &contexts, size_t &successors) const;
+
+    // 第n_size阶的各个数组在映射中占用的字节数，没有这一阶时为0
+    size_t order_bytes(int n_size) const;
+
+private:
+    FrozenNGramModel() = default;
+
+    const uint8_t *base_ = nullptr;
+    size_t size_ = 0;
+    const FrozenHeader *header_ = nullptr;
+    const uint32_t *word_offsets_ = nullptr;
+    const char *string_pool_ = nullptr;
+    const uint32_t *word_slots_ = nullptr;
+    PerfectHash word_hash_;
+    const uint32_t *word_count_ = nullptr;
+    const uint32_t *unigram_rank_ = nullptr;
+};
+
+#endif // NGRAM_MODEL_FROZEN_H
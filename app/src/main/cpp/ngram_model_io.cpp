@@ -1,236 +1,301 @@
-#include "ngarm_model_data.h"
+#include "ngram_model_io.h"
 #include "jni_log.h"
 #include <cstdio>
+#include <cstring>
 #include <vector>
 #include <memory>
-#include <type_traits>
+#include <unistd.h>
 
 const size_t IO_BUFFER_SIZE = 64 * 1024;
 
-bool save_model_data(NGramModelData &data, const std::string &file_path) {
-    // 检查total_words是否有效
-    if (data.total_words <= 0) {
-        LOGE("Invalid total_words value: %d (must be positive)", data.total_words);
-        return false;
+namespace {
+
+// 写出LEB128变长整数和小端序定长字段，同时累计校验和，出错后ok()为false
+class CompactWriter {
+public:
+    explicit CompactWriter(FILE *fp) : fp_(fp) {}
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            put((uint8_t) (value | 0x80));
+            value >>= 7;
+        }
+        put((uint8_t) value);
     }
 
-    FILE *fp = fopen(file_path.c_str(), "wb");
-    if (!fp) {
-        LOGE("Failed to open file for saving: %s", file_path.c_str());
-        return false;
+    void u32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) put((uint8_t) (value >> (8 * i)));
     }
 
-    // 使用智能指针管理缓冲区
-    std::unique_ptr<char[]> buf(new char[IO_BUFFER_SIZE]);
-    setvbuf(fp, buf.get(), _IOFBF, IO_BUFFER_SIZE);
+    void f64(double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 8; ++i) put((uint8_t) (bits >> (8 * i)));
+    }
 
-    try {
-        // 逐个写入基本参数（修复核心：避免批量读写）
-        // 写入n
-        if (fwrite(&data.n, sizeof(data.n), 1, fp) != 1) {
-            LOGE("Failed to write n");
-            fclose(fp);
-            return false;
-        }
+    void raw(const void *data, size_t size) {
+        if (ok_ && size > 0 && fwrite(data, size, 1, fp_) != 1) ok_ = false;
+        checksum_ = fnv1a(data, size, checksum_);
+    }
 
-        // 写入smoothing
-        if (fwrite(&data.smoothing, sizeof(data.smoothing), 1, fp) != 1) {
-            LOGE("Failed to write smoothing");
-            fclose(fp);
-            return false;
-        }
+    // 上次reset_checksum之后写出的所有字节的校验和
+    uint32_t checksum() const { return checksum_; }
 
-        // 写入total_words（关键修复）
-        if (fwrite(&data.total_words, sizeof(data.total_words), 1, fp) != 1) {
-            LOGE("Failed to write total_words");
-            fclose(fp);
-            return false;
-        }
+    void reset_checksum() { checksum_ = fnv1a(nullptr, 0); }
 
-        // 写入词频统计
-        size_t wc_size = data.word_count.size();
-        if (fwrite(&wc_size, sizeof(wc_size), 1, fp) != 1) {
-            LOGE("Failed to write wc_size");
-            fclose(fp);
-            return false;
-        }
+    bool ok() const { return ok_; }
 
-        std::string word_buf;
-        for (const auto &entry: data.word_count) {
-            const std::string &word = entry.first;
-            size_t len = word.size();
+private:
+    void put(uint8_t c) {
+        if (ok_ && putc(c, fp_) == EOF) ok_ = false;
+        checksum_ = (checksum_ ^ c) * 16777619u;
+    }
 
-            if (fwrite(&len, sizeof(len), 1, fp) != 1) {
-                LOGE("Failed to write word length");
-                fclose(fp);
-                return false;
+    FILE *fp_;
+    bool ok_ = true;
+    uint32_t checksum_ = fnv1a(nullptr, 0);
+};
+
+// 带校验的读取，出错或超出limit后ok()为false且之后只返回0
+class CompactReader {
+public:
+    explicit CompactReader(FILE *fp) : fp_(fp) {}
+
+    uint64_t varint(uint64_t limit = UINT32_MAX) {
+        uint64_t value = 0;
+        for (int shift = 0; ok_ && shift < 64; shift += 7) {
+            int c = get();
+            if (c == EOF) break;
+            value |= (uint64_t) (c & 0x7f) << shift;
+            if (!(c & 0x80)) {
+                if (value > limit) break;
+                return value;
             }
+        }
+        ok_ = false;
+        return 0;
+    }
 
-            if (fwrite(word.data(), len, 1, fp) != 1) {
-                LOGE("Failed to write word data");
-                fclose(fp);
-                return false;
-            }
+    uint32_t u32() {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) value |= (uint32_t) byte() << (8 * i);
+        return ok_ ? value : 0;
+    }
 
-            if (fwrite(&entry.second, sizeof(entry.second), 1, fp) != 1) {
-                LOGE("Failed to write word count");
-                fclose(fp);
-                return false;
-            }
-        }
+    double f64() {
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; ++i) bits |= (uint64_t) byte() << (8 * i);
+        double value = 0.0;
+        if (ok_) memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
 
-        // 写入模型数据
-        using ModelMapType = std::decay_t<decltype(data.models)>;
-        std::vector<std::pair<int, ModelMapType::mapped_type>> model_vec(
-                data.models.begin(), data.models.end()
-        );
+    void raw(void *data, size_t size) {
+        if (ok_ && size > 0 && fread(data, size, 1, fp_) != 1) ok_ = false;
+        if (ok_) checksum_ = fnv1a(data, size, checksum_);
+    }
 
-        size_t model_size = model_vec.size();
-        if (fwrite(&model_size, sizeof(model_size), 1, fp) != 1) {
-            LOGE("Failed to write model_size");
-            fclose(fp);
-            return false;
-        }
+    // 已读取的所有字节的校验和
+    uint32_t checksum() const { return checksum_; }
 
-        for (const auto &model_entry: model_vec) {
-            int n_size = model_entry.first;
-            if (fwrite(&n_size, sizeof(n_size), 1, fp) != 1) {
-                LOGE("Failed to write n_size");
-                fclose(fp);
-                return false;
-            }
+    // 已经读到文件末尾
+    bool at_end() { return getc(fp_) == EOF; }
 
-            const auto &context_map = model_entry.second;
-            using ContextMapType = std::decay_t<decltype(context_map)>;
-            std::vector<std::pair<std::vector<std::string>, ContextMapType::mapped_type>> context_vec(
-                    context_map.begin(), context_map.end()
-            );
+    bool ok() const { return ok_; }
 
-            size_t context_size = context_vec.size();
-            if (fwrite(&context_size, sizeof(context_size), 1, fp) != 1) {
-                LOGE("Failed to write context_size");
-                fclose(fp);
-                return false;
-            }
+private:
+    int get() {
+        int c = getc(fp_);
+        if (c != EOF) checksum_ = (checksum_ ^ (uint8_t) c) * 16777619u;
+        return c;
+    }
 
-            for (const auto &context_entry: context_vec) {
-                const std::vector<std::string> &context = context_entry.first;
-                size_t ctx_len = context.size();
+    uint8_t byte() {
+        int c = ok_ ? get() : EOF;
+        if (c == EOF) ok_ = false;
+        return (uint8_t) c;
+    }
 
-                if (fwrite(&ctx_len, sizeof(ctx_len), 1, fp) != 1) {
-                    LOGE("Failed to write ctx_len");
-                    fclose(fp);
-                    return false;
-                }
+    FILE *fp_;
+    bool ok_ = true;
+    uint32_t checksum_ = fnv1a(nullptr, 0);
+};
+
+void write_compact_model(const NGramModelData &data, CompactWriter &writer) {
+    writer.raw(MODEL_FILE_MAGIC, sizeof(MODEL_FILE_MAGIC));
+    writer.reset_checksum();
+    writer.u32(MODEL_FILE_VERSION);
+    writer.varint(data.n);
+    writer.f64(data.smoothing);
+    writer.varint(data.total_words);
+
+    writer.varint(data.word_count.size());
+    for (WordId id = 0; id < data.word_count.size(); ++id) {
+        const std::string &word = data.vocabulary.word(id);
+        writer.varint(word.size());
+        writer.raw(word.data(), word.size());
+        writer.varint(data.word_count[id]);
+    }
 
-                for (const auto &word: context) {
-                    size_t len = word.size();
-                    if (fwrite(&len, sizeof(len), 1, fp) != 1) {
-                        LOGE("Failed to write context word length");
-                        fclose(fp);
-                        return false;
-                    }
+    std::vector<int> orders;
+    for (const auto &model: data.models) {
+        orders.push_back(model.first);
+    }
+    std::sort(orders.begin(), orders.end());
+    writer.varint(orders.size());
+
+    std::vector<std::pair<ContextKey, const ContextEntry *>> contexts;
+    std::vector<std::pair<WordId, int>> successors;
+    for (int order: orders) {
+        const ContextMap &context_map = data.models.at(order);
+        contexts.clear();
+        for (const auto &entry: context_map) {
+            contexts.emplace_back(entry.first, &entry.second);
+        }
+        std::sort(contexts.begin(), contexts.end(),
+                  [](const auto &a, const auto &b) { return a.first < b.first; });
+
+        writer.varint(order);
+        writer.varint(contexts.size());
+        ContextKey previous;
+        for (size_t c = 0; c < contexts.size(); ++c) {
+            ContextKey context = contexts[c].first;
+            // 与上一个上下文的公共前缀只写长度，第一个不同的ID写差值
+            size_t shared = 0;
+            if (c > 0) {
+                while (shared < context.size() && context[shared] == previous[shared]) ++shared;
+            }
+            writer.varint(shared);
+            for (size_t i = shared; i < context.size(); ++i) {
+                bool delta = c > 0 && i == shared;
+                writer.varint(delta ? context[i] - previous[i] : context[i]);
+            }
+            previous = context;
+
+            const ContextEntry &entry = *contexts[c].second;
+            successors.assign(entry.successors.begin(), entry.successors.end());
+            std::sort(successors.begin(), successors.end());
+            writer.varint(successors.size());
+            WordId last = 0;
+            for (const auto &successor: successors) {
+                writer.varint(successor.first - last);
+                writer.varint(successor.second);
+                last = successor.first;
+            }
+        }
+    }
+    writer.u32(writer.checksum());
+}
 
-                    if (fwrite(word.data(), len, 1, fp) != 1) {
-                        LOGE("Failed to write context word data");
-                        fclose(fp);
-                        return false;
-                    }
-                }
+bool read_compact_model(NGramModelData &data, CompactReader &reader) {
+    // 版本2的定长字段按本机字节序写出，Android支持的平台都是小端序，读法相同
+    uint32_t version = reader.u32();
+    if (!reader.ok() || version < 2 || version > MODEL_FILE_VERSION) {
+        LOGE("Unsupported model file version: %u", version);
+        return false;
+    }
 
-                const auto &word_map = context_entry.second;
-                std::vector<std::pair<std::string, int>> word_vec(
-                        word_map.begin(), word_map.end()
-                );
+    data.n = (int) reader.varint(INT32_MAX);
+    data.smoothing = reader.f64();
+    data.total_words = (int) reader.varint(INT32_MAX);
+
+    size_t vocab_size = reader.varint();
+    data.word_count.reserve(vocab_size);
+    data.vocabulary.ids.reserve(vocab_size);
+    std::string word;
+    for (size_t i = 0; reader.ok() && i < vocab_size; ++i) {
+        word.resize(reader.varint(IO_BUFFER_SIZE));
+        reader.raw(&word[0], word.size());
+        int count = (int) reader.varint(INT32_MAX);
+        // 重复的单词会打乱ID
+        if (data.vocabulary.intern(word) != i) {
+            LOGE("Duplicate word in model file");
+            return false;
+        }
+        data.word_count.push_back(count);
+    }
+
+    size_t order_count = reader.varint(INT32_MAX);
+    std::vector<WordId> context;
+    for (size_t i = 0; reader.ok() && i < order_count; ++i) {
+        int order = (int) reader.varint(INT32_MAX);
+        size_t context_count = reader.varint(UINT64_MAX >> 1);
+        if (!reader.ok() || order < 2 || order > data.n) {
+            LOGE("Invalid order %d in model file", order);
+            return false;
+        }
 
-                size_t word_map_size = word_vec.size();
-                if (fwrite(&word_map_size, sizeof(word_map_size), 1, fp) != 1) {
-                    LOGE("Failed to write word_map_size");
-                    fclose(fp);
+        auto &context_map = data.models[order];
+        context_map.reserve(context_count);
+        context.assign(order - 1, 0);
+        for (size_t c = 0; reader.ok() && c < context_count; ++c) {
+            size_t shared = reader.varint(order - 1);
+            for (size_t k = shared; k < context.size(); ++k) {
+                uint64_t value = reader.varint();
+                value += c > 0 && k == shared ? context[k] : 0;
+                if (value >= vocab_size) {
+                    LOGE("Context word out of range in model file");
                     return false;
                 }
+                context[k] = (WordId) value;
+            }
 
-                for (const auto &word_entry: word_vec) {
-                    size_t len = word_entry.first.size();
-                    if (fwrite(&len, sizeof(len), 1, fp) != 1) {
-                        LOGE("Failed to write entry word length");
-                        fclose(fp);
-                        return false;
-                    }
-
-                    if (fwrite(word_entry.first.data(), len, 1, fp) != 1) {
-                        LOGE("Failed to write entry word data");
-                        fclose(fp);
-                        return false;
-                    }
-
-                    if (fwrite(&word_entry.second, sizeof(word_entry.second), 1, fp) != 1) {
-                        LOGE("Failed to write entry word count");
-                        fclose(fp);
-                        return false;
-                    }
+            size_t successor_count = reader.varint(vocab_size);
+            ContextEntry &entry = context_map[context];
+            entry.reserve(successor_count);
+            uint64_t id = 0;
+            for (size_t k = 0; reader.ok() && k < successor_count; ++k) {
+                id += reader.varint();
+                int count = (int) reader.varint(INT32_MAX);
+                if (id >= vocab_size) {
+                    LOGE("Successor out of range in model file");
+                    return false;
                 }
+                entry.emplace((WordId) id, count);
             }
+            entry.rebuild();
         }
+    }
 
-        fclose(fp);
-        LOGD("Model saved successfully, total_words: %d", data.total_words);
-        return true;
-    } catch (const std::exception &e) {
-        LOGE("Error saving model: %s", e.what());
-        fclose(fp);
-        return false;
-    } catch (...) {
-        LOGE("Unknown error saving model");
-        fclose(fp);
+    uint32_t expected = reader.checksum();
+    uint32_t checksum = version >= 3 ? reader.u32() : expected;
+    if (!reader.ok()) {
+        LOGE("Truncated or corrupt model file");
         return false;
     }
-}
-
-bool load_model_data(NGramModelData &data, const std::string &file_path) {
-    FILE *fp = fopen(file_path.c_str(), "rb");
-    if (!fp) {
-        LOGE("Failed to open file for loading: %s", file_path.c_str());
+    if (checksum != expected || (version >= 3 && !reader.at_end())) {
+        LOGE("Model file checksum mismatch");
         return false;
     }
+    data.rebuild_unigram_rank();
+    return true;
+}
 
-    // 使用智能指针管理缓冲区
-    std::unique_ptr<char[]> buf(new char[IO_BUFFER_SIZE]);
-    setvbuf(fp, buf.get(), _IOFBF, IO_BUFFER_SIZE);
-
+// 旧格式：每个上下文和后继词都重复写出单词字符串，只保留读取
+bool load_legacy_model_data(NGramModelData &data, FILE *fp) {
     try {
-        // 清空现有数据
-        data.models.clear();
-        data.word_count.clear();
-        data.vocabulary.clear();
-        data.total_words = 0;  // 初始化为0，便于检测是否读取成功
-
         // 逐个读取基本参数（修复核心）
         // 读取n
         if (fread(&data.n, sizeof(data.n), 1, fp) != 1) {
             LOGE("Failed to read n");
-            fclose(fp);
             return false;
         }
 
         // 读取smoothing
         if (fread(&data.smoothing, sizeof(data.smoothing), 1, fp) != 1) {
             LOGE("Failed to read smoothing");
-            fclose(fp);
             return false;
         }
 
         // 读取total_words（关键修复）
         if (fread(&data.total_words, sizeof(data.total_words), 1, fp) != 1) {
             LOGE("Failed to read total_words");
-            fclose(fp);
             return false;
         }
 
         // 验证total_words是否合理
         if (data.total_words <= 0) {
             LOGE("Loaded invalid total_words: %d (may indicate corrupt file)", data.total_words);
-            fclose(fp);
             return false;
         }
 
@@ -238,48 +303,42 @@ bool load_model_data(NGramModelData &data, const std::string &file_path) {
         size_t wc_size;
         if (fread(&wc_size, sizeof(wc_size), 1, fp) != 1) {
             LOGE("Failed to read wc_size");
-            fclose(fp);
             return false;
         }
 
         data.word_count.reserve(wc_size);
+        data.vocabulary.ids.reserve(wc_size);
         std::string word;
         int count;
         for (size_t i = 0; i < wc_size; ++i) {
             size_t len;
             if (fread(&len, sizeof(len), 1, fp) != 1) {
                 LOGE("Failed to read word length");
-                fclose(fp);
                 return false;
             }
 
             word.resize(len);
             if (fread(&word[0], len, 1, fp) != 1) {
                 LOGE("Failed to read word data");
-                fclose(fp);
                 return false;
             }
 
             if (fread(&count, sizeof(count), 1, fp) != 1) {
                 LOGE("Failed to read word count");
-                fclose(fp);
                 return false;
             }
 
-            data.word_count[word] = count;
-        }
-
-        // 重建vocabulary
-        data.vocabulary.reserve(data.word_count.size());
-        for (const auto &entry: data.word_count) {
-            data.vocabulary.insert(entry.first);
+            WordId id = data.vocabulary.intern(word);
+            if (id >= data.word_count.size()) {
+                data.word_count.resize(id + 1, 0);
+            }
+            data.word_count[id] = count;
         }
 
         // 读取模型数据
         size_t model_size;
         if (fread(&model_size, sizeof(model_size), 1, fp) != 1) {
             LOGE("Failed to read model_size");
-            fclose(fp);
             return false;
         }
 
@@ -288,14 +347,12 @@ bool load_model_data(NGramModelData &data, const std::string &file_path) {
             int n_size;
             if (fread(&n_size, sizeof(n_size), 1, fp) != 1) {
                 LOGE("Failed to read n_size");
-                fclose(fp);
                 return false;
             }
 
             size_t context_size;
             if (fread(&context_size, sizeof(context_size), 1, fp) != 1) {
                 LOGE("Failed to read context_size");
-                fclose(fp);
                 return false;
             }
 
@@ -306,76 +363,165 @@ bool load_model_data(NGramModelData &data, const std::string &file_path) {
                 size_t ctx_len;
                 if (fread(&ctx_len, sizeof(ctx_len), 1, fp) != 1) {
                     LOGE("Failed to read ctx_len");
-                    fclose(fp);
+                    return false;
+                }
+                // 同一阶的上下文长度必须一致
+                if (ctx_len != (size_t) n_size - 1) {
+                    LOGE("Invalid context length %zu for order %d", ctx_len, n_size);
                     return false;
                 }
 
-                std::vector<std::string> context;
+                std::vector<WordId> context;
                 context.reserve(ctx_len);
                 for (size_t k = 0; k < ctx_len; ++k) {
                     size_t len;
                     if (fread(&len, sizeof(len), 1, fp) != 1) {
                         LOGE("Failed to read context word length");
-                        fclose(fp);
                         return false;
                     }
 
                     word.resize(len);
                     if (fread(&word[0], len, 1, fp) != 1) {
                         LOGE("Failed to read context word data");
-                        fclose(fp);
                         return false;
                     }
 
-                    context.push_back(word);
+                    context.push_back(data.vocabulary.intern(word));
                 }
 
                 size_t word_map_size;
                 if (fread(&word_map_size, sizeof(word_map_size), 1, fp) != 1) {
                     LOGE("Failed to read word_map_size");
-                    fclose(fp);
                     return false;
                 }
 
-                auto &word_map = context_map[context];
-                word_map.reserve(word_map_size);
+                auto &context_entry = context_map[context];
+                context_entry.reserve(word_map_size);
 
                 for (size_t k = 0; k < word_map_size; ++k) {
                     size_t len;
                     if (fread(&len, sizeof(len), 1, fp) != 1) {
                         LOGE("Failed to read entry word length");
-                        fclose(fp);
                         return false;
                     }
 
                     word.resize(len);
                     if (fread(&word[0], len, 1, fp) != 1) {
                         LOGE("Failed to read entry word data");
-                        fclose(fp);
                         return false;
                     }
 
                     if (fread(&count, sizeof(count), 1, fp) != 1) {
                         LOGE("Failed to read entry word count");
-                        fclose(fp);
                         return false;
                     }
 
-                    word_map[word] = count;
+                    context_entry.set(data.vocabulary.intern(word), count);
                 }
+
+                // 重建总次数和排好序的后继词
+                context_entry.rebuild();
             }
         }
 
-        fclose(fp);
-        LOGD("Model loaded successfully, total_words: %d", data.total_words);
+        // 上下文中出现的词必须在词频表中有对应项
+        data.word_count.resize(data.vocabulary.size(), 0);
+        data.rebuild_unigram_rank();
+
         return true;
     } catch (const std::exception &e) {
         LOGE("Error loading model: %s", e.what());
-        fclose(fp);
         return false;
     } catch (...) {
         LOGE("Unknown error loading model");
-        fclose(fp);
         return false;
     }
 }
+
+} // namespace
+
+bool close_synced(FILE *fp) {
+    bool ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    return fclose(fp) == 0 && ok;
+}
+
+bool save_model_data(const NGramModelData &data, const std::string &file_path) {
+    // 检查total_words是否有效
+    if (data.total_words <= 0) {
+        LOGE("Invalid total_words value: %d (must be positive)", data.total_words);
+        return false;
+    }
+
+    // 写临时文件后rename：后台合并时被杀或磁盘写满，原文件仍然完整
+    std::string tmp_path = file_path + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "wb");
+    if (!fp) {
+        LOGE("Failed to open file for saving: %s", tmp_path.c_str());
+        return false;
+    }
+
+    // 使用智能指针管理缓冲区
+    std::unique_ptr<char[]> buf(new char[IO_BUFFER_SIZE]);
+    setvbuf(fp, buf.get(), _IOFBF, IO_BUFFER_SIZE);
+
+    CompactWriter writer(fp);
+    write_compact_model(data, writer);
+    bool ok = close_synced(fp) && writer.ok();
+    if (!ok) {
+        LOGE("Failed to write model: %s", tmp_path.c_str());
+        remove(tmp_path.c_str());
+        return false;
+    }
+    if (rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+        LOGE("Failed to rename model to %s", file_path.c_str());
+        remove(tmp_path.c_str());
+        return false;
+    }
+    LOGD("Model saved successfully, total_words: %d", data.total_words);
+    return true;
+}
+
+bool load_model_data(NGramModelData &data, const std::string &file_path) {
+    FILE *fp = fopen(file_path.c_str(), "rb");
+    if (!fp) {
+        LOGE("Failed to open file for loading: %s", file_path.c_str());
+        return false;
+    }
+
+    // 使用智能指针管理缓冲区
+    std::unique_ptr<char[]> buf(new char[IO_BUFFER_SIZE]);
+    setvbuf(fp, buf.get(), _IOFBF, IO_BUFFER_SIZE);
+
+    // 清空现有数据
+    data.models.clear();
+    data.word_count.clear();
+    data.unigram_rank.clear();
+    data.vocabulary.clear();
+    data.total_words = 0;  // 初始化为0，便于检测是否读取成功
+
+    // 没有文件头的是旧格式，从头读取
+    char magic[sizeof(MODEL_FILE_MAGIC)] = {};
+    bool compact = fread(magic, sizeof(magic), 1, fp) == 1 &&
+                   memcmp(magic, MODEL_FILE_MAGIC, sizeof(magic)) == 0;
+    bool ok;
+    if (compact) {
+        CompactReader reader(fp);
+        ok = read_compact_model(data, reader);
+    } else {
+        rewind(fp);
+        ok = load_legacy_model_data(data, fp);
+    }
+    fclose(fp);
+
+    if (ok && data.total_words <= 0) {
+        LOGE("Loaded invalid total_words: %d (may indicate corrupt file)", data.total_words);
+        ok = false;
+    }
+    if (!ok) {
+        data = NGramModelData();
+        return false;
+    }
+    LOGD("Model loaded successfully (%s format), total_words: %d",
+         compact ? "compact" : "legacy", data.total_words);
+    return true;
+}
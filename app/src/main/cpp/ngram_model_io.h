@@ -1,6 +1,40 @@
+#ifndef NGRAM_MODEL_IO_H
+#define NGRAM_MODEL_IO_H
+
+#include <cstdio>
 #include "ngarm_model_data.h"
 
-// 序列化工具函数声明
-bool save_model_data(NGramModelData &data, const std::string &file_path);
+// .bin文件格式（版本3），与平台的字长和字节序无关，可以在主机上生成后随应用发布。
+// 定长字段均为小端序，变长整数为LEB128（每字节7位，最高位表示后面还有字节）：
+//   magic "NGRAMBIN"，uint32 版本
+//   varint n，smoothing（IEEE 754双精度的64位表示），varint total_words
+//   varint 词汇表大小，随后按ID每个词：varint 字节数、字节、varint 次数
+//   varint 阶数，随后每阶：varint order、varint 上下文数，上下文按字典序排列，每个上下文：
+//     varint 与上一个上下文相同的前缀长度p，随后order-1-p个ID：
+//       第一个写与上一个上下文同位置ID的差（字典序保证为正），其余直接写ID
+//     varint 后继词数，随后按ID升序每项：varint 与上一个ID的差、varint 次数
+//   uint32 校验和：版本字段到此之前所有字节的FNV-1a，之后不能再有数据
+// 版本2没有校验和，其余相同，仍可读取；没有magic的文件按旧格式读取。
+const char MODEL_FILE_MAGIC[8] = {'N', 'G', 'R', 'A', 'M', 'B', 'I', 'N'};
+const uint32_t MODEL_FILE_VERSION = 3;
+
+// FNV-1a校验和，传入上一段的结果可以分段计算
+inline uint32_t fnv1a(const void *data, size_t size, uint32_t hash = 2166136261u) {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 刷新缓冲区、fsync后关闭文件，任一步失败都返回false并仍然关闭文件。
+// 写临时文件再rename替换时使用，保证rename之后的文件内容已经落盘
+bool close_synced(FILE *fp);
+
+// 序列化工具函数声明。保存时先写临时文件再rename，中途失败不会破坏原文件
+bool save_model_data(const NGramModelData &data, const std::string &file_path);
 
 bool load_model_data(NGramModelData &data, const std::string &file_path);
+
+#endif // NGRAM_MODEL_IO_H
@@ -0,0 +1,598 @@
+#include "ngram_model_journal.h"
+#include "ngram_model.h"
+#include "ngram_predict.h"
+#include "jni_log.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+JournalHeader make_header(const FrozenNGramModel &base) {
+    JournalHeader header{};
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.base_vocab_size = static_cast<uint32_t>(base.vocabulary_size());
+    header.base_total_words = static_cast<uint64_t>(base.total_words());
+    header.base_file_size = base.mapped_size();
+    return header;
+}
+
+bool header_matches(const JournalHeader &header, const FrozenNGramModel &base) {
+    JournalHeader expected = make_header(base);
+    return memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+           header.version == expected.version &&
+           header.base_vocab_size == expected.base_vocab_size &&
+           header.base_total_words == expected.base_total_words &&
+           header.base_file_size == expected.base_file_size;
+}
+
+// 追加定长字段
+class PayloadWriter {
+public:
+    explicit PayloadWriter(std::string &out) : out_(out) {}
+
+    void u32(uint32_t value) {
+        out_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void bytes(std::string_view value) {
+        u32(static_cast<uint32_t>(value.size()));
+        out_.append(value.data(), value.size());
+    }
+
+private:
+    std::string &out_;
+};
+
+// 带边界检查的读取，越界后ok()为false且之后只返回0
+class PayloadReader {
+public:
+    PayloadReader(const char *data, size_t size) : p_(data), end_(data + size) {}
+
+    uint32_t u32() {
+        uint32_t value = 0;
+        if (ok_ && (size_t) (end_ - p_) >= sizeof(value)) {
+            memcpy(&value, p_, sizeof(value));
+            p_ += sizeof(value);
+        } else {
+            ok_ = false;
+        }
+        return value;
+    }
+
+    std::string_view bytes() {
+        uint32_t size = u32();
+        if (!ok_ || (size_t) (end_ - p_) < size) {
+            ok_ = false;
+            return {};
+        }
+        std::string_view value(p_, size);
+        p_ += size;
+        return value;
+    }
+
+    bool ok() const { return ok_; }
+
+    bool at_end() const { return p_ == end_; }
+
+private:
+    const char *p_;
+    const char *end_;
+    bool ok_ = true;
+};
+
+std::string encode_delta(const ModelDelta &batch) {
+    std::string payload;
+    PayloadWriter writer(payload);
+
+    writer.u32(static_cast<uint32_t>(batch.total_words));
+    writer.u32(static_cast<uint32_t>(batch.new_words.size()));
+    for (const auto &word: batch.new_words.words) {
+        writer.bytes(word);
+    }
+
+    writer.u32(static_cast<uint32_t>(batch.word_count.size()));
+    for (const auto &entry: batch.word_count) {
+        writer.u32(entry.first);
+        writer.u32(static_cast<uint32_t>(entry.second));
+    }
+
+    writer.u32(static_cast<uint32_t>(batch.models.size()));
+    for (const auto &model: batch.models) {
+        uint32_t entries = 0;
+        for (const auto &context: model.second) {
+            entries += context.second.successors.size();
+        }
+        writer.u32(static_cast<uint32_t>(model.first));
+        writer.u32(entries);
+        for (const auto &context: model.second) {
+            for (const auto &successor: context.second.successors) {
+                for (WordId id: context.first) {
+                    writer.u32(id);
+                }
+                writer.u32(successor.first);
+                writer.u32(static_cast<uint32_t>(successor.second));
+            }
+        }
+    }
+    return payload;
+}
+
+// 解码一条记录，所有ID和次数都要校验，避免损坏的日志破坏模型
+bool decode_delta(const char *data, size_t size, int max_order, ModelDelta &batch) {
+    PayloadReader reader(data, size);
+
+    uint32_t total_words = reader.u32();
+    uint32_t new_word_count = reader.u32();
+    for (uint32_t i = 0; i < new_word_count && reader.ok(); ++i) {
+        std::string_view word = reader.bytes();
+        if (word.empty() || batch.new_words.intern(word) != i) return false;
+    }
+    if (total_words > INT32_MAX) return false;
+    batch.total_words = (int) total_words;
+
+    const WordId end = batch.vocabulary_end();
+    auto valid_count = [](uint32_t count) { return count > 0 && count <= INT32_MAX; };
+
+    uint32_t unigram_count = reader.u32();
+    for (uint32_t i = 0; i < unigram_count && reader.ok(); ++i) {
+        WordId id = reader.u32();
+        uint32_t count = reader.u32();
+        if (id >= end || !valid_count(count)) return false;
+        batch.word_count[id] += (int) count;
+    }
+
+    uint32_t order_count = reader.u32();
+    std::vector<WordId> context;
+    for (uint32_t i = 0; i < order_count && reader.ok(); ++i) {
+        uint32_t order = reader.u32();
+        uint32_t entries = reader.u32();
+        if (order < 2 || order > (uint32_t) max_order) return false;
+
+        auto &context_map = batch.models[(int) order];
+        for (uint32_t e = 0; e < entries && reader.ok(); ++e) {
+            context.clear();
+            for (uint32_t w = 0; w + 1 < order; ++w) {
+                context.push_back(reader.u32());
+            }
+            WordId word = reader.u32();
+            uint32_t count = reader.u32();
+            if (!reader.ok()) break;
+            if (word >= end || !valid_count(count) ||
+                std::any_of(context.begin(), context.end(), [end](WordId id) { return id >= end; })) {
+                return false;
+            }
+            context_map[context].add(word, (int) count);
+        }
+    }
+    return reader.ok() && reader.at_end();
+}
+
+bool write_fully(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+} // namespace
+
+bool ModelDelta::merge(const ModelDelta &batch) {
+    if (batch.base_vocab_size != vocabulary_end()) {
+        LOGE("Delta vocabulary mismatch: %u != %u", batch.base_vocab_size, vocabulary_end());
+        return false;
+    }
+
+    for (const auto &word: batch.new_words.words) {
+        new_words.intern(word);
+    }
+    total_words += batch.total_words;
+    for (const auto &entry: batch.word_count) {
+        word_count[entry.first] += entry.second;
+    }
+    for (const auto &model: batch.models) {
+        auto &context_map = models[model.first];
+        for (const auto &context: model.second) {
+            ContextEntry &entry = context_map[context.first];
+            for (const auto &successor: context.second.successors) {
+                entry.add(successor.first, successor.second);
+            }
+        }
+    }
+    return true;
+}
+
+ModelDelta build_model_delta(const std::string &text, const FrozenNGramModel &base,
+                             const ModelDelta &delta) {
+    ModelDelta batch;
+    batch.base_vocab_size = delta.vocabulary_end();
+
+    TokenBuffer buffer;
+    tokenize_text(text, buffer);
+    const auto &words = buffer.tokens;
+    if (words.empty()) return batch;
+
+    std::vector<WordId> ids;
+    ids.reserve(words.size());
+    for (std::string_view word: words) {
+        WordId id = base.find_word(word);
+        if (id == INVALID_WORD_ID) id = delta.find_new_word(word);
+        if (id == INVALID_WORD_ID) id = batch.base_vocab_size + batch.new_words.intern(word);
+        batch.word_count[id]++;
+        ids.push_back(id);
+    }
+    batch.total_words = words.size();
+
+    std::vector<WordId> context;
+    for (int i = 2; i <= base.order(); ++i) {
+        if (ids.size() < (size_t) i) continue;
+
+        auto &context_map = batch.models[i];
+        for (size_t pos = 0; pos + i <= ids.size(); ++pos) {
+            context.assign(ids.begin() + pos, ids.begin() + pos + i - 1);
+            context_map[context].add(ids[pos + i - 1], 1);
+        }
+    }
+    return batch;
+}
+
+bool reset_journal(const std::string &file_path, const FrozenNGramModel &base) {
+    JournalHeader header = make_header(base);
+
+    std::string tmp_path = file_path + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "wb");
+    if (!fp) {
+        LOGE("Failed to open journal for writing: %s", tmp_path.c_str());
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = close_synced(fp) && ok;
+    if (!ok || rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+        LOGE("Failed to reset journal: %s", file_path.c_str());
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool append_journal_record(const std::string &file_path, const FrozenNGramModel &base,
+                           const ModelDelta &batch, size_t *journal_size) {
+    int fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOGE("Failed to open journal %s: %s", file_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        LOGE("Failed to stat journal %s: %s", file_path.c_str(), strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    std::string payload = encode_delta(batch);
+    std::string record;
+    record.reserve(sizeof(JournalHeader) + 2 * sizeof(uint32_t) + payload.size());
+    if (st.st_size == 0) {
+        JournalHeader header = make_header(base);
+        record.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+    PayloadWriter writer(record);
+    writer.u32(static_cast<uint32_t>(payload.size()));
+    writer.u32(fnv1a(payload.data(), payload.size()));
+    record += payload;
+
+    // 整条记录一次写入；中途失败留下的残缺尾部会在重放时按校验和丢弃
+    bool ok = write_fully(fd, record.data(), record.size());
+    if (!ok) {
+        LOGE("Failed to append journal %s: %s", file_path.c_str(), strerror(errno));
+    }
+    ok = close(fd) == 0 && ok;
+
+    if (journal_size) {
+        *journal_size = st.st_size + record.size();
+    }
+    return ok;
+}
+
+namespace {
+
+std::string read_journal_file(const std::string &file_path) {
+    std::string contents;
+    FILE *fp = fopen(file_path.c_str(), "rb");
+    if (fp) {
+        struct stat st{};
+        if (fstat(fileno(fp), &st) == 0 && st.st_size > 0) {
+            contents.resize(st.st_size);
+            contents.resize(fread(&contents[0], 1, contents.size(), fp));
+        }
+        fclose(fp);
+    }
+    return contents;
+}
+
+// 依次合并文件头之后的完整记录，返回最后一条完整记录的结尾
+size_t replay_records(const std::string &contents, int order, ModelDelta &delta) {
+    size_t offset = sizeof(JournalHeader);
+    size_t records = 0;
+    while (offset < contents.size()) {
+        PayloadReader reader(contents.data() + offset, contents.size() - offset);
+        uint32_t size = reader.u32();
+        uint32_t checksum = reader.u32();
+        size_t payload_offset = offset + 2 * sizeof(uint32_t);
+        if (!reader.ok() || contents.size() - payload_offset < size ||
+            fnv1a(contents.data() + payload_offset, size) != checksum) {
+            break;
+        }
+
+        ModelDelta batch;
+        batch.base_vocab_size = delta.vocabulary_end();
+        if (!decode_delta(contents.data() + payload_offset, size, order, batch) ||
+            !delta.merge(batch)) {
+            break;
+        }
+        offset = payload_offset + size;
+        ++records;
+    }
+    LOGD("Replayed %zu journal records, %d words", records, delta.total_words);
+    return offset;
+}
+
+} // namespace
+
+std::shared_ptr<ModelDelta> replay_journal(const std::string &file_path,
+                                           const FrozenNGramModel &base) {
+    auto delta = std::make_shared<ModelDelta>();
+    delta->base_vocab_size = static_cast<uint32_t>(base.vocabulary_size());
+
+    std::string contents = read_journal_file(file_path);
+    JournalHeader header{};
+    if (contents.size() < sizeof(header) ||
+        (memcpy(&header, contents.data(), sizeof(header)), !header_matches(header, base))) {
+        // 日志缺失，或属于合并前的旧基础模型（其内容已包含在当前基础模型中）
+        if (!contents.empty()) {
+            LOGW("Discarding stale journal: %s", file_path.c_str());
+        }
+        reset_journal(file_path, base);
+        return delta;
+    }
+
+    size_t offset = replay_records(contents, base.order(), *delta);
+    if (offset < contents.size()) {
+        LOGW("Truncating journal %s at offset %zu", file_path.c_str(), offset);
+        if (truncate(file_path.c_str(), (off_t) offset) != 0) {
+            LOGE("Failed to truncate journal: %s", strerror(errno));
+        }
+    }
+    return delta;
+}
+
+std::shared_ptr<ModelDelta> read_journal(const std::string &file_path, uint32_t base_vocab_size,
+                                         uint64_t base_total_words, int order) {
+    std::string contents = read_journal_file(file_path);
+    JournalHeader header{};
+    if (contents.size() < sizeof(header)) return nullptr;
+    memcpy(&header, contents.data(), sizeof(header));
+    if (memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != JOURNAL_VERSION ||
+        header.base_vocab_size != base_vocab_size ||
+        header.base_total_words != base_total_words) {
+        return nullptr;
+    }
+
+    auto delta = std::make_shared<ModelDelta>();
+    delta->base_vocab_size = base_vocab_size;
+    replay_records(contents, order, *delta);
+    return delta;
+}
+
+namespace {
+
+// 叠加视图中单个上下文：次数为基础模型与增量之和
+class OverlayContext {
+public:
+    OverlayContext() = default;
+
+    // new_successors是delta中不属于基础上下文的后继词数
+    OverlayContext(FrozenNGramModel::Context base, const ContextEntry *delta,
+                   uint32_t new_successors)
+            : base_(base), delta_(delta), new_successors_(new_successors) {}
+
+    explicit operator bool() const { return static_cast<bool>(base_) || delta_ != nullptr; }
+
+    int total() const {
+        return (base_ ? base_.total() : 0) + (delta_ ? delta_->total : 0);
+    }
+
+    size_t size() const {
+        return (base_ ? base_.size() : 0) + new_successors_;
+    }
+
+    int count_of(WordId id) const {
+        return (base_ ? base_.count_of(id) : 0) + delta_count(id);
+    }
+
+    double backoff_weight() const {
+        return BACKOFF_DISCOUNT * size() / std::max(total(), 1);
+    }
+
+    const FrozenNGramModel::Context &base() const { return base_; }
+
+    // 合并后的前limit名只可能来自基础模型的前limit名或增量中出现的词，
+    // 两者都以合并后的次数回调；重复的词由predict_word_ids去重
+    template<typename F>
+    void for_each_ranked(size_t limit, F f) const {
+        if (base_) {
+            base_.for_each_ranked(limit, [&](WordId word, int count) {
+                f(word, count + delta_count(word));
+            });
+        }
+        if (delta_) {
+            for (const auto &successor: delta_->successors) {
+                f(successor.first, successor.second + (base_ ? base_.count_of(successor.first) : 0));
+            }
+        }
+    }
+
+private:
+    int delta_count(WordId id) const { return delta_ ? delta_->successors.count_of(id) : 0; }
+
+    FrozenNGramModel::Context base_;
+    const ContextEntry *delta_ = nullptr;
+    uint32_t new_successors_ = 0;
+};
+
+// 供predict_word_ids使用的叠加模型视图，每次预测创建一个
+class OverlayModelView {
+public:
+    explicit OverlayModelView(const OverlayNGramModel &model)
+            : model_(model), base_(model.base()), delta_(model.delta()) {}
+
+    int order() const { return base_.order(); }
+
+    double smoothing() const { return base_.smoothing(); }
+
+    int total_words() const { return base_.total_words() + delta_.total_words; }
+
+    size_t vocabulary_size() const { return delta_.vocabulary_end(); }
+
+    std::string_view word(WordId id) const { return model_.word(id); }
+
+    WordId find_word(std::string_view word) const { return model_.find_word(word); }
+
+    int word_count(WordId id) const {
+        auto it = delta_.word_count.find(id);
+        return base_.word_count(id) + (it == delta_.word_count.end() ? 0 : it->second);
+    }
+
+    // 超出合并前缀后按基础模型的排名继续，已出现过的词由调用方跳过
+    WordId unigram_at(size_t rank) const {
+        const auto &head = model_.unigram_head();
+        if (rank < head.size()) return head[rank];
+        size_t base_head = std::min(base_.vocabulary_size(), OverlayNGramModel::UNIGRAM_HEAD);
+        return base_.unigram_at(rank - head.size() + base_head);
+    }
+
+    OverlayContext find_context(int n_size, const WordId *ids) const {
+        return make_context(base_.find_context(n_size, ids), find_delta(n_size, ids));
+    }
+
+    OverlayContext backoff_context(int n_size, const WordId *ids,
+                                   const OverlayContext &context) const {
+        auto base = context.base() ? base_.backoff_context(n_size, ids, context.base())
+                                   : base_.find_context(n_size - 1, ids + 1);
+        return make_context(base, find_delta(n_size - 1, ids + 1));
+    }
+
+private:
+    OverlayContext make_context(FrozenNGramModel::Context base, const ContextEntry *entry) const {
+        return {base, entry, entry ? model_.new_successors(entry) : 0};
+    }
+
+    const ContextEntry *find_delta(int n_size, const WordId *ids) const {
+        auto it = delta_.models.find(n_size);
+        if (it == delta_.models.end()) return nullptr;
+        return it->second.find(ContextKey(ids, n_size - 1));
+    }
+
+    const OverlayNGramModel &model_;
+    const FrozenNGramModel &base_;
+    const ModelDelta &delta_;
+};
+
+} // namespace
+
+OverlayNGramModel::OverlayNGramModel(std::shared_ptr<const FrozenNGramModel> base,
+                                     std::shared_ptr<const ModelDelta> delta)
+        : base_(std::move(base)), delta_(std::move(delta)) {
+
+    // 合并后的前UNIGRAM_HEAD名只可能来自基础模型的前UNIGRAM_HEAD名或增量中的词
+    size_t base_head = std::min(base_->vocabulary_size(), UNIGRAM_HEAD);
+    std::unordered_set<WordId> seen;
+    for (size_t i = 0; i < base_head; ++i) {
+        unigram_head_.push_back(base_->unigram_at(i));
+        seen.insert(unigram_head_.back());
+    }
+    for (const auto &entry: delta_->word_count) {
+        if (seen.insert(entry.first).second) {
+            unigram_head_.push_back(entry.first);
+        }
+    }
+
+    OverlayModelView view(*this);
+    std::sort(unigram_head_.begin(), unigram_head_.end(), [&view](WordId a, WordId b) {
+        int count_a = view.word_count(a);
+        int count_b = view.word_count(b);
+        return count_a > count_b || (count_a == count_b && a < b);
+    });
+
+    // 每个增量上下文只统计一次，预测时回退权重不需要遍历后继词
+    for (const auto &model: delta_->models) {
+        for (const auto &context: model.second) {
+            auto base_context = base_->find_context(model.first, context.first.data());
+            uint32_t count = 0;
+            for (const auto &successor: context.second.successors) {
+                if (!base_context || base_context.count_of(successor.first) == 0) ++count;
+            }
+            new_successors_.emplace(&context.second, count);
+        }
+    }
+}
+
+PrefixIndex OverlayNGramModel::build_prefix_index() const {
+    return PrefixIndex(OverlayModelView(*this));
+}
+
+WordId OverlayNGramModel::find_word(std::string_view word) const {
+    WordId id = base_->find_word(word);
+    return id == INVALID_WORD_ID ? delta_->find_new_word(word) : id;
+}
+
+std::string_view OverlayNGramModel::word(WordId id) const {
+    if (id < delta_->base_vocab_size) return base_->word(id);
+    return delta_->new_words.word(id - delta_->base_vocab_size);
+}
+
+void OverlayNGramModel::predict_views(std::string_view context, int num_predictions,
+                                      std::vector<PredictionView> &out) const {
+    auto &scratch = PredictScratch::local();
+    predict_word_views(OverlayModelView(*this), context, num_predictions, scratch, out);
+}
+
+void OverlayNGramModel::predict_views(const std::vector<WordId> &words, int num_predictions,
+                                      std::vector<PredictionView> &out) const {
+    auto &scratch = PredictScratch::local();
+    predict_id_views(OverlayModelView(*this), words, num_predictions, scratch, out);
+}
+
+std::vector<std::pair<std::string, double>> OverlayNGramModel::predict_next_word(
+        const std::string &context, int num_predictions) const {
+    std::vector<PredictionView> views;
+    predict_views(context, num_predictions, views);
+    return to_string_results(views);
+}
+
+std::vector<std::pair<std::string, double>> OverlayNGramModel::complete_word(
+        const std::vector<WordId> &words, std::string_view prefix,
+        const PrefixIndex &index, int num_completions) const {
+
+    auto ranked = complete_word_ids(OverlayModelView(*this), index, words, prefix,
+                                    num_completions);
+
+    std::vector<std::pair<std::string, double>> result;
+    result.reserve(ranked.size());
+    for (const auto &entry: ranked) {
+        result.emplace_back(std::string(word(entry.first)), entry.second);
+    }
+    return result;
+}
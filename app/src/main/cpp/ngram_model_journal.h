@@ -0,0 +1,130 @@
+#ifndef NGRAM_MODEL_JOURNAL_H
+#define NGRAM_MODEL_JOURNAL_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ngarm_model_data.h"
+#include "ngram_model_frozen.h"
+
+// 增量日志：每轮训练只把新增的计数追加到日志文件，冻结的基础模型保持不变，
+// 日志超过阈值后再合并生成新的基础模型。
+//
+// 文件布局：
+//   JournalHeader                 记录对应的基础模型，不匹配时整个日志作废
+//   若干条记录，每条为：
+//     uint32 payload_size
+//     uint32 checksum              payload的FNV-1a校验和，用于丢弃写了一半的尾部记录
+//     payload                      uint32序列：
+//       total_words
+//       new_word_count，随后每个新词为 uint32 长度 + 字节
+//       unigram_count，随后每项为 (word, delta)
+//       order_count，随后每阶为 order, entry_count, 每项 (context[order-1], word, delta)
+
+const char JOURNAL_MAGIC[8] = {'N', 'G', 'R', 'A', 'M', 'J', 'N', 'L'};
+const uint32_t JOURNAL_VERSION = 1;
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t base_vocab_size;
+    uint64_t base_total_words;
+    uint64_t base_file_size;
+};
+
+// 冻结基础模型之上新增的计数，单词使用全局ID：
+// 小于base_vocab_size的是基础模型中的词，之后依次是new_words中的新词
+struct ModelDelta {
+    uint32_t base_vocab_size = 0;
+    Vocabulary new_words;
+    int total_words = 0;
+    std::unordered_map<WordId, int> word_count;
+    std::unordered_map<int, ContextMap> models;
+
+    bool empty() const { return total_words == 0; }
+
+    // 下一个新词的全局ID
+    WordId vocabulary_end() const {
+        return base_vocab_size + static_cast<WordId>(new_words.size());
+    }
+
+    WordId find_new_word(std::string_view word) const {
+        WordId id = new_words.find(word);
+        return id == INVALID_WORD_ID ? INVALID_WORD_ID : base_vocab_size + id;
+    }
+
+    // 合并紧随其后的一批增量（batch.base_vocab_size必须等于vocabulary_end()）
+    bool merge(const ModelDelta &batch);
+};
+
+// 按count_text的规则统计一段文本相对于base + delta的增量
+ModelDelta build_model_delta(const std::string &text, const FrozenNGramModel &base,
+                             const ModelDelta &delta);
+
+// 写入只有文件头的空日志（先写临时文件再rename）
+bool reset_journal(const std::string &file_path, const FrozenNGramModel &base);
+
+// 追加一条记录，journal_size返回追加后的文件大小
+bool append_journal_record(const std::string &file_path, const FrozenNGramModel &base,
+                           const ModelDelta &batch, size_t *journal_size);
+
+// 重放日志得到累计增量。日志不存在或不属于base时重置为空日志，
+// 尾部不完整的记录会被截掉
+std::shared_ptr<ModelDelta> replay_journal(const std::string &file_path,
+                                           const FrozenNGramModel &base);
+
+// 不经过冻结模型读取日志，只校验词汇表大小和总词数。用于冻结文件无法映射
+// （例如格式升级）时把增量合并到同一时刻保存的.bin模型，不匹配时返回nullptr
+std::shared_ptr<ModelDelta> read_journal(const std::string &file_path, uint32_t base_vocab_size,
+                                         uint64_t base_total_words, int order);
+
+// 冻结基础模型叠加增量后的只读视图，预测结果与合并后的模型一致
+class OverlayNGramModel {
+public:
+    OverlayNGramModel(std::shared_ptr<const FrozenNGramModel> base,
+                      std::shared_ptr<const ModelDelta> delta);
+
+    std::vector<std::pair<std::string, double>> predict_next_word(
+            const std::string &context, int num_predictions = 3) const;
+
+    void predict_views(std::string_view context, int num_predictions,
+                       std::vector<PredictionView> &out) const;
+
+    void predict_views(const std::vector<WordId> &words, int num_predictions,
+                       std::vector<PredictionView> &out) const;
+
+    std::vector<std::pair<std::string, double>> complete_word(
+            const std::vector<WordId> &words, std::string_view prefix,
+            const PrefixIndex &index, int num_completions = 3) const;
+
+    PrefixIndex build_prefix_index() const;
+
+    WordId find_word(std::string_view word) const;
+
+    std::string_view word(WordId id) const;
+
+    const FrozenNGramModel &base() const { return *base_; }
+
+    const ModelDelta &delta() const { return *delta_; }
+
+    // 合并后按次数降序排列的一元排名前缀，覆盖基础模型的前UNIGRAM_HEAD个词和所有增量词
+    const std::vector<WordId> &unigram_head() const { return unigram_head_; }
+
+    // unigram_head中前UNIGRAM_HEAD项与合并后的模型完全一致，之后的排名为近似值
+    static constexpr size_t UNIGRAM_HEAD = 64;
+
+    // 增量上下文中基础模型没有的后继词数，用于得到合并后的后继词数和回退权重
+    uint32_t new_successors(const ContextEntry *entry) const {
+        auto it = new_successors_.find(entry);
+        return it == new_successors_.end() ? 0 : it->second;
+    }
+
+private:
+    std::shared_ptr<const FrozenNGramModel> base_;
+    std::shared_ptr<const ModelDelta> delta_;
+    std::vector<WordId> unigram_head_;
+    std::unordered_map<const ContextEntry *, uint32_t> new_successors_;
+};
+
+#endif // NGRAM_MODEL_JOURNAL_H
@@ -0,0 +1,106 @@
+#include "ngram_model_memory.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// 单词字符的堆分配，短字符串存放在对象内部时为0
+size_t string_heap_bytes(const std::string &word) {
+    const char *object = reinterpret_cast<const char *>(&word);
+    std::less<const char *> before;
+    bool inline_storage = !before(word.data(), object) && before(word.data(), object + sizeof(word));
+    return inline_storage ? 0 : word.capacity() + 1;
+}
+
+// deque的分块和分块指针数组
+template<typename T>
+size_t deque_bytes(size_t size) {
+#ifdef _LIBCPP_VERSION
+    size_t per_block = sizeof(T) < 256 ? 4096 / sizeof(T) : 16;
+#else
+    size_t per_block = sizeof(T) < 512 ? 512 / sizeof(T) : 1;
+#endif
+    size_t blocks = (size + per_block) / per_block;
+    return blocks * per_block * sizeof(T) + std::max<size_t>(blocks + 2, 8) * sizeof(void *);
+}
+
+// 节点式哈希表：每个节点一个next指针、缓存的哈希值和元素，每个桶一个指针
+template<typename Map>
+size_t hash_table_bytes(const Map &map) {
+    return map.size() * (sizeof(void *) + sizeof(size_t) + sizeof(typename Map::value_type)) +
+           map.bucket_count() * sizeof(void *);
+}
+
+void add_vocabulary(const Vocabulary &vocabulary, ModelMemory &memory) {
+    memory.words += vocabulary.size();
+    for (const auto &word: vocabulary.words) {
+        memory.string_bytes += string_heap_bytes(word);
+    }
+    memory.vocabulary_bytes += deque_bytes<std::string>(vocabulary.words.size()) +
+                               hash_table_bytes(vocabulary.ids);
+}
+
+void add_orders(const std::unordered_map<int, ContextMap> &models, ModelMemory &memory) {
+    for (const auto &model: models) {
+        if (model.first < 2) continue;
+        if ((size_t) model.first >= memory.orders.size()) memory.orders.resize(model.first + 1);
+        OrderMemory &order = memory.orders[model.first];
+
+        const ContextMap &context_map = model.second;
+        TableMemory table = context_map.memory();
+        order.contexts += context_map.size();
+        order.entry_bytes += table.entries;
+        order.key_bytes += table.keys;
+        order.slot_bytes += table.slots;
+
+        size_t successor_bytes = 0, ranked_bytes = 0;
+        for (const auto &context: context_map) {
+            order.ngrams += context.second.successors.size();
+            successor_bytes += context.second.successors.table_bytes();
+            ranked_bytes += context.second.top.bytes();
+        }
+        order.successor_bytes += successor_bytes;
+        order.ranked_bytes += ranked_bytes;
+        size_t allocated = successor_bytes + ranked_bytes;
+        order.arena_overhead += table.arena_reserved > allocated ? table.arena_reserved - allocated : 0;
+    }
+}
+
+} // namespace
+
+size_t ModelMemory::heap_bytes() const {
+    size_t bytes = string_bytes + vocabulary_bytes + unigram_bytes;
+    for (const auto &order: orders) {
+        bytes += order.heap_bytes();
+    }
+    return bytes;
+}
+
+ModelMemory measure_memory(const NGramModelData &data) {
+    ModelMemory memory;
+    memory.orders.resize(std::max(data.n, 1) + 1);
+    add_vocabulary(data.vocabulary, memory);
+    memory.unigram_bytes = data.word_count.capacity() * sizeof(int) +
+                           data.unigram_rank.capacity() * sizeof(WordId);
+    add_orders(data.models, memory);
+    return memory;
+}
+
+ModelMemory measure_memory(const FrozenNGramModel &base, const ModelDelta *delta) {
+    ModelMemory memory;
+    memory.orders.resize(std::max(base.order(), 1) + 1);
+    memory.words = base.vocabulary_size();
+    memory.mapped_bytes = base.mapped_size();
+    memory.mapped_string_bytes = base.string_pool_size();
+    for (int n_size = 2; n_size <= base.order(); ++n_size) {
+        OrderMemory &order = memory.orders[n_size];
+        base.count_order(n_size, order.contexts, order.ngrams);
+        order.mapped_bytes = base.order_bytes(n_size);
+    }
+    if (delta) {
+        add_vocabulary(delta->new_words, memory);
+        memory.unigram_bytes += hash_table_bytes(delta->word_count);
+        add_orders(delta->models, memory);
+    }
+    return memory;
+}
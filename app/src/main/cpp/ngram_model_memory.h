@@ -0,0 +1,53 @@
+#ifndef NGRAM_MODEL_MEMORY_H
+#define NGRAM_MODEL_MEMORY_H
+
+#include <cstddef>
+#include <vector>
+#include "ngarm_model_data.h"
+#include "ngram_model_frozen.h"
+#include "ngram_model_journal.h"
+
+// 模型实际占用的内存（字节），用于观察模型增长，不修改模型也不复制模型。
+// flat表、后继词表和内存池按容量精确计算；词汇表使用标准库容器，
+// 哈希节点和deque分块按libc++/libstdc++的布局计算。都不含malloc自身的簿记开销。
+//
+// 与ModelFootprint不同：ModelFootprint是按项数估算的、与实现无关的规模，用于和内存预算比较；
+// 这里是当前这份数据结构真正占用的内存，剪枝或收缩哈希表后才会下降。
+
+// 一阶n元语法表
+struct OrderMemory {
+    size_t contexts = 0;
+    size_t ngrams = 0;
+    size_t entry_bytes = 0;      // ContextEntry数组，一两个后继词内联在其中
+    size_t key_bytes = 0;        // 打包的上下文键
+    size_t slot_bytes = 0;       // 上下文哈希槽位
+    size_t successor_bytes = 0;  // 内存池中的后继词哈希表
+    size_t ranked_bytes = 0;     // 内存池中的top
+    size_t arena_overhead = 0;   // 内存池中其余部分：分级取整、空闲块、大块尾部
+    size_t mapped_bytes = 0;     // 冻结模型中这一阶的数组
+
+    size_t heap_bytes() const {
+        return entry_bytes + key_bytes + slot_bytes + successor_bytes + ranked_bytes +
+               arena_overhead;
+    }
+};
+
+struct ModelMemory {
+    size_t words = 0;
+    size_t string_bytes = 0;         // 堆上的单词字符（短字符串存放在string对象内，不计入）
+    size_t vocabulary_bytes = 0;     // string对象、deque分块和单词索引
+    size_t unigram_bytes = 0;        // 一元次数和一元排名
+    size_t mapped_bytes = 0;         // 冻结文件的映射大小（文件页，内存紧张时可由系统回收）
+    size_t mapped_string_bytes = 0;  // 其中的字符串池
+    std::vector<OrderMemory> orders; // 下标为阶数，二阶起有效
+
+    // 堆内存合计，不含映射
+    size_t heap_bytes() const;
+};
+
+ModelMemory measure_memory(const NGramModelData &data);
+
+// 冻结模型加上日志增量；增量的各阶表计入对应阶的堆内存
+ModelMemory measure_memory(const FrozenNGramModel &base, const ModelDelta *delta);
+
+#endif // NGRAM_MODEL_MEMORY_H
@@ -0,0 +1,207 @@
+#include "ngram_model_prune.h"
+#include "jni_log.h"
+#include <functional>
+
+namespace {
+
+// 64位下的估算开销（libc++与libstdc++相近）
+// 单词：deque中的string、ids的节点和桶、word_count和unigram_rank中的一项
+const size_t WORD_BYTES = 88;
+// 上下文：ContextEntry本身，加上打包的键和槽位按平均装载率折算的开销
+const size_t CONTEXT_BYTES = sizeof(ContextEntry) + 24;
+// n元语法：只有一两个后继词时存放在SuccessorMap内，平均下来每项只有几个字节的槽位开销
+const size_t SUCCESSOR_BYTES = 6;
+const size_t RANKED_BYTES = sizeof(std::pair<WordId, int>);
+
+void add_entries(const std::unordered_map<int, ContextMap> &models, ModelFootprint &footprint) {
+    for (const auto &model: models) {
+        footprint.contexts += model.second.size();
+        for (const auto &context: model.second) {
+            footprint.successors += context.second.successors.size();
+            footprint.ranked += context.second.top.size();
+        }
+    }
+}
+
+// 待剪枝的n元语法 (上下文, word)
+struct Candidate {
+    ContextEntry *entry;
+    const ContextEntry *lower;  // 去掉上下文第一个词后的低阶上下文，二阶时为空
+    WordId word;
+    int order;
+    int count;
+    double score;               // 删除后的相对熵
+};
+
+bool entry_word_before(const Candidate &a, const Candidate &b) {
+    return std::less<const ContextEntry *>()(a.entry, b.entry) ||
+           (a.entry == b.entry && a.word < b.word);
+}
+
+// 先按次数、再按相对熵从小到大删除；相同时先删高阶
+bool prunes_before(const Candidate &a, const Candidate &b) {
+    if (a.count != b.count) return a.count < b.count;
+    if (a.score != b.score) return a.score < b.score;
+    return a.order > b.order;
+}
+
+// 删除后的代价：P(h, w) * log(P(w|h) / P(w|h'))，省略公共的1 / total_words。
+// 高阶概率不高于低阶时删除几乎不损失信息
+double relative_entropy(int count, int total, double lower_probability) {
+    double probability = (double) count / total;
+    return count * std::log(probability / lower_probability);
+}
+
+// 为二阶及以上的全部n元语法打分，按删除顺序返回。
+// 低阶n元语法的次数和分数取它与所有扩展中的最大值，保证扩展都删除后才轮到它
+std::vector<Candidate> score_candidates(NGramModelData &data) {
+    std::vector<std::vector<Candidate>> orders(data.n + 1);
+
+    for (int order = 2; order <= data.n; ++order) {
+        auto model = data.models.find(order);
+        if (model == data.models.end()) continue;
+        const ContextMap *lower_map = nullptr;
+        if (order > 2) {
+            auto lower = data.models.find(order - 1);
+            if (lower != data.models.end()) lower_map = &lower->second;
+        }
+
+        auto &candidates = orders[order];
+        for (const auto &context: model->second) {
+            ContextEntry &entry = context.second;
+            const ContextEntry *lower = nullptr;
+            if (lower_map) {
+                lower = lower_map->find(ContextKey(context.first.data() + 1,
+                                                   context.first.size() - 1));
+            }
+
+            for (const auto &successor: entry.successors) {
+                WordId word = successor.first;
+                // 二阶（或缺少低阶项时）与一元概率比较，低阶计数不小于高阶计数
+                int count = word < data.word_count.size() ? data.word_count[word] : 0;
+                double lower_probability = (double) std::max(count, successor.second) /
+                                           std::max(data.total_words, entry.total);
+                if (lower) {
+                    auto found = lower->successors.find(word);
+                    if (found != lower->successors.end()) {
+                        lower_probability = (double) found->second / lower->total;
+                    }
+                }
+                candidates.push_back({&entry, lower, word, order, successor.second,
+                                      relative_entropy(successor.second, entry.total,
+                                                       lower_probability)});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), entry_word_before);
+    }
+
+    // 从最高阶开始，此时本阶的次数和分数已经是最终值
+    for (int order = data.n; order > 2; --order) {
+        auto &lower_candidates = orders[order - 1];
+        for (const auto &candidate: orders[order]) {
+            if (!candidate.lower) continue;
+            Candidate key = candidate;
+            key.entry = const_cast<ContextEntry *>(candidate.lower);
+            auto it = std::lower_bound(lower_candidates.begin(), lower_candidates.end(), key,
+                                       entry_word_before);
+            if (it != lower_candidates.end() && it->entry == key.entry && it->word == key.word &&
+                prunes_before(*it, candidate)) {
+                it->count = candidate.count;
+                it->score = candidate.score;
+            }
+        }
+    }
+
+    std::vector<Candidate> all;
+    for (auto &candidates: orders) {
+        all.insert(all.end(), candidates.begin(), candidates.end());
+        std::vector<Candidate>().swap(candidates);
+    }
+    std::sort(all.begin(), all.end(), prunes_before);
+    return all;
+}
+
+} // namespace
+
+size_t ModelFootprint::bytes() const {
+    return words * WORD_BYTES + word_bytes + contexts * CONTEXT_BYTES +
+           successors * SUCCESSOR_BYTES + ranked * RANKED_BYTES;
+}
+
+ModelFootprint measure_model(const NGramModelData &data) {
+    ModelFootprint footprint;
+    footprint.words = data.vocabulary.size();
+    for (const auto &word: data.vocabulary.words) {
+        footprint.word_bytes += word.size();
+    }
+    add_entries(data.models, footprint);
+    return footprint;
+}
+
+ModelFootprint measure_model(const FrozenNGramModel &base, const ModelDelta *delta) {
+    ModelFootprint footprint;
+    footprint.words = base.vocabulary_size();
+    footprint.word_bytes = base.string_pool_size() - base.vocabulary_size();
+    base.count_entries(footprint.contexts, footprint.successors, footprint.ranked);
+    if (delta) {
+        footprint.words += delta->new_words.size();
+        for (const auto &word: delta->new_words.words) {
+            footprint.word_bytes += word.size();
+        }
+        add_entries(delta->models, footprint);
+    }
+    return footprint;
+}
+
+PruneResult prune_model_data(NGramModelData &data, const PruneOptions &options) {
+    PruneResult result;
+    result.bytes_before = measure_model(data).bytes();
+
+    // 1. 次数截断。低阶计数不小于对应的高阶计数，不会留下缺少低阶项的高阶项
+    if (options.min_count > 1) {
+        for (auto &model: data.models) {
+            if (model.first < 2) continue;
+            for (const auto &context: model.second) {
+                result.removed_ngrams += context.second.erase_if(
+                        [&options](const auto &successor) {
+                            return successor.second < options.min_count;
+                        });
+            }
+        }
+    }
+
+    // 2. 按次数和相对熵继续删除，直到估算的内存回到预算以内
+    size_t bytes = result.bytes_before - result.removed_ngrams * SUCCESSOR_BYTES;
+    if (options.memory_budget > 0 && bytes > options.memory_budget && data.total_words > 0) {
+        size_t excess = bytes - options.memory_budget;
+        size_t reclaimed = 0;
+        for (const auto &candidate: score_candidates(data)) {
+            if (reclaimed >= excess) break;
+            const auto &successors = candidate.entry->successors;
+            candidate.entry->erase(candidate.word);
+            ++result.removed_ngrams;
+            reclaimed += SUCCESSOR_BYTES;
+            if (successors.size() < (size_t) TOP_K_SUCCESSORS) reclaimed += RANKED_BYTES;
+            if (successors.empty()) reclaimed += CONTEXT_BYTES;
+        }
+    }
+
+    // 3. 删除空上下文，重建total和top，再把整张表按最小容量复制到新的内存池
+    for (auto &model: data.models) {
+        auto &context_map = model.second;
+        result.removed_contexts += context_map.erase_if([](const ContextEntry &entry) {
+            return entry.successors.empty();
+        });
+        if (result.removed_ngrams > 0) {
+            for (const auto &context: context_map) {
+                context.second.rebuild();
+            }
+        }
+        context_map.shrink_to_fit();
+    }
+
+    result.bytes_after = measure_model(data).bytes();
+    LOGD("Pruned %zu n-grams and %zu contexts, %zu -> %zu bytes",
+         result.removed_ngrams, result.removed_contexts, result.bytes_before, result.bytes_after);
+    return result;
+}
@@ -0,0 +1,48 @@
+#ifndef NGRAM_MODEL_PRUNE_H
+#define NGRAM_MODEL_PRUNE_H
+
+#include <cstddef>
+#include "ngarm_model_data.h"
+#include "ngram_model_frozen.h"
+#include "ngram_model_journal.h"
+
+// 模型规模。bytes()按64位下哈希表槽位和堆块的典型开销估算内存模型的占用，
+// 只用于和内存预算比较，不是精确值
+struct ModelFootprint {
+    size_t words = 0;
+    size_t word_bytes = 0;    // 所有单词的字节数之和
+    size_t contexts = 0;      // 二阶及以上的上下文数
+    size_t successors = 0;    // 二阶及以上的n元语法数
+    size_t ranked = 0;        // 各上下文top中的项数
+
+    size_t bytes() const;
+};
+
+ModelFootprint measure_model(const NGramModelData &data);
+
+// 冻结模型还原并合并增量后的规模。增量中与基础模型重复的项会重复计算，结果偏大
+ModelFootprint measure_model(const FrozenNGramModel &base, const ModelDelta *delta);
+
+struct PruneOptions {
+    size_t memory_budget = 0;  // 估算内存上限（字节），0表示不按内存剪枝
+    int min_count = 0;         // 次数低于此值的二阶及以上n元语法直接删除
+};
+
+struct PruneResult {
+    size_t removed_ngrams = 0;
+    size_t removed_contexts = 0;
+    size_t bytes_before = 0;
+    size_t bytes_after = 0;
+
+    size_t bytes_reclaimed() const { return bytes_before - bytes_after; }
+};
+
+// 剪枝二阶及以上的n元语法，单词和一元计数保持不变：
+//   1. 删除次数低于min_count的n元语法
+//   2. 仍超出memory_budget时按次数从小到大继续删除，次数相同的先删相对熵
+//      （删除后模型分布的变化）小的，即低阶已能给出相近概率的n元语法
+// 低阶n元语法在对应的高阶n元语法全部删除后才会被删除，保持"高阶后继词一定也是低阶后继词"。
+// 最后删除空上下文，重建total和top，并收缩哈希表
+PruneResult prune_model_data(NGramModelData &data, const PruneOptions &options);
+
+#endif // NGRAM_MODEL_PRUNE_H
@@ -0,0 +1,99 @@
+#include "ngram_perfect_hash.h"
+#include "jni_log.h"
+#include <algorithm>
+
+namespace {
+
+const uint32_t KEYS_PER_BUCKET = 4;
+const int MAX_SEED_ATTEMPTS = 16;
+
+// 尝试用一个种子构建，失败时返回false
+bool build_with_seed(const std::vector<std::string_view> &keys, uint64_t seed,
+                     PerfectHashTables &tables) {
+    const uint32_t n = keys.size();
+    tables.seed = seed;
+    tables.bucket_count = (n + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET;
+    tables.slot_count = n + n / 32 + 1;
+    tables.pilots.assign(tables.bucket_count, 0);
+    tables.remap.assign(tables.slot_count - n, 0);
+
+    // (桶, 哈希)，哈希相同的两个单词无论pilot是多少都会冲突
+    std::vector<std::pair<uint32_t, uint64_t>> entries(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        uint64_t hash = hash_word(keys[i], seed);
+        entries[i] = {PerfectHash::bucket_of(hash, tables.bucket_count), hash};
+    }
+    std::sort(entries.begin(), entries.end());
+    for (uint32_t i = 1; i < n; ++i) {
+        if (entries[i].second == entries[i - 1].second) return false;
+    }
+
+    // 每个桶在entries中的区间，按大小降序处理
+    std::vector<std::pair<uint32_t, uint32_t>> buckets;  // (起点, 大小)
+    for (uint32_t i = 0; i < n;) {
+        uint32_t j = i;
+        while (j < n && entries[j].first == entries[i].first) ++j;
+        buckets.emplace_back(i, j - i);
+        i = j;
+    }
+    std::stable_sort(buckets.begin(), buckets.end(),
+                     [](const auto &a, const auto &b) { return a.second > b.second; });
+
+    std::vector<bool> taken(tables.slot_count, false);
+    std::vector<uint32_t> slots;
+    for (const auto &bucket: buckets) {
+        bool placed = false;
+        for (uint32_t pilot = 0; pilot <= UINT16_MAX && !placed; ++pilot) {
+            slots.clear();
+            placed = true;
+            for (uint32_t k = bucket.first; k < bucket.first + bucket.second; ++k) {
+                uint32_t slot = PerfectHash::slot_of(entries[k].second, (uint16_t) pilot,
+                                                     tables.slot_count);
+                if (taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (placed) {
+                for (uint32_t slot: slots) taken[slot] = true;
+                tables.pilots[entries[bucket.first].first] = (uint16_t) pilot;
+            }
+        }
+        if (!placed) return false;
+    }
+
+    // [n, slot_count)中被占用的位置依次映射到[0, n)中的空位，两者数量相同
+    uint32_t free_slot = 0;
+    for (uint32_t slot = n; slot < tables.slot_count; ++slot) {
+        if (!taken[slot]) continue;
+        while (taken[free_slot]) ++free_slot;
+        tables.remap[slot - n] = free_slot++;
+    }
+    return true;
+}
+
+} // namespace
+
+uint64_t hash_word(std::string_view word, uint64_t seed) {
+    // FNV-1a逐字节累加，再经mix打散
+    uint64_t hash = 0xcbf29ce484222325ull ^ seed;
+    for (unsigned char c: word) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return PerfectHash::mix(hash);
+}
+
+bool build_perfect_hash(const std::vector<std::string_view> &keys, PerfectHashTables &tables) {
+    tables = PerfectHashTables();
+    if (keys.empty()) return true;
+    if (keys.size() > UINT32_MAX / 2) return false;
+
+    for (int attempt = 0; attempt < MAX_SEED_ATTEMPTS; ++attempt) {
+        if (build_with_seed(keys, PerfectHash::mix(attempt + 1), tables)) return true;
+        LOGW("Perfect hash attempt %d failed, retrying with another seed", attempt);
+    }
+    LOGE("Failed to build perfect hash for %zu keys", keys.size());
+    return false;
+}
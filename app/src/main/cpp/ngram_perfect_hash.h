@@ -0,0 +1,89 @@
+#ifndef NGRAM_PERFECT_HASH_H
+#define NGRAM_PERFECT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// 单词集合上的最小完美哈希（哈希-位移方式，类似CHD/PTHash）：
+// n个单词映射到[0, n)中互不相同的位置，查询只需一次字符串哈希和几次整数运算。
+//
+// 单词按哈希分到约n/4个桶，每个桶存一个16位的pilot，位置由单词哈希和所在桶的pilot决定。
+// 构建时按桶从大到小为每个桶找到让桶内单词都落在空位上的pilot。位置空间比n多约3%，
+// 保证最后的桶也能很快找到pilot；落在[n, slot_count)的位置再经remap表映射到[0, n)中的空位。
+// 每个单词约占4位（pilot）加不到1位（remap）。
+//
+// 集合外的单词也会得到某个位置，调用方需比较单词本身确认。
+// 哈希按字节计算，与平台字节序无关，结果可以写入文件。
+
+// 单词的64位哈希
+uint64_t hash_word(std::string_view word, uint64_t seed);
+
+// 构建结果，写入冻结文件后由PerfectHash直接引用
+struct PerfectHashTables {
+    uint64_t seed = 0;
+    uint32_t bucket_count = 0;
+    uint32_t slot_count = 0;
+    std::vector<uint16_t> pilots;   // [bucket_count]
+    std::vector<uint32_t> remap;    // [slot_count - n]
+};
+
+// keys必须互不相同。换多个种子仍无法构建时返回false
+bool build_perfect_hash(const std::vector<std::string_view> &keys, PerfectHashTables &tables);
+
+class PerfectHash {
+public:
+    PerfectHash() = default;
+
+    // 数组可以直接指向映射的文件，由调用方保证有效
+    PerfectHash(uint64_t seed, uint32_t key_count, uint32_t bucket_count, uint32_t slot_count,
+                const uint16_t *pilots, const uint32_t *remap)
+            : seed_(seed), key_count_(key_count), bucket_count_(bucket_count),
+              slot_count_(slot_count), pilots_(pilots), remap_(remap) {}
+
+    explicit PerfectHash(const PerfectHashTables &tables, uint32_t key_count)
+            : PerfectHash(tables.seed, key_count, tables.bucket_count, tables.slot_count,
+                          tables.pilots.data(), tables.remap.data()) {}
+
+    // word所在的位置；集合为空或表损坏时返回key_count
+    uint32_t position(std::string_view word) const {
+        if (bucket_count_ == 0) return key_count_;
+        uint64_t hash = hash_word(word, seed_);
+        uint32_t slot = slot_of(hash, pilots_[bucket_of(hash, bucket_count_)], slot_count_);
+        return slot < key_count_ ? slot : remap_[slot - key_count_];
+    }
+
+    static uint32_t bucket_of(uint64_t hash, uint32_t bucket_count) {
+        return range(hash, bucket_count);
+    }
+
+    static uint32_t slot_of(uint64_t hash, uint16_t pilot, uint32_t slot_count) {
+        return range(mix(hash ^ (pilot * 0x9e3779b97f4a7c15ull + 1)), slot_count);
+    }
+
+    // splitmix64的终结函数
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+
+private:
+    // 用高32位把哈希映射到[0, n)，避免取模
+    static uint32_t range(uint64_t hash, uint32_t n) {
+        return (uint32_t) (((hash >> 32) * (uint64_t) n) >> 32);
+    }
+
+    uint64_t seed_ = 0;
+    uint32_t key_count_ = 0;
+    uint32_t bucket_count_ = 0;
+    uint32_t slot_count_ = 0;
+    const uint16_t *pilots_ = nullptr;
+    const uint32_t *remap_ = nullptr;
+};
+
+#endif // NGRAM_PERFECT_HASH_H
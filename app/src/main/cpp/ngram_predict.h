@@ -0,0 +1,322 @@
+#ifndef NGRAM_PREDICT_H
+#define NGRAM_PREDICT_H
+
+#include <climits>
+#include "ngarm_model_data.h"
+#include "ngram_backoff.h"
+#include "ngram_tokenizer.h"
+
+// 预测候选词表：开放寻址，按插入顺序保存候选词。
+// clear()只递增代数，反复使用时不再分配内存
+class CandidateTable {
+public:
+    void clear() {
+        entries_.clear();
+        if (++generation_ == 0) {
+            std::fill(stamps_.begin(), stamps_.end(), 0);
+            generation_ = 1;
+        }
+    }
+
+    size_t size() const { return entries_.size(); }
+
+    std::vector<std::pair<WordId, double>> &entries() { return entries_; }
+
+    // 返回候选词概率的位置（下一次插入前有效）以及是否为新插入
+    std::pair<double *, bool> try_emplace(WordId id) {
+        if ((entries_.size() + 1) * 2 > stamps_.size()) grow();
+
+        size_t slot = probe(id);
+        if (stamps_[slot] == generation_) {
+            return {&entries_[indices_[slot]].second, false};
+        }
+        stamps_[slot] = generation_;
+        indices_[slot] = static_cast<uint32_t>(entries_.size());
+        entries_.emplace_back(id, 0.0);
+        return {&entries_.back().second, true};
+    }
+
+private:
+    // 返回id所在的槽位，不存在时返回应插入的空槽位
+    size_t probe(WordId id) const {
+        size_t mask = stamps_.size() - 1;
+        size_t slot = (id * 0x9E3779B1u) & mask;
+        while (stamps_[slot] == generation_ && entries_[indices_[slot]].first != id) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void grow() {
+        size_t capacity = std::max<size_t>(64, stamps_.size() * 2);
+        stamps_.assign(capacity, 0);
+        indices_.assign(capacity, 0);
+        generation_ = 1;
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            size_t slot = probe(entries_[i].first);
+            stamps_[slot] = generation_;
+            indices_[slot] = static_cast<uint32_t>(i);
+        }
+    }
+
+    std::vector<std::pair<WordId, double>> entries_;
+    std::vector<uint32_t> stamps_;   // 等于generation_的槽位有效
+    std::vector<uint32_t> indices_;  // 槽位 -> entries_下标
+    uint32_t generation_ = 1;
+};
+
+// 每个线程复用的预测缓冲区，容量只增不减，预热后预测过程不再分配内存
+struct PredictScratch {
+    std::string text;                     // JNI复制进来的上下文
+    std::string lowered;                  // 小写后的单词
+    std::vector<std::pair<size_t, size_t>> spans;
+    std::vector<std::string_view> words;  // 指向lowered
+    std::vector<WordId> ids;
+    CandidateTable candidates;
+    std::vector<std::pair<WordId, double>> ranked;
+    std::vector<PredictionView> results;
+    int hit_order = 0;                    // 本线程最近一次预测或补全用到的最高阶数，供统计使用
+
+    static PredictScratch &local() {
+        static thread_local PredictScratch scratch;
+        return scratch;
+    }
+};
+
+// 从末尾向前扫描，只取最后max_words个单词（小写），按原顺序写入scratch.words。
+// 分词规则与训练用的tokenize_text一致
+inline void tokenize_tail(std::string_view text, size_t max_words, PredictScratch &scratch) {
+    scratch.spans.clear();
+    size_t end = text.size();
+    size_t total = 0;
+    bool word = false;
+    while (scratch.spans.size() < max_words) {
+        while (end > 0) {
+            size_t length = previous_char(text, end, word);
+            if (word) break;
+            end -= length;
+        }
+        if (end == 0) break;
+        size_t begin = end;
+        while (begin > 0) {
+            size_t length = previous_char(text, begin, word);
+            if (!word) break;
+            begin -= length;
+        }
+        scratch.spans.emplace_back(begin, end);
+        total += end - begin;
+        end = begin;
+    }
+
+    // 先确定总长度再写入，避免lowered扩容使已有的string_view失效
+    scratch.lowered.resize(total);
+    scratch.words.clear();
+    char *out = &scratch.lowered[0];
+    for (auto it = scratch.spans.rbegin(); it != scratch.spans.rend(); ++it) {
+        size_t length = it->second - it->first;
+        lower_word(text.data() + it->first, length, out);
+        scratch.words.emplace_back(out, length);
+        out += length;
+    }
+}
+
+// 预测算法模板，内存模型和只读映射模型共用同一套打分逻辑（见ngram_backoff.h）
+//
+// Model需要提供：
+//   int order() const;                     n元模型的最大阶数
+//   double smoothing() const;
+//   int total_words() const;
+//   size_t vocabulary_size() const;
+//   int word_count(WordId id) const;
+//   WordId unigram_at(size_t rank) const;  按次数降序的第rank个词
+//   Context find_context(int n_size, const WordId *ids) const;
+//   Context backoff_context(int n_size, const WordId *ids, const Context &context) const;
+//
+// Context需要可默认构造，并提供：
+//   explicit operator bool() const;        是否命中
+//   int total() const;                     所有后继词次数之和
+//   int count_of(WordId id) const;         某个后继词的次数，不存在为0
+//   double backoff_weight() const;
+//   size_t size() const;                   后继词数
+//   void for_each_ranked(size_t limit, F f) const;
+//       回调f(WordId, int)，至少覆盖次数最高的前limit个后继词
+//
+// 各阶上下文的后继词和一元排名各自按次数降序排列，每次从下一个词份额最大的列表中取出一个词
+// 并计算其概率（阈值算法）。高阶次数不超过低阶次数，尚未取出的词在各阶的次数不超过该阶下一个词
+// 的次数，各阶份额之和就是它们的概率上限；已有num_predictions个候选词超过上限即可停止，
+// 通常只需计算比num_predictions稍多几个词。
+// 各阶只取前TOP_K_SUCCESSORS（或num_predictions）个后继词，候选词的次数也先在其中查找；
+// 取完仍无法确定上限时停止，结果不足时用一元排名补足。
+//
+// 结果写入ranked；candidates和ranked可跨调用复用，不分配内存。
+// 返回用到的最高阶数（同BackoffChain::highest_order），上下文为空时返回0
+template<typename Model>
+int predict_word_ids(const Model &model, const std::vector<WordId> &words, int num_predictions,
+                      CandidateTable &candidates, std::vector<std::pair<WordId, double>> &ranked) {
+
+    ranked.clear();
+    if (num_predictions <= 0) return 0;
+
+    // 如果没有上下文，返回最常见的词
+    if (words.empty()) {
+        int total = model.total_words() > 0 ? model.total_words() : 1;
+        for (size_t i = 0; i < model.vocabulary_size() && i < (size_t) num_predictions; ++i) {
+            WordId id = model.unigram_at(i);
+            ranked.emplace_back(id, static_cast<double>(model.word_count(id)) / total);
+        }
+        return 0;
+    }
+
+    BackoffChain<Model> chain(model, words);
+    candidates.clear();
+    auto &entries = candidates.entries();
+    auto by_score = [](const auto &a, const auto &b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    };
+
+    // 各阶后继词依次存放在ranked中，第i阶为[begin[i], end[i])，下一个取出的是next[i]
+    const int orders = chain.size();
+    const size_t k = num_predictions;
+    const size_t limit = std::max(k, (size_t) TOP_K_SUCCESSORS);
+    size_t begin[BackoffChain<Model>::MAX_CONTEXTS];
+    size_t next[BackoffChain<Model>::MAX_CONTEXTS];
+    size_t end[BackoffChain<Model>::MAX_CONTEXTS];
+    bool complete[BackoffChain<Model>::MAX_CONTEXTS];
+    double shares[BackoffChain<Model>::MAX_CONTEXTS];
+    for (int i = 0; i < orders; ++i) {
+        begin[i] = next[i] = ranked.size();
+        chain.context(i).for_each_ranked(limit, [&ranked](WordId word, int count) {
+            ranked.emplace_back(word, count);
+        });
+        // 叠加模型回调的顺序不固定，同一个词也可能出现两次
+        auto first = ranked.begin() + begin[i];
+        if (!std::is_sorted(first, ranked.end(), by_score)) {
+            std::sort(first, ranked.end(), by_score);
+        }
+        ranked.erase(std::unique(first, ranked.end(), [](const auto &a, const auto &b) {
+            return a.first == b.first;
+        }), ranked.end());
+
+        // 超出limit的部分不保证是按次数排列的前几名，不作为上限；
+        // 只有不超过limit时才算取完，各种模型的结果因此一致
+        size_t size = ranked.size() - begin[i];
+        end[i] = begin[i] + std::min(size, limit);
+        complete[i] = size <= limit && size >= chain.context(i).size();
+    }
+
+    auto add = [&](WordId word) {
+        auto result = candidates.try_emplace(word);
+        if (!result.second) return;
+        *result.first = chain.probability(word, [&](int i) {
+            auto last = ranked.begin() + (i + 1 < orders ? begin[i + 1] : ranked.size());
+            for (auto it = ranked.begin() + begin[i]; it != last; ++it) {
+                if (it->first == word) return (int) it->second;
+            }
+            return complete[i] ? 0 : chain.context(i).count_of(word);
+        });
+    };
+
+    const size_t vocab_size = model.vocabulary_size();
+    size_t next_unigram = 0;
+    bool bounded = true;
+    for (;;) {
+        // 尚未取出的词的概率上限，从最低阶向上累计次数上限
+        double unigram_share = next_unigram < vocab_size
+                               ? chain.unigram(model.word_count(model.unigram_at(next_unigram)))
+                               : 0.0;
+        double bound = unigram_share;
+        double cap = INT_MAX;
+        for (int i = orders - 1; i >= 0; --i) {
+            if (next[i] < end[i]) {
+                cap = std::min(cap, ranked[next[i]].second);
+                shares[i] = chain.discounted(i, (int) ranked[next[i]].second);
+            } else {
+                // 取完的列表若不完整，剩下的词次数未知
+                if (!complete[i]) bounded = false;
+                cap = 0;
+                shares[i] = 0.0;
+            }
+            bound += chain.discounted(i, (int) cap);
+        }
+        if (!bounded) break;
+
+        size_t above = 0;
+        for (const auto &entry: entries) {
+            if (entry.second > bound) ++above;
+        }
+        if (above >= k) break;
+
+        // 从份额最大的列表取下一个词
+        int best = -1;
+        double best_share = unigram_share;
+        for (int i = 0; i < orders; ++i) {
+            if (shares[i] > best_share) {
+                best = i;
+                best_share = shares[i];
+            }
+        }
+        if (best >= 0) {
+            add(ranked[next[best]++].first);
+        } else if (next_unigram < vocab_size) {
+            add(model.unigram_at(next_unigram++));
+        } else {
+            break;
+        }
+    }
+
+    // 上限无效时候选词可能不够，用一元排名补足
+    for (size_t i = 0; i < vocab_size && entries.size() < k; ++i) {
+        add(model.unigram_at(i));
+    }
+
+    // 只需部分排序出前num_predictions个结果
+    ranked.assign(entries.begin(), entries.end());
+    size_t top = std::min(ranked.size(), k);
+    std::partial_sort(ranked.begin(), ranked.begin() + top, ranked.end(), by_score);
+    ranked.resize(top);
+    return chain.highest_order();
+}
+
+// 只对上下文最后n-1个词分词并查找ID，结果写入scratch.ids。
+// Model需提供order()和find_word(std::string_view)
+template<typename Model>
+void lookup_tail_ids(const Model &model, std::string_view context, PredictScratch &scratch) {
+    tokenize_tail(context, std::max(model.order() - 1, 0), scratch);
+    scratch.ids.clear();
+    for (std::string_view word: scratch.words) {
+        scratch.ids.push_back(model.find_word(word));
+    }
+}
+
+// 按已查好的单词ID预测，结果写入out。Model另需提供word(WordId)，返回以'\0'结尾的存储
+template<typename Model>
+void predict_id_views(const Model &model, const std::vector<WordId> &words, int num_predictions,
+                      PredictScratch &scratch, std::vector<PredictionView> &out) {
+    scratch.hit_order = predict_word_ids(model, words, num_predictions, scratch.candidates,
+                                         scratch.ranked);
+
+    out.clear();
+    for (const auto &entry: scratch.ranked) {
+        out.emplace_back(model.word(entry.first), entry.second);
+    }
+}
+
+// 分词、查找单词ID并预测
+template<typename Model>
+void predict_word_views(const Model &model, std::string_view context, int num_predictions,
+                        PredictScratch &scratch, std::vector<PredictionView> &out) {
+    lookup_tail_ids(model, context, scratch);
+    predict_id_views(model, scratch.ids, num_predictions, scratch, out);
+}
+
+inline std::vector<std::pair<std::string, double>> to_string_results(
+        const std::vector<PredictionView> &views) {
+    std::vector<std::pair<std::string, double>> result;
+    result.reserve(views.size());
+    for (const auto &entry: views) {
+        result.emplace_back(std::string(entry.first), entry.second);
+    }
+    return result;
+}
+
+#endif // NGRAM_PREDICT_H
@@ -0,0 +1,105 @@
+#include "ngram_session.h"
+#include "ngram_predict.h"
+
+TypingSession::TypingSession(std::shared_ptr<TextPredictor> predictor)
+        : predictor_(std::move(predictor)),
+          window_capacity_(std::max(predictor_->order() - 1, 1)) {}
+
+void TypingSession::append(std::string_view text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t pos = text_.size();
+    text_.append(text);
+
+    // 只分析新增的字符
+    while (pos < text_.size()) {
+        bool word;
+        size_t length = next_char(text_, pos, word);
+        if (word) {
+            if (word_start_ == NO_WORD) word_start_ = pos;
+        } else if (word_start_ != NO_WORD) {
+            push_word(word_start_, pos);
+            word_start_ = NO_WORD;
+        }
+        pos += length;
+    }
+}
+
+void TypingSession::delete_backward(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t end = text_.size();
+    size_t removed = 0;
+    while (removed < count && end > 0) {
+        bool word;
+        size_t length = previous_char(text_, end, word);
+        end -= length;
+        // 4字节的UTF-8字符在Java中是一个代理对
+        removed += length == 4 ? 2 : 1;
+    }
+    text_.resize(end);
+
+    if (word_start_ != NO_WORD && end >= word_start_) {
+        // 只删除了正在输入的单词中的字符，单词删完时前面一定是分隔符，窗口不变
+        if (end == word_start_) word_start_ = NO_WORD;
+        return;
+    }
+    rescan();
+}
+
+void TypingSession::reset(std::string_view text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    text_.assign(text.data(), text.size());
+    rescan();
+}
+
+std::vector<std::pair<std::string, double>> TypingSession::suggest(int num_suggestions) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto snapshot = predictor_->snapshot();
+    if (!snapshot) return {};
+
+    if (snapshot_.lock() != snapshot) {
+        snapshot_ = snapshot;
+        cached_num_ = -1;
+        window_ids_.clear();
+        for (const auto &word: window_) {
+            window_ids_.push_back(snapshot->find_word(word));
+        }
+    }
+
+    if (word_start_ != NO_WORD) {
+        prefix_.resize(text_.size() - word_start_);
+        lower_word(text_.data() + word_start_, prefix_.size(), &prefix_[0]);
+        return snapshot->complete_word(window_ids_, prefix_, num_suggestions);
+    }
+
+    if (cached_num_ != num_suggestions) {
+        auto &views = PredictScratch::local().results;
+        snapshot->predict_views(window_ids_, num_suggestions, views);
+        cached_ = to_string_results(views);
+        cached_num_ = num_suggestions;
+    }
+    return cached_;
+}
+
+void TypingSession::push_word(size_t begin, size_t end) {
+    std::string word(text_, begin, end - begin);
+    lower_word(word.data(), word.size(), &word[0]);
+    window_.push_back(std::move(word));
+    if (window_.size() > window_capacity_) window_.pop_front();
+    invalidate();
+}
+
+void TypingSession::rescan() {
+    size_t start = text_.size();
+    while (start > 0) {
+        bool word;
+        size_t length = previous_char(text_, start, word);
+        if (!word) break;
+        start -= length;
+    }
+    word_start_ = start < text_.size() ? start : NO_WORD;
+
+    auto &scratch = PredictScratch::local();
+    tokenize_tail(std::string_view(text_).substr(0, start), window_capacity_, scratch);
+    window_.assign(scratch.words.begin(), scratch.words.end());
+    invalidate();
+}
@@ -0,0 +1,70 @@
+#ifndef NGRAM_SESSION_H
+#define NGRAM_SESSION_H
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ngram_model.h"
+
+// 输入会话：跟随输入框的编辑增量维护末尾的n-1个完整单词和正在输入的单词。
+// 在末尾输入或删除字符只处理变化的字符，不再对整段文本分词，代价与消息长度无关。
+// 窗口中的单词ID按模型快照缓存，后台训练发布新快照后重新查找一次。
+//
+// 所有公有方法内部加锁，可以从任意线程调用。
+class TypingSession {
+public:
+    explicit TypingSession(std::shared_ptr<TextPredictor> predictor);
+
+    TypingSession(const TypingSession &) = delete;
+
+    TypingSession &operator=(const TypingSession &) = delete;
+
+    // 在末尾追加UTF-8文本（一个或多个字符）
+    void append(std::string_view text);
+
+    // 从末尾删除count个UTF-16代码单元，与Java中的字符数一致
+    void delete_backward(size_t count);
+
+    // 在中间编辑或整体替换文本后重新设置，只分析末尾的几个单词
+    void reset(std::string_view text);
+
+    // 末尾是分隔符时预测下一个词，否则补全正在输入的单词
+    std::vector<std::pair<std::string, double>> suggest(int num_suggestions);
+
+private:
+    static const size_t NO_WORD = SIZE_MAX;
+
+    // text_[begin, end)是刚输入完的单词，移入窗口
+    void push_word(size_t begin, size_t end);
+
+    // 从text_末尾重新确定正在输入的单词和窗口
+    void rescan();
+
+    // 窗口变化后，单词ID和预测缓存都要重新计算
+    void invalidate() {
+        snapshot_.reset();
+        cached_num_ = -1;
+    }
+
+    std::mutex mutex_;
+    std::shared_ptr<TextPredictor> predictor_;
+    const size_t window_capacity_;
+
+    std::string text_;
+    size_t word_start_ = NO_WORD;       // 正在输入的单词在text_中的起点
+    std::deque<std::string> window_;    // 最后n-1个完整单词（小写）
+    std::string prefix_;
+
+    // window_ids_对应的快照，快照被替换或释放后失效
+    std::weak_ptr<const ModelSnapshot> snapshot_;
+    std::vector<WordId> window_ids_;
+
+    // 同一窗口和快照上的下一个词预测
+    int cached_num_ = -1;
+    std::vector<std::pair<std::string, double>> cached_;
+};
+
+#endif // NGRAM_SESSION_H
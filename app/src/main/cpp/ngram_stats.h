@@ -0,0 +1,150 @@
+#ifndef NGRAM_STATS_H
+#define NGRAM_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// 运行统计：计数器和固定分桶的延迟直方图。预测路径上只有几次relaxed原子加法，
+// 不加锁也不分配内存；读取时各项之间不保证相互一致。
+
+// 直方图桶数：第0个桶为不到1微秒，第i个桶为[2^(i-1), 2^i)微秒，最后一个桶没有上限（约4.2秒以上）
+const int LATENCY_BUCKETS = 24;
+
+// 单独统计命中次数的最高阶数，更高阶的命中计入这一阶
+const int STATS_MAX_ORDER = 8;
+
+class LatencyHistogram {
+public:
+    void record(uint64_t micros) {
+        buckets_[bucket_of(micros)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        total_micros_.fetch_add(micros, std::memory_order_relaxed);
+    }
+
+    static int bucket_of(uint64_t micros) {
+        if (micros == 0) return 0;
+        int bits = 64 - __builtin_clzll(micros);
+        return bits < LATENCY_BUCKETS ? bits : LATENCY_BUCKETS - 1;
+    }
+
+    // 依次写出次数、总微秒数和各桶次数，共2 + LATENCY_BUCKETS项
+    void export_to(int64_t *out) const {
+        out[0] = (int64_t) count_.load(std::memory_order_relaxed);
+        out[1] = (int64_t) total_micros_.load(std::memory_order_relaxed);
+        for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+            out[2 + i] = (int64_t) buckets_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[LATENCY_BUCKETS] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> total_micros_{0};
+};
+
+// 作用域结束时把经过的时间记入直方图，histogram为空时不计时
+class ScopedLatency {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ScopedLatency(LatencyHistogram *histogram)
+            : histogram_(histogram), start_(histogram ? Clock::now() : Clock::time_point()) {}
+
+    ~ScopedLatency() {
+        if (!histogram_) return;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start_);
+        histogram_->record((uint64_t) elapsed.count());
+    }
+
+    ScopedLatency(const ScopedLatency &) = delete;
+
+    ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+private:
+    LatencyHistogram *histogram_;
+    Clock::time_point start_;
+};
+
+enum StatsHistogram {
+    STATS_PREDICT = 0,      // 下一个词预测（ModelSnapshot::predict_views）
+    STATS_COMPLETE,         // 单词补全
+    STATS_TRAINING,         // 一轮后台历史训练，含保存和发布
+    STATS_CORPUS_TRAINING,  // 语料训练，含保存和发布
+    STATS_SAVE,             // 合并日志并完整保存
+    STATS_HISTOGRAM_COUNT
+};
+
+enum StatsCounter {
+    STATS_TRAINING_FAILURES = 0,  // 保存失败的训练轮次
+    STATS_PRUNES,                 // 剪枝次数（自动和手动）
+    STATS_SNAPSHOTS,              // 发布的模型快照数
+    STATS_COUNTER_COUNT
+};
+
+// 导出数组的布局（TextPredictor::get_stats和JNI getStats相同），新增字段只追加在末尾：
+//   [0]                          STATS_FORMAT_VERSION
+//   [1]                          当前快照的模型阶数，没有模型时为0
+//   [2]                          词汇表大小
+//   [STATS_HITS_INDEX + k]       预测和补全用到的最高阶数为k的次数（k <= STATS_MAX_ORDER）：
+//                                k为1表示没有命中任何上下文、只用一元概率，0表示上下文为空
+//   [STATS_CONTEXTS_INDEX + k]   第k阶的上下文数（k >= 2）
+//   [STATS_NGRAMS_INDEX + k]     第k阶的n元语法数（k >= 2）
+//   [STATS_COUNTERS_INDEX + c]   StatsCounter计数
+//   [STATS_HISTOGRAMS_INDEX + h * HISTOGRAM_FIELDS + i]
+//                                StatsHistogram直方图h：i为0是次数，1是总微秒数，2起为各桶次数
+//   [STATS_MEMORY_INDEX]         堆内存合计（字节），见ModelMemory
+//   [STATS_MEMORY_INDEX + 1]     冻结文件的映射大小
+//   [STATS_MEMORY_INDEX + 2]     其中单词和一元计数占用的堆内存
+//   [STATS_ORDER_HEAP_INDEX + k]    第k阶占用的堆内存（k >= 2）
+//   [STATS_ORDER_MAPPED_INDEX + k]  第k阶在冻结文件中的字节数（k >= 2）
+// 叠加日志的快照中，规模按基础模型和增量分别统计后相加，与基础模型重复的项会重复计算
+const int STATS_FORMAT_VERSION = 1;
+const int STATS_HITS_INDEX = 3;
+const int STATS_CONTEXTS_INDEX = STATS_HITS_INDEX + STATS_MAX_ORDER + 1;
+const int STATS_NGRAMS_INDEX = STATS_CONTEXTS_INDEX + STATS_MAX_ORDER + 1;
+const int STATS_COUNTERS_INDEX = STATS_NGRAMS_INDEX + STATS_MAX_ORDER + 1;
+const int STATS_HISTOGRAMS_INDEX = STATS_COUNTERS_INDEX + STATS_COUNTER_COUNT;
+const int HISTOGRAM_FIELDS = 2 + LATENCY_BUCKETS;
+const int STATS_MEMORY_INDEX = STATS_HISTOGRAMS_INDEX + STATS_HISTOGRAM_COUNT * HISTOGRAM_FIELDS;
+const int STATS_ORDER_HEAP_INDEX = STATS_MEMORY_INDEX + 3;
+const int STATS_ORDER_MAPPED_INDEX = STATS_ORDER_HEAP_INDEX + STATS_MAX_ORDER + 1;
+const int STATS_SIZE = STATS_ORDER_MAPPED_INDEX + STATS_MAX_ORDER + 1;
+
+using StatsArray = std::array<int64_t, STATS_SIZE>;
+
+// 预测器的运行统计，由TextPredictor持有并共享给它发布的快照
+class PredictorStats {
+public:
+    void record_hit(int order) {
+        int index = order < 0 ? 0 : (order > STATS_MAX_ORDER ? STATS_MAX_ORDER : order);
+        hits_[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void increment(StatsCounter counter) {
+        counters_[counter].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    LatencyHistogram &histogram(StatsHistogram histogram) { return histograms_[histogram]; }
+
+    // 写出命中次数、计数器和直方图，模型规模由调用方填写
+    void export_to(StatsArray &out) const {
+        for (int k = 0; k <= STATS_MAX_ORDER; ++k) {
+            out[STATS_HITS_INDEX + k] = (int64_t) hits_[k].load(std::memory_order_relaxed);
+        }
+        for (int c = 0; c < STATS_COUNTER_COUNT; ++c) {
+            out[STATS_COUNTERS_INDEX + c] = (int64_t) counters_[c].load(std::memory_order_relaxed);
+        }
+        for (int h = 0; h < STATS_HISTOGRAM_COUNT; ++h) {
+            histograms_[h].export_to(&out[STATS_HISTOGRAMS_INDEX + h * HISTOGRAM_FIELDS]);
+        }
+    }
+
+private:
+    std::atomic<uint64_t> hits_[STATS_MAX_ORDER + 1] = {};
+    std::atomic<uint64_t> counters_[STATS_COUNTER_COUNT] = {};
+    LatencyHistogram histograms_[STATS_HISTOGRAM_COUNT];
+};
+
+#endif // NGRAM_STATS_H
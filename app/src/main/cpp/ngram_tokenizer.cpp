@@ -0,0 +1,290 @@
+#include "ngram_tokenizer.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NGRAM_TOKENIZER_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NGRAM_TOKENIZER_SSE2 1
+#endif
+
+namespace {
+
+const uint32_t INVALID_CODE_POINT = UINT32_MAX;
+
+const size_t BLOCK_SIZE = 16;
+
+// 处理16字节：out写入转为小写后的字节，返回ASCII单词字符的位掩码，
+// non_ascii返回非ASCII字节的位掩码（这些位置的输出和单词位无意义，由调用方逐字符处理）。
+// 目标ABI都保证支持对应的指令集（arm64/armv7 NEON，x86/x86_64 SSE2），按编译目标选择实现
+#if defined(NGRAM_TOKENIZER_NEON)
+
+inline uint32_t movemask(uint8x16_t mask) {
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t masked = vandq_u8(mask, vld1q_u8(bits));
+#if defined(__aarch64__)
+    return vaddv_u8(vget_low_u8(masked)) | (vaddv_u8(vget_high_u8(masked)) << 8);
+#else
+    uint8x8_t sum = vpadd_u8(vget_low_u8(masked), vget_high_u8(masked));
+    sum = vpadd_u8(sum, sum);
+    sum = vpadd_u8(sum, sum);
+    return vget_lane_u8(sum, 0) | (vget_lane_u8(sum, 1) << 8);
+#endif
+}
+
+inline uint32_t scan_block(const unsigned char *in, char *out, uint32_t &non_ascii) {
+    uint8x16_t v = vld1q_u8(in);
+    // 无符号减法后与区间长度比较，一次完成范围判断
+    uint8x16_t upper = vcleq_u8(vsubq_u8(v, vdupq_n_u8('A')), vdupq_n_u8('Z' - 'A'));
+    uint8x16_t lower = vcleq_u8(vsubq_u8(v, vdupq_n_u8('a')), vdupq_n_u8('z' - 'a'));
+    uint8x16_t digit = vcleq_u8(vsubq_u8(v, vdupq_n_u8('0')), vdupq_n_u8('9' - '0'));
+    uint8x16_t apostrophe = vceqq_u8(v, vdupq_n_u8('\''));
+    uint8x16_t word = vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(digit, apostrophe));
+
+    vst1q_u8(reinterpret_cast<uint8_t *>(out), vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20))));
+    non_ascii = movemask(vcgeq_u8(v, vdupq_n_u8(0x80)));
+    return movemask(word);
+}
+
+#elif defined(NGRAM_TOKENIZER_SSE2)
+
+inline __m128i in_range(__m128i v, char lo, char hi) {
+    // 非ASCII字节按有符号数为负，不会落在任何区间内
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+
+inline uint32_t scan_block(const unsigned char *in, char *out, uint32_t &non_ascii) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+    __m128i upper = in_range(v, 'A', 'Z');
+    __m128i lower = in_range(v, 'a', 'z');
+    __m128i digit = in_range(v, '0', '9');
+    __m128i apostrophe = _mm_cmpeq_epi8(v, _mm_set1_epi8('\''));
+    __m128i word = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, apostrophe));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                     _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+    non_ascii = static_cast<uint32_t>(_mm_movemask_epi8(v));
+    return static_cast<uint32_t>(_mm_movemask_epi8(word));
+}
+
+#else
+
+inline uint32_t scan_block(const unsigned char *in, char *out, uint32_t &non_ascii) {
+    uint32_t word = 0;
+    non_ascii = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        unsigned char c = in[i];
+        out[i] = static_cast<char>(c >= 'A' && c <= 'Z' ? c | 0x20 : c);
+        word |= static_cast<uint32_t>(is_word_char(c)) << i;
+        non_ascii |= static_cast<uint32_t>(c >= 0x80) << i;
+    }
+    return word;
+}
+
+#endif
+
+inline bool is_continuation(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+} // namespace
+
+size_t decode_utf8(const unsigned char *p, size_t size, uint32_t &code_point) {
+    code_point = INVALID_CODE_POINT;
+    if (size == 0) return 0;
+
+    unsigned char c = p[0];
+    if (c < 0x80) {
+        code_point = c;
+        return 1;
+    }
+
+    // 只接受最短编码，拒绝代理区和超出U+10FFFF的码点，保证正向和反向扫描结果一致
+    size_t length;
+    unsigned char min = 0x80, max = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+        if (c == 0xE0) min = 0xA0;
+        if (c == 0xED) max = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+        if (c == 0xF0) min = 0x90;
+        if (c == 0xF4) max = 0x8F;
+    } else {
+        return 1;
+    }
+    if (size < length || p[1] < min || p[1] > max) return 1;
+
+    uint32_t value = c & (0xFF >> (length + 1));
+    for (size_t i = 1; i < length; ++i) {
+        if (!is_continuation(p[i])) return 1;
+        value = (value << 6) | (p[i] & 0x3F);
+    }
+    code_point = value;
+    return length;
+}
+
+bool is_word_code_point(uint32_t cp) {
+    if (cp < 0x80) return is_word_char(static_cast<unsigned char>(cp));
+    // Latin-1：ª µ º 和字母（× ÷ 除外）
+    if (cp < 0xC0) return cp == 0xAA || cp == 0xB5 || cp == 0xBA;
+    if (cp < 0x250) return cp != 0xD7 && cp != 0xF7;
+    // 各种字母文字，排除其中常见的标点
+    if (cp < 0x2000) {
+        switch (cp) {
+            case 0x37E: case 0x387: case 0x589: case 0x5BE: case 0x5C0: case 0x5C3:
+            case 0x60C: case 0x61B: case 0x61F: case 0x6D4: case 0x964: case 0x965:
+                return false;
+            default:
+                return cp < 0x55A || cp > 0x55F;
+        }
+    }
+    if (cp < 0x2C00) return false;                   // 通用标点、货币、箭头、数学符号等
+    if (cp < 0x2E00) return true;                    // 格拉哥里、科普特、格鲁吉亚补充等
+    if (cp < 0x2E80) return false;                   // 补充标点
+    if (cp < 0x3000) return true;                    // 中日韩部首
+    if (cp < 0x3040) return cp >= 0x3005 && cp <= 0x3007;  // 中日韩标点，々〆〇除外
+    if (cp < 0xD800) return true;                    // 假名、注音、中日韩统一表意文字、谚文
+    if (cp < 0xF900) return false;                   // 私用区
+    if (cp < 0xFE00) return true;                    // 兼容表意文字、字母表现形式
+    if (cp < 0xFE70) return false;                   // 变体选择符、竖排和小写形式标点
+    if (cp < 0xFF00) return cp != 0xFEFF;            // 阿拉伯表现形式，BOM除外
+    if (cp < 0xFFF0) {                               // 全角字母数字、半角假名和谚文
+        return (cp >= 0xFF10 && cp <= 0xFF19) || (cp >= 0xFF21 && cp <= 0xFF3A) ||
+               (cp >= 0xFF41 && cp <= 0xFF5A) || (cp >= 0xFF66 && cp <= 0xFFDC);
+    }
+    if (cp < 0x10000) return false;
+    if (cp < 0x1D000) return true;                   // 古文字、假名补充
+    if (cp < 0x20000) return false;                  // 音乐、数学字母符号、表情
+    return cp < 0x40000;                             // 中日韩扩展区
+}
+
+void lower_word(const char *in, size_t size, char *out) {
+    for (size_t i = 0; i < size; ++i) {
+        auto c = static_cast<unsigned char>(in[i]);
+        if (c >= 'A' && c <= 'Z') {
+            c |= 0x20;
+        } else if (c == 0xC3 && i + 1 < size) {
+            // Latin-1大写字母U+00C0-U+00DE（×除外）与小写字母相差0x20
+            out[i] = static_cast<char>(c);
+            c = static_cast<unsigned char>(in[++i]);
+            if (c >= 0x80 && c <= 0x9E && c != 0x97) c += 0x20;
+        }
+        out[i] = static_cast<char>(c);
+    }
+}
+
+size_t next_char(std::string_view text, size_t begin, bool &word) {
+    uint32_t code_point;
+    size_t length = decode_utf8(reinterpret_cast<const unsigned char *>(text.data()) + begin,
+                                text.size() - begin, code_point);
+    word = code_point != INVALID_CODE_POINT && is_word_code_point(code_point);
+    return length;
+}
+
+size_t previous_char(std::string_view text, size_t end, bool &word) {
+    auto c = static_cast<unsigned char>(text[end - 1]);
+    word = false;
+    if (c < 0x80) {
+        word = is_word_char(c);
+        return 1;
+    }
+
+    // 向前找到首字节，只有恰好解码到end的字符才算数，否则末字节按非法字节处理
+    const auto *data = reinterpret_cast<const unsigned char *>(text.data());
+    size_t limit = std::min<size_t>(end, 4);
+    for (size_t length = 1; length <= limit; ++length) {
+        unsigned char lead = data[end - length];
+        if (is_continuation(lead)) continue;
+
+        uint32_t code_point;
+        if (decode_utf8(data + end - length, length, code_point) == length &&
+            code_point != INVALID_CODE_POINT) {
+            word = is_word_code_point(code_point);
+            return length;
+        }
+        break;
+    }
+    return 1;
+}
+
+void tokenize_text(std::string_view text, TokenBuffer &buffer) {
+    auto &tokens = buffer.tokens;
+    tokens.clear();
+    buffer.text.resize(text.size());
+    if (text.empty()) return;
+
+    const auto *in = reinterpret_cast<const unsigned char *>(text.data());
+    char *out = &buffer.text[0];
+    const size_t size = text.size();
+
+    const size_t NO_TOKEN = SIZE_MAX;
+    size_t start = NO_TOKEN;  // 当前单词的起点
+
+    // 按单词位掩码处理[base, base + count)，状态变化的位置依次是单词的起点和终点
+    auto apply_mask = [&](size_t base, uint32_t word, size_t count) {
+        uint32_t valid = (1u << count) - 1;
+        word &= valid;
+        uint32_t previous = (word << 1) | (start != NO_TOKEN ? 1u : 0u);
+        uint32_t edges = (word ^ previous) & valid;
+        while (edges) {
+            size_t position = base + __builtin_ctz(edges);
+            if (start == NO_TOKEN) {
+                start = position;
+            } else {
+                tokens.emplace_back(out + start, position - start);
+                start = NO_TOKEN;
+            }
+            edges &= edges - 1;
+        }
+    };
+
+    unsigned char tail_in[BLOCK_SIZE];
+    char tail_out[BLOCK_SIZE];
+    size_t i = 0;
+    while (i < size) {
+        uint32_t non_ascii;
+        uint32_t word;
+        size_t count = std::min(size - i, BLOCK_SIZE);
+        if (count == BLOCK_SIZE) {
+            word = scan_block(in + i, out + i, non_ascii);
+        } else {
+            // 末尾不足16字节时用空格补齐
+            memset(tail_in, ' ', BLOCK_SIZE);
+            memcpy(tail_in, in + i, count);
+            word = scan_block(tail_in, tail_out, non_ascii);
+            memcpy(out + i, tail_out, count);
+        }
+
+        // 第一个非ASCII字节之前的部分直接按掩码处理
+        size_t ascii = non_ascii ? __builtin_ctz(non_ascii) : count;
+        apply_mask(i, word, ascii);
+        i += ascii;
+        if (ascii == count) continue;
+
+        // 逐个处理非ASCII字符，之后回到16字节的快速路径
+        uint32_t code_point;
+        size_t length = decode_utf8(in + i, size - i, code_point);
+        bool is_word = code_point != INVALID_CODE_POINT && is_word_code_point(code_point);
+        if (is_word) {
+            if (start == NO_TOKEN) start = i;
+            lower_word(text.data() + i, length, out + i);
+        } else {
+            if (start != NO_TOKEN) {
+                tokens.emplace_back(out + start, i - start);
+                start = NO_TOKEN;
+            }
+            memcpy(out + i, in + i, length);
+        }
+        i += length;
+    }
+
+    if (start != NO_TOKEN) {
+        tokens.emplace_back(out + start, size - start);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef NGRAM_TOKENIZER_H
+#define NGRAM_TOKENIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 分词规则（训练和预测共用）：
+//   单词字符：ASCII字母、数字和撇号，以及is_word_code_point认定为文字的非ASCII字符
+//   其余字符（空白、标点、符号、表情以及非法的UTF-8字节）都是分隔符
+//   ASCII和Latin-1大写字母转为小写，其他字符原样保留，转换前后字节数不变
+//
+// 多字节UTF-8字符总是整体归为单词或分隔符，不会被从中间切开。
+
+// 分词结果，tokens指向text；反复使用时复用容量
+struct TokenBuffer {
+    std::string text;
+    std::vector<std::string_view> tokens;
+};
+
+// 对text分词，结果写入buffer。ASCII部分每次处理16字节（NEON/SSE2，没有时退化为逐字节）
+void tokenize_text(std::string_view text, TokenBuffer &buffer);
+
+// 非ASCII码点是否为文字（字母、表意文字等）
+bool is_word_code_point(uint32_t code_point);
+
+// 解码p处的一个UTF-8字符，返回字节数。非法或不完整的序列返回1，code_point为UINT32_MAX
+size_t decode_utf8(const unsigned char *p, size_t size, uint32_t &code_point);
+
+inline bool is_word_char(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '\'';
+}
+
+// 从begin开始的字符的字节数（begin < text.size()），word返回它是否为单词字符
+size_t next_char(std::string_view text, size_t begin, bool &word);
+
+// text[0, end)中最后一个字符的字节数（end > 0），word返回它是否为单词字符。
+// 与从头向前分词的结果一致，用于只处理上下文末尾的几个词
+size_t previous_char(std::string_view text, size_t end, bool &word);
+
+// 把一段单词字符转为小写写入out（可与in相同），字节数不变
+void lower_word(const char *in, size_t size, char *out);
+
+#endif // NGRAM_TOKENIZER_H
@@ -0,0 +1,420 @@
+// 预测器核心的主机测试：增量日志的重放和截断、崩溃和写入失败后的恢复，
+// 以及并行训练、冻结模型、叠加日志的模型与内存模型之间的一致性。
+// 由ctest运行，任一检查失败时返回非0。
+//
+// 用法: predictor_tests [测试名...]，不指定时运行全部测试
+
+#include "ngram_model.h"
+#include "ngram_predict.h"
+#include "tools/tool_util.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                               \
+        }                                                                             \
+    } while (0)
+
+const std::vector<std::string> &corpus_lines() {
+    static std::vector<std::string> lines;
+    if (lines.empty() && !read_lines(DEFAULT_CORPUS_PATH, lines)) {
+        fprintf(stderr, "cannot open corpus %s\n", DEFAULT_CORPUS_PATH);
+        exit(1);
+    }
+    return lines;
+}
+
+// 语料中[begin, end)行拼接成的一段文本
+std::string corpus_text(size_t begin, size_t end) {
+    const auto &lines = corpus_lines();
+    std::string text;
+    for (size_t i = begin; i < end && i < lines.size(); ++i) {
+        text += lines[i];
+        text += ' ';
+    }
+    return text;
+}
+
+std::string read_file(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// 每个测试使用独立的临时目录，结束时删除其中的文件
+class TempDir {
+public:
+    TempDir() {
+        const char *tmp = getenv("TMPDIR");
+        std::string pattern = std::string(tmp ? tmp : "/tmp") + "/predictor_tests_XXXXXX";
+        std::vector<char> buffer(pattern.begin(), pattern.end());
+        buffer.push_back('\0');
+        if (!mkdtemp(buffer.data())) {
+            perror("mkdtemp");
+            exit(1);
+        }
+        path_ = buffer.data();
+    }
+
+    ~TempDir() { remove_tree(path_); }
+
+    std::string file(const char *name) const { return path_ + "/" + name; }
+
+private:
+    static void remove_tree(const std::string &path) {
+        if (DIR *dir = opendir(path.c_str())) {
+            while (dirent *entry = readdir(dir)) {
+                if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+                std::string child = path + "/" + entry->d_name;
+                struct stat st{};
+                if (lstat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                    remove_tree(child);
+                } else {
+                    unlink(child.c_str());
+                }
+            }
+            closedir(dir);
+        }
+        rmdir(path.c_str());
+    }
+
+    std::string path_;
+};
+
+std::shared_ptr<const FrozenNGramModel> freeze_and_open(const NGramModel &model,
+                                                        const std::string &path) {
+    if (!model.freeze(path)) return nullptr;
+    return FrozenNGramModel::open(path);
+}
+
+// 与TextPredictor后台训练相同：统计增量、追加到日志、合并到累计增量
+bool append_batch(const std::string &journal, const FrozenNGramModel &base,
+                  std::shared_ptr<ModelDelta> &delta, const std::string &text,
+                  size_t *journal_size, int *batch_words = nullptr) {
+    ModelDelta batch = build_model_delta(text, base, *delta);
+    if (batch_words) *batch_words = batch.total_words;
+    if (!append_journal_record(journal, base, batch, journal_size)) return false;
+    auto merged = std::make_shared<ModelDelta>(*delta);
+    if (!merged->merge(batch)) return false;
+    delta = merged;
+    return true;
+}
+
+std::shared_ptr<ModelDelta> empty_delta(const FrozenNGramModel &base) {
+    auto delta = std::make_shared<ModelDelta>();
+    delta->base_vocab_size = static_cast<uint32_t>(base.vocabulary_size());
+    return delta;
+}
+
+// 单词和顺序完全相同，概率相对误差不超过1e-12：核心以-ffast-math编译，
+// 不同模型的打分代码展开不同，概率可能相差最后一位
+bool same_results(const std::vector<std::pair<std::string, double>> &a,
+                  const std::vector<std::pair<std::string, double>> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].first != b[i].first) return false;
+        double scale = std::max(std::fabs(a[i].second), std::fabs(b[i].second));
+        if (std::fabs(a[i].second - b[i].second) > scale * 1e-12) return false;
+    }
+    return true;
+}
+
+// 语料中每隔stride行取一行，每行取前几个词的各个前缀作为上下文（含空上下文）
+std::vector<std::string> sample_contexts(size_t stride) {
+    const auto &lines = corpus_lines();
+    std::vector<std::string> contexts;
+    for (size_t i = 0; i < lines.size(); i += stride) {
+        auto words = NGramModel::preprocess_text(lines[i]);
+        std::string context;
+        for (size_t k = 0; k <= words.size() && k < 5; ++k) {
+            contexts.push_back(context);
+            if (k < words.size()) context += words[k] + " ";
+        }
+    }
+    return contexts;
+}
+
+// 写了一半的尾部记录和校验和不符的记录被丢弃，文件截断到最后一条完整记录之后，之后可以继续追加
+void test_journal_torn_tail() {
+    TempDir dir;
+    NGramModel model(3);
+    model.train(corpus_text(0, 500));
+    auto base = freeze_and_open(model, dir.file("m.frozen"));
+    CHECK(base != nullptr);
+    if (!base) return;
+
+    std::string journal = dir.file("m.journal");
+    CHECK(reset_journal(journal, *base));
+    auto delta = empty_delta(*base);
+    size_t first_end = 0, second_end = 0;
+    int first_words = 0, third_words = 0;
+    CHECK(append_batch(journal, *base, delta, corpus_text(500, 600) + "zzfirstword",
+                       &first_end, &first_words));
+    CHECK(append_batch(journal, *base, delta, corpus_text(600, 700), &second_end));
+    CHECK(second_end > first_end);
+    CHECK(replay_journal(journal, *base)->total_words == delta->total_words);
+
+    // 第二条记录写到一半时进程被杀
+    CHECK(truncate(journal.c_str(), (off_t) (first_end + (second_end - first_end) / 2)) == 0);
+    auto replayed = replay_journal(journal, *base);
+    CHECK(replayed->total_words == first_words);
+    CHECK(replayed->find_new_word("zzfirstword") != INVALID_WORD_ID);
+    CHECK((size_t) file_bytes(journal) == first_end);
+
+    // 截断后继续追加，重放得到第一条和新记录
+    auto continued = replayed;
+    size_t third_end = 0;
+    CHECK(append_batch(journal, *base, continued, corpus_text(700, 800), &third_end,
+                       &third_words));
+    CHECK(replay_journal(journal, *base)->total_words == first_words + third_words);
+
+    // 长度完整但内容损坏的记录同样被丢弃
+    std::string contents = read_file(journal);
+    contents[contents.size() - 1] ^= 0x5A;
+    std::ofstream(journal, std::ios::binary | std::ios::trunc) << contents;
+    CHECK(replay_journal(journal, *base)->total_words == first_words);
+    CHECK((size_t) file_bytes(journal) == first_end);
+}
+
+// 日志属于合并前的旧基础模型时整个作废并重置为新基础模型的空日志
+void test_journal_stale_header() {
+    TempDir dir;
+    NGramModel old_model(3);
+    old_model.train(corpus_text(0, 500));
+    auto old_base = freeze_and_open(old_model, dir.file("old.frozen"));
+    NGramModel new_model(old_model);
+    new_model.train(corpus_text(500, 700));
+    auto new_base = freeze_and_open(new_model, dir.file("new.frozen"));
+    CHECK(old_base != nullptr && new_base != nullptr);
+    if (!old_base || !new_base) return;
+
+    std::string journal = dir.file("m.journal");
+    auto delta = empty_delta(*old_base);
+    size_t size = 0;
+    CHECK(append_batch(journal, *old_base, delta, corpus_text(700, 800), &size));
+    CHECK(replay_journal(journal, *old_base)->total_words == delta->total_words);
+    CHECK(read_journal(journal, old_base->vocabulary_size(), old_base->total_words(),
+                       old_base->order()) != nullptr);
+
+    auto replayed = replay_journal(journal, *new_base);
+    CHECK(replayed->empty());
+    CHECK(replayed->base_vocab_size == new_base->vocabulary_size());
+    CHECK((size_t) file_bytes(journal) == sizeof(JournalHeader));
+    CHECK(read_journal(journal, new_base->vocabulary_size(), new_base->total_words(),
+                       new_base->order()) != nullptr);
+    CHECK(read_journal(journal, old_base->vocabulary_size(), old_base->total_words(),
+                       old_base->order()) == nullptr);
+}
+
+// 保存中途失败（打不开临时文件，相当于磁盘写满）时原来的.bin保持完整
+void test_failed_save_keeps_model() {
+    TempDir dir;
+    std::string path = dir.file("m.bin");
+    NGramModel model(3);
+    model.train(corpus_text(0, 500));
+    CHECK(model.save(path));
+    std::string saved = read_file(path);
+
+    NGramModel bigger(model);
+    bigger.train(corpus_text(500, 1000));
+    CHECK(mkdir((path + ".tmp").c_str(), 0755) == 0);
+    CHECK(!bigger.save(path));
+    CHECK(read_file(path) == saved);
+
+    NGramModel loaded;
+    CHECK(loaded.load(path));
+    CHECK(loaded.total_words() == model.total_words());
+}
+
+// .bin损坏且比冻结文件新时，启动退回到冻结文件和日志，不丢失已训练的内容
+void test_corrupt_model_recovery() {
+    TempDir dir;
+    std::string path = dir.file("m.bin");
+    std::vector<std::string> samples(corpus_lines().begin(), corpus_lines().begin() + 500);
+    const std::vector<std::string> contexts = {"", "i", "i am", "what is the"};
+    auto predict_all = [&](TextPredictor &predictor) {
+        std::vector<std::vector<std::pair<std::string, double>>> results;
+        for (const auto &context: contexts) results.push_back(predictor.predict(context, 5));
+        return results;
+    };
+    auto total_words = [](TextPredictor &predictor) {
+        auto snapshot = predictor.snapshot();
+        return snapshot ? snapshot->summary().total_words : 0;
+    };
+
+    int trained_words;
+    std::vector<std::vector<std::pair<std::string, double>>> expected;
+    {
+        TextPredictor predictor(path, 3, &samples);
+        for (size_t i = 500; i < 600; ++i) predictor.add_to_history(corpus_lines()[i]);
+        CHECK(predictor.force_training());
+        trained_words = total_words(predictor);
+        expected = predict_all(predictor);
+    }
+    CHECK(trained_words > 0);
+    CHECK(file_bytes(path + ".journal") > (long) sizeof(JournalHeader));
+
+    // 合并写到一半：.bin被截断并且比冻结文件新
+    CHECK(truncate(path.c_str(), file_bytes(path) / 2) == 0);
+    struct timeval later[2];
+    gettimeofday(&later[0], nullptr);
+    later[0].tv_sec += 10;
+    later[1] = later[0];
+    CHECK(utimes(path.c_str(), later) == 0);
+
+    {
+        TextPredictor predictor(path, 3);
+        CHECK(total_words(predictor) == trained_words);
+        CHECK(predict_all(predictor) == expected);
+
+        // 恢复后的训练继续写日志，不覆盖冻结文件
+        for (size_t i = 600; i < 700; ++i) predictor.add_to_history(corpus_lines()[i]);
+        CHECK(predictor.force_training());
+        CHECK(total_words(predictor) > trained_words);
+        trained_words = total_words(predictor);
+        expected = predict_all(predictor);
+    }
+    {
+        TextPredictor predictor(path, 3);
+        CHECK(total_words(predictor) == trained_words);
+        CHECK(predict_all(predictor) == expected);
+    }
+}
+
+// 并行统计语料与单线程得到相同的模型文件
+void test_parallel_training() {
+    TempDir dir;
+    NGramModel serial(3), parallel(3);
+    CHECK(serial.train_corpus(DEFAULT_CORPUS_PATH, 1) > 0);
+    CHECK(parallel.train_corpus(DEFAULT_CORPUS_PATH, 4) > 0);
+    CHECK(serial.save(dir.file("serial.bin")));
+    CHECK(parallel.save(dir.file("parallel.bin")));
+    std::string serial_bytes = read_file(dir.file("serial.bin"));
+    CHECK(!serial_bytes.empty());
+    CHECK(serial_bytes == read_file(dir.file("parallel.bin")));
+}
+
+// 冻结模型、冻结模型叠加日志增量和对应的内存模型给出完全相同的预测和补全
+void test_model_parity() {
+    TempDir dir;
+    const auto &lines = corpus_lines();
+    size_t split = lines.size() * 9 / 10;
+    NGramModel model(3);
+    for (size_t i = 0; i < split; ++i) model.train(lines[i]);
+    auto base = freeze_and_open(model, dir.file("m.frozen"));
+    CHECK(base != nullptr);
+    if (!base) return;
+
+    // 剩余语料分几批写入日志，内存模型训练同样的文本
+    NGramModel merged(model);
+    std::string journal = dir.file("m.journal");
+    CHECK(reset_journal(journal, *base));
+    auto delta = empty_delta(*base);
+    size_t batch_lines = (lines.size() - split + 3) / 4;
+    for (size_t begin = split; begin < lines.size(); begin += batch_lines) {
+        std::string text = corpus_text(begin, begin + batch_lines);
+        merged.train(text);
+        size_t size = 0;
+        CHECK(append_batch(journal, *base, delta, text, &size));
+    }
+    OverlayNGramModel overlay(base, replay_journal(journal, *base));
+
+    PrefixIndex memory_index = model.build_prefix_index();
+    PrefixIndex frozen_index = base->build_prefix_index();
+    int frozen_mismatches = 0, overlay_mismatches = 0, completion_mismatches = 0;
+    for (const auto &context: sample_contexts(97)) {
+        for (int count: {3, 20}) {
+            if (!same_results(base->predict_next_word(context, count),
+                              model.predict_next_word(context, count))) {
+                ++frozen_mismatches;
+            }
+            if (!same_results(overlay.predict_next_word(context, count),
+                              merged.predict_next_word(context, count))) {
+                ++overlay_mismatches;
+            }
+        }
+
+        // 与ModelSnapshot::complete_word相同，只取上下文末尾的词
+        auto &scratch = PredictScratch::local();
+        lookup_tail_ids(model, context, scratch);
+        std::vector<WordId> memory_ids = scratch.ids;
+        lookup_tail_ids(*base, context, scratch);
+        std::vector<WordId> frozen_ids = scratch.ids;
+        for (const char *prefix: {"a", "th", "wh"}) {
+            if (!same_results(base->complete_word(frozen_ids, prefix, frozen_index, 5),
+                              model.complete_word(memory_ids, prefix, memory_index, 5))) {
+                ++completion_mismatches;
+            }
+        }
+    }
+    CHECK(frozen_mismatches == 0);
+    CHECK(overlay_mismatches == 0);
+    CHECK(completion_mismatches == 0);
+
+    // 合并日志得到的模型与直接训练的模型逐字节相同
+    NGramModel compacted;
+    compacted.load_frozen(*base);
+    CHECK(compacted.apply_delta(*delta));
+    CHECK(compacted.save(dir.file("compacted.bin")));
+    CHECK(merged.save(dir.file("merged.bin")));
+    CHECK(read_file(dir.file("compacted.bin")) == read_file(dir.file("merged.bin")));
+}
+
+struct TestCase {
+    const char *name;
+    void (*run)();
+};
+
+const TestCase TESTS[] = {
+        {"journal_torn_tail",       test_journal_torn_tail},
+        {"journal_stale_header",    test_journal_stale_header},
+        {"failed_save_keeps_model", test_failed_save_keeps_model},
+        {"corrupt_model_recovery",  test_corrupt_model_recovery},
+        {"parallel_training",       test_parallel_training},
+        {"model_parity",            test_model_parity},
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    // 测试会有意制造损坏的文件，相应的警告不输出
+    JniLog::isEnableLogging(false);
+
+    int ran = 0;
+    for (const auto &test: TESTS) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            if (strcmp(argv[i], test.name) == 0) selected = true;
+        }
+        if (!selected) continue;
+
+        int before = failures;
+        auto start = Clock::now();
+        test.run();
+        printf("%s %s (%.2fs)\n", failures == before ? "PASS" : "FAIL", test.name,
+               seconds_since(start));
+        ++ran;
+    }
+    if (ran == 0) {
+        fprintf(stderr, "no matching tests\n");
+        return 2;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+// 预测器核心的基准测试：训练吞吐量、predict_next_word延迟分布、模型保存/加载耗时、
+// 冻结模型的打开耗时（应用冷启动的路径）和峰值内存。默认阶数与应用相同。
+// 结果以一个JSON对象输出到标准输出（或--output指定的文件），便于在不同提交之间比较。
+//
+// 用法: ngram_benchmark [--corpus PATH] [--order N] [--contexts N] [--repeat N]
+//                       [--threads N] [--output PATH]
+
+#include "ngram_model.h"
+#include "tool_util.h"
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string corpus = DEFAULT_CORPUS_PATH;
+    std::string output;
+    int order = 3;
+    size_t contexts = 20000;
+    int repeat = 3;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+void usage(const char *program) {
+    fprintf(stderr, "usage: %s [--corpus PATH] [--order N] [--contexts N] [--repeat N] "
+                    "[--threads N] [--output PATH]\n", program);
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return false;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "--corpus") == 0) {
+            options.corpus = value;
+        } else if (strcmp(arg, "--output") == 0) {
+            options.output = value;
+        } else if (strcmp(arg, "--order") == 0) {
+            options.order = atoi(value);
+        } else if (strcmp(arg, "--contexts") == 0) {
+            options.contexts = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--repeat") == 0) {
+            options.repeat = atoi(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options.threads = atoi(value);
+        } else {
+            usage(argv[0]);
+            return false;
+        }
+    }
+    if (options.order < 2 || options.repeat < 1 || options.threads < 1 || options.contexts == 0) {
+        usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+// 从语料中抽取输入过程中的上下文：随机一行在随机位置截断，保留前面的若干个词
+std::vector<std::string> sample_contexts(const std::vector<std::string> &lines, size_t count) {
+    std::mt19937 rng(20240611);
+    std::vector<std::string> contexts;
+    contexts.reserve(count);
+    for (size_t attempt = 0; contexts.size() < count && attempt < count * 4; ++attempt) {
+        auto words = NGramModel::preprocess_text(lines[rng() % lines.size()]);
+        if (words.size() < 2) continue;
+        size_t cut = 1 + rng() % (words.size() - 1);
+        std::string context;
+        for (size_t i = 0; i < cut; ++i) {
+            if (i > 0) context += ' ';
+            context += words[i];
+        }
+        contexts.push_back(std::move(context));
+    }
+    return contexts;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) return 2;
+    JniLog::setSink(warning_sink);
+
+    std::vector<std::string> lines;
+    if (!read_lines(options.corpus, lines)) {
+        fprintf(stderr, "cannot open corpus %s\n", options.corpus.c_str());
+        return 1;
+    }
+    if (lines.empty()) {
+        fprintf(stderr, "corpus %s is empty\n", options.corpus.c_str());
+        return 1;
+    }
+
+    // 1. 逐行训练
+    NGramModel model(options.order);
+    auto start = Clock::now();
+    for (const auto &line: lines) {
+        model.train(line);
+    }
+    double train_seconds = seconds_since(start);
+    int words = model.total_words();
+
+    // 2. 多线程训练整个语料文件，计时后立即释放，峰值内存只包含一个模型
+    double batch_seconds;
+    int batch_words;
+    {
+        NGramModel batch_model(options.order);
+        start = Clock::now();
+        batch_model.train_corpus(options.corpus, options.threads);
+        batch_seconds = seconds_since(start);
+        batch_words = batch_model.total_words();
+    }
+
+    // 3. 预测延迟，先完整预热一遍
+    auto contexts = sample_contexts(lines, options.contexts);
+    size_t checksum = 0;
+    for (const auto &context: contexts) {
+        checksum += model.predict_next_word(context, 5).size();
+    }
+    LatencySamples latencies;
+    for (int r = 0; r < options.repeat; ++r) {
+        for (const auto &context: contexts) {
+            auto begin = Clock::now();
+            auto predictions = model.predict_next_word(context, 5);
+            latencies.add(micros_since(begin));
+            checksum += predictions.size();
+        }
+    }
+
+    // 4. 保存和加载，取多次中最快的一次
+    const char *temp_dir = getenv("TMPDIR");
+    std::string model_path = std::string(temp_dir ? temp_dir : "/tmp") +
+                             "/ngram_benchmark_" + std::to_string(getpid()) + ".bin";
+    double save_seconds = 1e9, load_seconds = 1e9;
+    for (int r = 0; r < options.repeat; ++r) {
+        start = Clock::now();
+        bool saved = model.read([&](const NGramModelData &data) {
+            return save_model_data(data, model_path);
+        });
+        if (!saved) {
+            fprintf(stderr, "failed to save model to %s\n", model_path.c_str());
+            return 1;
+        }
+        save_seconds = std::min(save_seconds, seconds_since(start));
+
+        NGramModelData loaded;
+        start = Clock::now();
+        if (!load_model_data(loaded, model_path)) {
+            fprintf(stderr, "failed to load model from %s\n", model_path.c_str());
+            unlink(model_path.c_str());
+            return 1;
+        }
+        load_seconds = std::min(load_seconds, seconds_since(start));
+    }
+    long model_bytes = file_bytes(model_path);
+    unlink(model_path.c_str());
+
+    // 5. 冻结并打开，应用冷启动时只映射冻结文件
+    std::string frozen_path = model_path + ".frozen";
+    start = Clock::now();
+    if (!model.freeze(frozen_path)) {
+        fprintf(stderr, "failed to freeze model to %s\n", frozen_path.c_str());
+        return 1;
+    }
+    double freeze_seconds = seconds_since(start);
+    double frozen_open_seconds = 1e9;
+    for (int r = 0; r < options.repeat; ++r) {
+        start = Clock::now();
+        auto frozen = FrozenNGramModel::open(frozen_path);
+        frozen_open_seconds = std::min(frozen_open_seconds, seconds_since(start));
+        if (!frozen) {
+            fprintf(stderr, "failed to open frozen model %s\n", frozen_path.c_str());
+            unlink(frozen_path.c_str());
+            return 1;
+        }
+    }
+    long frozen_bytes = file_bytes(frozen_path);
+    unlink(frozen_path.c_str());
+
+    ModelMemory memory = model.memory_usage();
+
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    FILE *out = stdout;
+    if (!options.output.empty()) {
+        out = fopen(options.output.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "cannot write %s\n", options.output.c_str());
+            return 1;
+        }
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"order\": %d,\n", options.order);
+    fprintf(out, "  \"corpus_lines\": %zu,\n", lines.size());
+    fprintf(out, "  \"corpus_words\": %d,\n", words);
+    fprintf(out, "  \"vocabulary_size\": %zu,\n", model.vocabulary_size());
+    fprintf(out, "  \"train_seconds\": %.6f,\n", train_seconds);
+    fprintf(out, "  \"train_words_per_second\": %.0f,\n", words / std::max(train_seconds, 1e-9));
+    fprintf(out, "  \"train_corpus_threads\": %d,\n", options.threads);
+    fprintf(out, "  \"train_corpus_seconds\": %.6f,\n", batch_seconds);
+    fprintf(out, "  \"train_corpus_words_per_second\": %.0f,\n",
+            batch_words / std::max(batch_seconds, 1e-9));
+    latencies.write_json_fields(out, "predict");
+    fprintf(out, "  \"predict_checksum\": %zu,\n", checksum);
+    fprintf(out, "  \"model_heap_bytes\": %zu,\n", memory.heap_bytes());
+    fprintf(out, "  \"model_file_bytes\": %ld,\n", model_bytes);
+    fprintf(out, "  \"save_seconds\": %.6f,\n", save_seconds);
+    fprintf(out, "  \"load_seconds\": %.6f,\n", load_seconds);
+    fprintf(out, "  \"frozen_file_bytes\": %ld,\n", frozen_bytes);
+    fprintf(out, "  \"freeze_seconds\": %.6f,\n", freeze_seconds);
+    fprintf(out, "  \"frozen_open_seconds\": %.6f,\n", frozen_open_seconds);
+    fprintf(out, "  \"peak_rss_kb\": %ld\n", usage.ru_maxrss);
+    fprintf(out, "}\n");
+    if (out != stdout) fclose(out);
+    return 0;
+}
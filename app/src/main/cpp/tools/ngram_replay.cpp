@@ -0,0 +1,310 @@
+// 端到端输入回放：把语料末尾的句子当作用户输入，按TextPredictionManager和MainActivity的方式
+// 驱动TextPredictor和TypingSession，统计每次按键到出现候选词的延迟以及节省的按键比例。
+//
+// 流程与应用一致：
+//   1. 首次启动：用语料其余部分通过train_corpus训练（相当于内置语料），设置内存预算
+//   2. 每个字符一次TypingSession::append，文本非空时紧接着suggest
+//   3. 每句输入完后add_to_history提交并清空输入框，达到HISTORY_THRESHOLD时后台训练、保存
+//   4. --force-every大于0时每提交这么多句同步调用一次force_training
+// 界面线程上的调用（按键、提交、强制训练）都计入ui延迟，后台训练造成的锁竞争和快照替换
+// 会体现在长尾中。
+//
+// 节省的按键比例：每个词在第一次出现在候选中时按一次选中（同时输入后面的空格），
+// 节省的按键数为该词剩余的字符数；句首第一个词在输入第一个字符前没有候选。
+// 回放仍然逐字符输入完整的词，之后的候选与选中后相同。
+//
+// 用法: ngram_replay [--corpus PATH] [--order N] [--sentences N] [--holdout-percent N]
+//                    [--suggestions N] [--force-every N] [--memory-budget BYTES]
+//                    [--output PATH]
+
+#include "ngram_model.h"
+#include "ngram_session.h"
+#include "ngram_tokenizer.h"
+#include "tool_util.h"
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// 界面一帧的时间，超过即认为输入卡顿
+const double FRAME_MICROS = 16000.0;
+
+struct Options {
+    std::string corpus = DEFAULT_CORPUS_PATH;
+    std::string output;
+    int order = 3;                  // 与TextPredictionManager一致
+    size_t sentences = 3000;
+    int holdout_percent = 10;       // 语料末尾用于回放的比例，其余用于首次训练
+    int suggestions = 3;            // MainActivity默认的候选数
+    int force_every = 0;
+    size_t memory_budget = 64u * 1024 * 1024;
+};
+
+void usage(const char *program) {
+    fprintf(stderr, "usage: %s [--corpus PATH] [--order N] [--sentences N] [--holdout-percent N] "
+                    "[--suggestions N] [--force-every N] [--memory-budget BYTES] "
+                    "[--output PATH]\n", program);
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return false;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "--corpus") == 0) {
+            options.corpus = value;
+        } else if (strcmp(arg, "--output") == 0) {
+            options.output = value;
+        } else if (strcmp(arg, "--order") == 0) {
+            options.order = atoi(value);
+        } else if (strcmp(arg, "--sentences") == 0) {
+            options.sentences = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--holdout-percent") == 0) {
+            options.holdout_percent = atoi(value);
+        } else if (strcmp(arg, "--suggestions") == 0) {
+            options.suggestions = atoi(value);
+        } else if (strcmp(arg, "--force-every") == 0) {
+            options.force_every = atoi(value);
+        } else if (strcmp(arg, "--memory-budget") == 0) {
+            options.memory_budget = strtoull(value, nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return false;
+        }
+    }
+    if (options.order < 2 || options.holdout_percent < 1 || options.holdout_percent > 99 ||
+        options.suggestions < 1 || options.force_every < 0) {
+        usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+bool contains(const std::vector<std::pair<std::string, double>> &suggestions,
+              const std::string &word) {
+    for (const auto &suggestion: suggestions) {
+        if (suggestion.first == word) return true;
+    }
+    return false;
+}
+
+// UTF-8字符数，即需要的按键数
+size_t char_count(const std::string &word) {
+    size_t count = 0;
+    for (size_t pos = 0; pos < word.size(); ++count) {
+        bool is_word;
+        pos += next_char(word, pos, is_word);
+    }
+    return count;
+}
+
+// 删除工作目录中的模型文件
+void remove_model_files(const std::string &model_path) {
+    for (const char *suffix: {"", ".frozen", ".journal"}) {
+        unlink((model_path + suffix).c_str());
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) return 2;
+    JniLog::setSink(warning_sink);
+
+    std::vector<std::string> lines;
+    if (!read_lines(options.corpus, lines)) {
+        fprintf(stderr, "cannot open corpus %s\n", options.corpus.c_str());
+        return 1;
+    }
+    if (lines.size() < 2) {
+        fprintf(stderr, "corpus %s is too small\n", options.corpus.c_str());
+        return 1;
+    }
+
+    // 回放的句子从第split行开始，之前的字节用于首次训练
+    size_t split = lines.size() - std::max<size_t>(lines.size() * options.holdout_percent / 100, 1);
+    int64_t train_bytes = 0;
+    for (size_t i = 0; i < split; ++i) {
+        train_bytes += lines[i].size() + 1;
+    }
+
+    const char *temp_dir = getenv("TMPDIR");
+    std::string work_dir = std::string(temp_dir ? temp_dir : "/tmp") + "/ngram_replay_XXXXXX";
+    if (!mkdtemp(&work_dir[0])) {
+        fprintf(stderr, "cannot create work directory %s\n", work_dir.c_str());
+        return 1;
+    }
+    std::string model_path = work_dir + "/ngram_model.bin";
+
+    // 1. 首次启动
+    auto start = Clock::now();
+    auto predictor = std::make_shared<TextPredictor>(model_path, options.order);
+    predictor->set_training_threads((int) std::max(1u, std::thread::hardware_concurrency()));
+    int fd = open(options.corpus.c_str(), O_RDONLY);
+    bool trained = fd >= 0 && predictor->train_corpus(fd, 0, train_bytes);
+    if (fd >= 0) close(fd);
+    if (!trained) {
+        fprintf(stderr, "failed to train on %s\n", options.corpus.c_str());
+        predictor.reset();
+        remove_model_files(model_path);
+        rmdir(work_dir.c_str());
+        return 1;
+    }
+    PruneOptions prune_options;
+    prune_options.memory_budget = options.memory_budget;
+    predictor->set_prune_options(prune_options);
+    double startup_seconds = seconds_since(start);
+
+    // 2. 逐字符回放
+    auto session = std::make_shared<TypingSession>(predictor);
+    LatencySamples keystroke, commit, force, ui;
+    size_t sentences = 0, words = 0, keystrokes = 0, saved_keystrokes = 0;
+    size_t next_word_chances = 0, next_word_hits = 0, stalls = 0;
+    std::vector<std::pair<std::string, double>> suggestions;
+    std::string text;
+
+    auto record_ui = [&](LatencySamples &samples, double micros) {
+        samples.add(micros);
+        ui.add(micros);
+        if (micros > FRAME_MICROS) ++stalls;
+    };
+
+    auto replay_start = Clock::now();
+    for (size_t line = split; line < lines.size() && sentences < options.sentences; ++line) {
+        auto tokens = NGramModel::preprocess_text(lines[line]);
+        if (tokens.empty()) continue;
+        ++sentences;
+        text.clear();
+        suggestions.clear();
+
+        for (size_t w = 0; w < tokens.size(); ++w) {
+            const std::string &word = tokens[w];
+            if (w > 0) {
+                // 上一个词后的空格，之后的候选是下一个词的预测
+                auto begin = Clock::now();
+                session->append(" ");
+                text += ' ';
+                suggestions = session->suggest(options.suggestions);
+                record_ui(keystroke, micros_since(begin));
+                ++keystrokes;
+            }
+
+            // 选中候选时连同空格一起输入，句末的词后面没有空格，要扣除选中的一次按键
+            size_t remaining = char_count(word);  // 尚未输入的字符数
+            size_t tap_cost = w + 1 == tokens.size() ? 1 : 0;
+            bool accepted = false;
+            if (w > 0) {
+                ++next_word_chances;
+                if (contains(suggestions, word)) {
+                    ++next_word_hits;
+                    accepted = true;
+                    saved_keystrokes += remaining - tap_cost;
+                }
+            }
+            for (size_t pos = 0; pos < word.size();) {
+                bool is_word;
+                size_t length = next_char(word, pos, is_word);
+                auto begin = Clock::now();
+                session->append(std::string_view(word).substr(pos, length));
+                text.append(word, pos, length);
+                suggestions = session->suggest(options.suggestions);
+                record_ui(keystroke, micros_since(begin));
+                ++keystrokes;
+                pos += length;
+                --remaining;
+
+                if (!accepted && remaining > tap_cost && contains(suggestions, word)) {
+                    accepted = true;
+                    saved_keystrokes += remaining - tap_cost;
+                }
+            }
+        }
+        words += tokens.size();
+
+        // 3. 提交整句并清空输入框
+        auto begin = Clock::now();
+        predictor->add_to_history(text);
+        session->reset("");
+        record_ui(commit, micros_since(begin));
+
+        if (options.force_every > 0 && sentences % options.force_every == 0) {
+            begin = Clock::now();
+            predictor->force_training();
+            record_ui(force, micros_since(begin));
+        }
+    }
+    double replay_seconds = seconds_since(replay_start);
+
+    // 4. 等待排队中的后台训练完成，再完整保存；等待不计入保存时间
+    start = Clock::now();
+    predictor->force_training();
+    double drain_seconds = seconds_since(start);
+    start = Clock::now();
+    bool saved = predictor->save_model();
+    double save_seconds = seconds_since(start);
+    TrainingStatus status = predictor->get_training_status();
+    StatsArray stats = predictor->get_stats();
+    start = Clock::now();
+    session.reset();
+    predictor.reset();
+    double shutdown_seconds = seconds_since(start);
+    remove_model_files(model_path);
+    rmdir(work_dir.c_str());
+
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    FILE *out = stdout;
+    if (!options.output.empty()) {
+        out = fopen(options.output.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "cannot write %s\n", options.output.c_str());
+            return 1;
+        }
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"order\": %d,\n", options.order);
+    fprintf(out, "  \"suggestions\": %d,\n", options.suggestions);
+    fprintf(out, "  \"force_every\": %d,\n", options.force_every);
+    fprintf(out, "  \"startup_seconds\": %.6f,\n", startup_seconds);
+    fprintf(out, "  \"replay_seconds\": %.6f,\n", replay_seconds);
+    fprintf(out, "  \"sentences\": %zu,\n", sentences);
+    fprintf(out, "  \"words\": %zu,\n", words);
+    fprintf(out, "  \"keystrokes\": %zu,\n", keystrokes);
+    fprintf(out, "  \"saved_keystrokes\": %zu,\n", saved_keystrokes);
+    fprintf(out, "  \"keystroke_savings_rate\": %.4f,\n",
+            keystrokes ? (double) saved_keystrokes / keystrokes : 0.0);
+    fprintf(out, "  \"next_word_hit_rate\": %.4f,\n",
+            next_word_chances ? (double) next_word_hits / next_word_chances : 0.0);
+    keystroke.write_json_fields(out, "keystroke");
+    commit.write_json_fields(out, "commit");
+    force.write_json_fields(out, "force_training");
+    ui.write_json_fields(out, "ui");
+    fprintf(out, "  \"ui_stalls_over_16ms\": %zu,\n", stalls);
+    fprintf(out, "  \"training_rounds\": %d,\n", status.completed_rounds);
+    // 预测和补全用到的最高阶数的分布，下标为阶数
+    fprintf(out, "  \"hits_by_order\": [");
+    for (int k = 0; k <= std::min(options.order, STATS_MAX_ORDER); ++k) {
+        fprintf(out, "%s%lld", k > 0 ? ", " : "", (long long) stats[STATS_HITS_INDEX + k]);
+    }
+    fprintf(out, "],\n");
+    fprintf(out, "  \"save_model_ok\": %s,\n", saved ? "true" : "false");
+    fprintf(out, "  \"training_drain_seconds\": %.6f,\n", drain_seconds);
+    fprintf(out, "  \"save_model_seconds\": %.6f,\n", save_seconds);
+    fprintf(out, "  \"shutdown_seconds\": %.6f,\n", shutdown_seconds);
+    fprintf(out, "  \"peak_rss_kb\": %ld\n", usage.ru_maxrss);
+    fprintf(out, "}\n");
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,164 @@
+// 离线模型工具：在主机上训练、剪枝并写出.bin模型，随应用打包到assets中，
+// 首次启动时直接加载，不再在设备上训练语料。
+//
+// 用法:
+//   predictor_cli build --output PATH [--corpus PATH] [--order N] [--smoothing X]
+//                       [--threads N] [--memory-budget BYTES] [--min-count N]
+//   predictor_cli info MODEL
+//   predictor_cli predict MODEL CONTEXT [--count N]
+
+#include "ngram_model.h"
+#include "tool_util.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace {
+
+void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s build --output PATH [--corpus PATH] [--order N] [--smoothing X]\n"
+            "                  [--threads N] [--memory-budget BYTES] [--min-count N]\n"
+            "       %s info MODEL\n"
+            "       %s predict MODEL CONTEXT [--count N]\n", program, program, program);
+}
+
+void print_model(const NGramModel &model) {
+    ModelFootprint footprint = model.footprint();
+    printf("order: %d\n", model.order());
+    printf("total words: %d\n", model.total_words());
+    printf("vocabulary: %zu\n", model.vocabulary_size());
+    printf("contexts: %zu\n", footprint.contexts);
+    printf("n-grams: %zu\n", footprint.successors);
+    printf("estimated memory: %zu bytes\n", footprint.bytes());
+
+    ModelMemory memory = model.memory_usage();
+    printf("heap memory: %zu bytes (strings %zu, vocabulary %zu, unigrams %zu)\n",
+           memory.heap_bytes(), memory.string_bytes, memory.vocabulary_bytes, memory.unigram_bytes);
+    for (size_t k = 2; k < memory.orders.size(); ++k) {
+        const OrderMemory &order = memory.orders[k];
+        printf("  order %zu: %zu contexts, %zu n-grams, %zu bytes "
+               "(entries %zu, keys %zu, slots %zu, successors %zu, top %zu, pool overhead %zu)\n",
+               k, order.contexts, order.ngrams, order.heap_bytes(), order.entry_bytes,
+               order.key_bytes, order.slot_bytes, order.successor_bytes, order.ranked_bytes,
+               order.arena_overhead);
+    }
+}
+
+int build(int argc, char **argv) {
+    std::string corpus = DEFAULT_CORPUS_PATH;
+    std::string output;
+    int order = 3;
+    double smoothing = 0.1;
+    int threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    PruneOptions prune_options;
+    for (int i = 2; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "--corpus") == 0) {
+            corpus = value;
+        } else if (strcmp(arg, "--output") == 0) {
+            output = value;
+        } else if (strcmp(arg, "--order") == 0) {
+            order = atoi(value);
+        } else if (strcmp(arg, "--smoothing") == 0) {
+            smoothing = atof(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            threads = atoi(value);
+        } else if (strcmp(arg, "--memory-budget") == 0) {
+            prune_options.memory_budget = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--min-count") == 0) {
+            prune_options.min_count = atoi(value);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (output.empty() || order < 2 || smoothing <= 0.0 || threads < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    NGramModel model(order, smoothing);
+    auto start = Clock::now();
+    size_t lines = model.train_corpus(corpus, threads);
+    if (model.total_words() <= 0) {
+        fprintf(stderr, "no words trained from %s\n", corpus.c_str());
+        return 1;
+    }
+    printf("trained %zu lines in %.3f s\n", lines, seconds_since(start));
+
+    if (prune_options.memory_budget > 0 || prune_options.min_count > 1) {
+        PruneResult result = model.prune(prune_options);
+        printf("pruned %zu n-grams and %zu contexts, %zu -> %zu bytes\n",
+               result.removed_ngrams, result.removed_contexts,
+               result.bytes_before, result.bytes_after);
+    }
+
+    if (!model.save(output)) {
+        fprintf(stderr, "failed to write %s\n", output.c_str());
+        return 1;
+    }
+
+    // 重新读取一遍，确认写出的文件完整
+    NGramModel loaded;
+    if (!loaded.load(output)) {
+        fprintf(stderr, "failed to read back %s\n", output.c_str());
+        return 1;
+    }
+    printf("wrote %s (format version %u)\n", output.c_str(), MODEL_FILE_VERSION);
+    print_model(loaded);
+    return 0;
+}
+
+int info(int argc, char **argv) {
+    if (argc != 3) {
+        usage(argv[0]);
+        return 2;
+    }
+    NGramModel model;
+    if (!model.load(argv[2])) {
+        fprintf(stderr, "failed to load %s\n", argv[2]);
+        return 1;
+    }
+    print_model(model);
+    return 0;
+}
+
+int predict(int argc, char **argv) {
+    if (argc != 4 && !(argc == 6 && strcmp(argv[4], "--count") == 0)) {
+        usage(argv[0]);
+        return 2;
+    }
+    int count = argc == 6 ? atoi(argv[5]) : 5;
+    NGramModel model;
+    if (!model.load(argv[2])) {
+        fprintf(stderr, "failed to load %s\n", argv[2]);
+        return 1;
+    }
+    for (const auto &prediction: model.predict_next_word(argv[3], count)) {
+        printf("%s\t%.6f\n", prediction.first.c_str(), prediction.second);
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    JniLog::setSink(warning_sink);
+    if (argc < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (strcmp(argv[1], "build") == 0) return build(argc, argv);
+    if (strcmp(argv[1], "info") == 0) return info(argc, argv);
+    if (strcmp(argv[1], "predict") == 0) return predict(argc, argv);
+    usage(argv[0]);
+    return 2;
+}
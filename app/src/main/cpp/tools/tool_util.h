@@ -0,0 +1,104 @@
+#ifndef NGRAM_TOOL_UTIL_H
+#define NGRAM_TOOL_UTIL_H
+
+// 命令行工具共用的计时、统计和日志设置
+
+#include "jni_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef DEFAULT_CORPUS_PATH
+#define DEFAULT_CORPUS_PATH "app/src/main/assets/pod_dataset.txt"
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+inline double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+inline double micros_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// 只输出警告和错误，调试日志在训练和预测时每次调用一条，会淹没结果
+inline void warning_sink(LogLevel level, const char *tag, const char *message) {
+    if (level >= LOG_WARN) JniLog::defaultSink(level, tag, message);
+}
+
+// 按行读取语料，失败时返回false
+inline bool read_lines(const std::string &path, std::vector<std::string> &lines) {
+    std::ifstream in(path);
+    if (!in) return false;
+    for (std::string line; std::getline(in, line);) {
+        lines.push_back(std::move(line));
+    }
+    return true;
+}
+
+// 文件大小（字节），无法打开时为0
+inline long file_bytes(const std::string &path) {
+    long bytes = 0;
+    if (FILE *fp = fopen(path.c_str(), "rb")) {
+        fseek(fp, 0, SEEK_END);
+        bytes = ftell(fp);
+        fclose(fp);
+    }
+    return bytes;
+}
+
+// 一组延迟样本（微秒）
+class LatencySamples {
+public:
+    void add(double micros) {
+        samples_.push_back(micros);
+        sorted_ = false;
+    }
+
+    size_t size() const { return samples_.size(); }
+
+    // 第p百分位（最近秩），没有样本时为0
+    double percentile(double p) {
+        if (samples_.empty()) return 0.0;
+        sort();
+        size_t rank = (size_t) (p / 100.0 * samples_.size() + 0.5);
+        return samples_[std::min(std::max(rank, (size_t) 1), samples_.size()) - 1];
+    }
+
+    double mean() const {
+        double sum = 0.0;
+        for (double sample: samples_) sum += sample;
+        return samples_.empty() ? 0.0 : sum / samples_.size();
+    }
+
+    double max() {
+        sort();
+        return samples_.empty() ? 0.0 : samples_.back();
+    }
+
+    // 以"<name>_count"、"<name>_p50_us"等字段写出，每行以逗号结尾
+    void write_json_fields(FILE *out, const char *name) {
+        fprintf(out, "  \"%s_count\": %zu,\n", name, size());
+        fprintf(out, "  \"%s_mean_us\": %.3f,\n", name, mean());
+        fprintf(out, "  \"%s_p50_us\": %.3f,\n", name, percentile(50));
+        fprintf(out, "  \"%s_p90_us\": %.3f,\n", name, percentile(90));
+        fprintf(out, "  \"%s_p99_us\": %.3f,\n", name, percentile(99));
+        fprintf(out, "  \"%s_p999_us\": %.3f,\n", name, percentile(99.9));
+        fprintf(out, "  \"%s_max_us\": %.3f,\n", name, max());
+    }
+
+private:
+    void sort() {
+        if (!sorted_) std::sort(samples_.begin(), samples_.end());
+        sorted_ = true;
+    }
+
+    std::vector<double> samples_;
+    bool sorted_ = true;
+};
+
+#endif // NGRAM_TOOL_UTIL_H
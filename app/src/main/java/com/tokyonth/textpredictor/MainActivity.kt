@@ -12,6 +12,8 @@ class MainActivity : AppCompatActivity() {
 
     private lateinit var textPredictionManager: TextPredictionManager
 
+    private lateinit var typingSession: TypingSession
+
     private var predictionCount = 3
 
     override fun onCreate(savedInstanceState: Bundle?) {
@@ -28,11 +30,12 @@ class MainActivity : AppCompatActivity() {
             append("\n")
             append(textPredictionManager.getModelInfo())
         }
-        binding.etInput.doOnTextChanged { text, _, _, _ ->
-            if (text?.toString()?.endsWith(" ") == true) {
-                val predictions =
-                    textPredictionManager.predictNextWords(text.toString(), predictionCount)
-                binding.tvPredictor.text = predictions.joinToString(", ")
+        typingSession = textPredictionManager.openSession()
+        binding.etInput.doOnTextChanged { text, start, before, count ->
+            typingSession.onTextChanged(text ?: "", start, before, count)
+            if (!text.isNullOrEmpty()) {
+                binding.tvPredictor.text =
+                    typingSession.suggest(predictionCount).joinToString(", ")
             }
         }
         binding.seekBar.setOnSeekBarChangeListener(object : SeekBar.OnSeekBarChangeListener {
@@ -54,6 +57,7 @@ class MainActivity : AppCompatActivity() {
 
     override fun onDestroy() {
         super.onDestroy()
+        typingSession.close()
         textPredictionManager.destroy()
     }
 
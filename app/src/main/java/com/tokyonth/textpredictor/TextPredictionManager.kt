@@ -2,11 +2,37 @@ package com.tokyonth.textpredictor
 
 import android.content.Context
 import java.io.File
+import java.io.IOException
 
 class TextPredictionManager(
     private val context: Context,
 ) {
 
+    companion object {
+        // 模型估算内存上限。内置的三阶模型估算约17MB（实际堆内存约19MB，见predictor_cli info），
+        // 留出约三倍余量给用户历史的增长，超出后剪枝低频n元语法
+        private const val DEFAULT_MEMORY_BUDGET = 64L * 1024 * 1024
+
+        // 主机上由predictor_cli生成的预训练模型（.bin格式，与ABI无关）
+        private const val PREBUILT_MODEL_ASSET = "ngram_model.bin"
+
+        // getStats数组布局，与ngram_stats.h一致
+        private const val STATS_FORMAT_VERSION = 1L
+        private const val STATS_MAX_ORDER = 8
+        private const val LATENCY_BUCKETS = 24
+        private const val STATS_COUNTER_COUNT = 3
+        private const val STATS_HISTOGRAM_COUNT = 5
+        private const val STATS_HITS_INDEX = 3
+        private const val STATS_CONTEXTS_INDEX = STATS_HITS_INDEX + STATS_MAX_ORDER + 1
+        private const val STATS_NGRAMS_INDEX = STATS_CONTEXTS_INDEX + STATS_MAX_ORDER + 1
+        private const val STATS_COUNTERS_INDEX = STATS_NGRAMS_INDEX + STATS_MAX_ORDER + 1
+        private const val STATS_HISTOGRAMS_INDEX = STATS_COUNTERS_INDEX + STATS_COUNTER_COUNT
+        private const val HISTOGRAM_FIELDS = 2 + LATENCY_BUCKETS
+        private const val STATS_MEMORY_INDEX = STATS_HISTOGRAMS_INDEX + STATS_HISTOGRAM_COUNT * HISTOGRAM_FIELDS
+        private const val STATS_ORDER_HEAP_INDEX = STATS_MEMORY_INDEX + 3
+        private const val STATS_ORDER_MAPPED_INDEX = STATS_ORDER_HEAP_INDEX + STATS_MAX_ORDER + 1
+    }
+
     // 获取模型存储路径（应用私有目录）
     private val modelPath = "${context.filesDir}/ngram_model.bin"
 
@@ -14,18 +40,32 @@ class TextPredictionManager(
     private val predictor: TextPredictorNative
 
     init {
-        val dataSet = if (File(modelPath).exists()) {
-            null
+        predictor = if (File(modelPath).exists() || installPrebuiltModel()) {
+            TextPredictorNative(modelPath, 3)
         } else {
-            getSampleTexts()
+            // 没有预训练模型时才在设备上训练：语料不压缩打包，直接把文件描述符交给native层读取
+            context.assets.openFd("pod_dataset.txt").use {
+                TextPredictorNative(modelPath, 3, it)
+            }
         }
-        predictor = TextPredictorNative(modelPath, 3, dataSet)
+        setMemoryBudget(DEFAULT_MEMORY_BUDGET)
     }
 
-    // 初始化样例文本（用于首次训练）
-    private fun getSampleTexts(): Array<String> {
-        context.assets.open("pod_dataset.txt").use {
-            return it.bufferedReader().readLines().toTypedArray()
+    /**
+     * 首次启动时把预训练模型从assets复制到模型路径，先写临时文件再改名，中途退出不会留下不完整的模型
+     * @return 是否复制成功
+     */
+    private fun installPrebuiltModel(): Boolean {
+        val target = File(modelPath)
+        val temp = File("$modelPath.tmp")
+        return try {
+            context.assets.open(PREBUILT_MODEL_ASSET).use { input ->
+                temp.outputStream().use { output -> input.copyTo(output) }
+            }
+            temp.renameTo(target)
+        } catch (e: IOException) {
+            temp.delete()
+            false
         }
     }
 
@@ -45,9 +85,25 @@ class TextPredictionManager(
      * @return 预测的词及其概率（降序排列）
      */
     fun predictNextWords(context: String, count: Int = 3): List<String> {
+        return predictNextWordsBatch(listOf(context), count).firstOrNull() ?: emptyList()
+    }
+
+    /**
+     * 批量预测多个上下文（例如当前候选栏和预读的下一个位置），只跨越一次JNI
+     * @return 与contexts一一对应的预测结果
+     */
+    fun predictNextWordsBatch(contexts: List<String>, count: Int = 3): List<List<String>> {
+        if (contexts.isEmpty() || count <= 0) return emptyList()
         return try {
-            val predictions = predictor.predict(predictor.predictorId, context, count)
-            predictions.mapNotNull { it.first }
+            val words = predictor.predictBatch(
+                predictor.predictorId,
+                contexts.toTypedArray(),
+                count,
+                null,
+            ) ?: return emptyList()
+            contexts.indices.map { i ->
+                (i * count until (i + 1) * count).mapNotNull { words[it] }
+            }
         } catch (e: Exception) {
             e.printStackTrace()
             emptyList()
@@ -55,12 +111,71 @@ class TextPredictionManager(
     }
 
     /**
-     * 强制立即训练模型（不等待历史记录达到阈值）
+     * 补全正在输入的单词
+     * @param text 当前输入的文本，末尾为尚未输入完的单词
+     * @param count 希望返回的补全数量
+     * @return 以该前缀开头的词（降序排列）
+     */
+    fun completeWord(text: String, count: Int = 3): List<String> {
+        return try {
+            val completions = predictor.completeWord(predictor.predictorId, text, count)
+            completions.mapNotNull { it.first }
+        } catch (e: Exception) {
+            e.printStackTrace()
+            emptyList()
+        }
+    }
+
+    /**
+     * 创建输入会话，按键时只把变化的部分传给native层，使用完毕后需要close
+     */
+    fun openSession(): TypingSession {
+        return TypingSession(predictor, predictor.createSession(predictor.predictorId))
+    }
+
+    /**
+     * 强制立即训练模型（不等待历史记录达到阈值），会阻塞到后台训练完成
      */
     fun forceTrain() {
         predictor.forceTraining(predictor.predictorId)
     }
 
+    /**
+     * 设置模型内存预算，超出时训练后自动剪枝低价值的n元语法
+     * @param minCount 剪枝时删除次数低于此值的n元语法
+     */
+    fun setMemoryBudget(bytes: Long, minCount: Int = 0) {
+        predictor.setPruneOptions(predictor.predictorId, bytes, minCount)
+    }
+
+    /**
+     * 立即剪枝模型（阻塞到完成）
+     * @return 回收的估算字节数
+     */
+    fun pruneModel(): Long {
+        return predictor.pruneModel(predictor.predictorId)
+    }
+
+    /**
+     * 获取后台训练状态
+     */
+    fun getTrainingStatus(): TrainingStatus? {
+        val status = predictor.getTrainingStatus(predictor.predictorId) ?: return null
+        return TrainingStatus(
+            isRunning = status[0] == 1,
+            progress = status[1],
+            completedRounds = status[2],
+            lastSucceeded = status[3] == 1,
+        )
+    }
+
+    /**
+     * 监听后台训练进度，回调发生在native训练线程
+     */
+    fun setTrainingListener(listener: TextPredictorNative.TrainingListener?) {
+        predictor.setTrainingListener(predictor.predictorId, listener)
+    }
+
     /**
      * 清除用户历史记录
      */
@@ -76,7 +191,46 @@ class TextPredictionManager(
     }
 
     /**
-     * 释放资源
+     * 获取运行统计（调试和性能分析用），会遍历模型统计各阶规模
+     */
+    fun getStats(): PredictorStats? {
+        val stats = predictor.getStats(predictor.predictorId) ?: return null
+        if (stats.isEmpty() || stats[0] != STATS_FORMAT_VERSION) return null
+
+        fun orders(begin: Int) = stats.copyOfRange(begin, begin + STATS_MAX_ORDER + 1)
+        fun histogram(index: Int): LatencyHistogram {
+            val begin = STATS_HISTOGRAMS_INDEX + index * HISTOGRAM_FIELDS
+            return LatencyHistogram(
+                count = stats[begin],
+                totalMicros = stats[begin + 1],
+                buckets = stats.copyOfRange(begin + 2, begin + HISTOGRAM_FIELDS),
+            )
+        }
+        return PredictorStats(
+            order = stats[1].toInt(),
+            vocabularySize = stats[2],
+            hitsByOrder = orders(STATS_HITS_INDEX),
+            contextsByOrder = orders(STATS_CONTEXTS_INDEX),
+            ngramsByOrder = orders(STATS_NGRAMS_INDEX),
+            trainingFailures = stats[STATS_COUNTERS_INDEX],
+            prunes = stats[STATS_COUNTERS_INDEX + 1],
+            snapshots = stats[STATS_COUNTERS_INDEX + 2],
+            predict = histogram(0),
+            complete = histogram(1),
+            training = histogram(2),
+            corpusTraining = histogram(3),
+            save = histogram(4),
+            heapBytes = stats[STATS_MEMORY_INDEX],
+            mappedBytes = stats[STATS_MEMORY_INDEX + 1],
+            vocabularyBytes = stats[STATS_MEMORY_INDEX + 2],
+            heapBytesByOrder = orders(STATS_ORDER_HEAP_INDEX),
+            mappedBytesByOrder = orders(STATS_ORDER_MAPPED_INDEX),
+        )
+    }
+
+    /**
+     * 释放资源。立即返回，排队中的历史在后台训练并保存完后才真正释放，可以在主线程调用；
+     * 之后不再回调训练监听器。用同一模型路径重新创建时会等待上一个实例保存完成
      */
     fun destroy() {
         predictor.destroyPredictor(predictor.predictorId)
@@ -86,4 +240,50 @@ class TextPredictionManager(
         predictor.isEnableLogging(isEnable)
     }
 
+    data class TrainingStatus(
+        val isRunning: Boolean,
+        val progress: Int,
+        val completedRounds: Int,
+        val lastSucceeded: Boolean,
+    )
+
+    /**
+     * 延迟直方图：buckets[0]为不到1微秒，buckets[i]为[2^(i-1), 2^i)微秒，最后一个桶没有上限
+     */
+    data class LatencyHistogram(
+        val count: Long,
+        val totalMicros: Long,
+        val buckets: LongArray,
+    ) {
+        val meanMicros: Double
+            get() = if (count > 0) totalMicros.toDouble() / count else 0.0
+    }
+
+    /**
+     * 按阶数索引的数组下标即阶数：hitsByOrder[k]为用到的最高阶数为k的预测和补全次数，
+     * 1表示只用到一元概率，0表示上下文为空；contextsByOrder、ngramsByOrder和各阶内存从二阶起有效。
+     * heapBytes为模型实际占用的堆内存，vocabularyBytes为其中单词和一元计数的部分；
+     * mappedBytes为映射的冻结模型文件大小，不计入堆内存
+     */
+    data class PredictorStats(
+        val order: Int,
+        val vocabularySize: Long,
+        val hitsByOrder: LongArray,
+        val contextsByOrder: LongArray,
+        val ngramsByOrder: LongArray,
+        val trainingFailures: Long,
+        val prunes: Long,
+        val snapshots: Long,
+        val predict: LatencyHistogram,
+        val complete: LatencyHistogram,
+        val training: LatencyHistogram,
+        val corpusTraining: LatencyHistogram,
+        val save: LatencyHistogram,
+        val heapBytes: Long,
+        val mappedBytes: Long,
+        val vocabularyBytes: Long,
+        val heapBytesByOrder: LongArray,
+        val mappedBytesByOrder: LongArray,
+    )
+
 }
@@ -1,11 +1,13 @@
 package com.tokyonth.textpredictor
 
+import android.content.res.AssetFileDescriptor
 import android.util.Pair
+import java.nio.ByteBuffer
 
 class TextPredictorNative @JvmOverloads constructor(
     modelPath: String,
     n: Int = 3,
-    sampleTexts: Array<String>?,
+    corpus: AssetFileDescriptor? = null,
 ) {
 
     companion object {
@@ -17,11 +19,31 @@ class TextPredictorNative @JvmOverloads constructor(
     val predictorId: Long
 
     init {
-        this.predictorId = createPredictor(modelPath, n, sampleTexts)
+        this.predictorId = createPredictorFromFd(
+            modelPath,
+            n,
+            corpus?.parcelFileDescriptor?.fd ?: -1,
+            corpus?.startOffset ?: 0,
+            corpus?.length ?: -1,
+            Runtime.getRuntime().availableProcessors(),
+        )
     }
 
     external fun createPredictor(modelPath: String, n: Int, sampleTexts: Array<String>?): Long
 
+    /**
+     * 由native层直接从文件描述符分块读取语料训练，corpusFd为-1时不训练
+     * @param trainingThreads 语料训练使用的线程数
+     */
+    external fun createPredictorFromFd(
+        modelPath: String,
+        n: Int,
+        corpusFd: Int,
+        corpusOffset: Long,
+        corpusLength: Long,
+        trainingThreads: Int,
+    ): Long
+
     external fun addToHistory(predictorId: Long, text: String)
 
     external fun predict(
@@ -30,14 +52,117 @@ class TextPredictorNative @JvmOverloads constructor(
         numPredictions: Int,
     ): Array<Pair<String, Double>>
 
+    /**
+     * 在同一个模型快照上批量预测多个上下文，不创建Pair和Double对象
+     * @return 第i个上下文的结果位于[i * numPredictions, (i + 1) * numPredictions)，不足的位置为null
+     * @param probabilities 不为null且长度足够时写入对应位置的概率，可在多次调用间复用
+     * @throws IllegalArgumentException contexts.size * numPredictions超过Int.MAX_VALUE
+     */
+    external fun predictBatch(
+        predictorId: Long,
+        contexts: Array<String>,
+        numPredictions: Int,
+        probabilities: DoubleArray?,
+    ): Array<String?>?
+
+    /**
+     * 批量预测并写入direct ByteBuffer（需设置为ByteOrder.nativeOrder()），不创建任何Java对象。
+     * 每个上下文依次为：int 结果数，随后每个结果为 float 概率、int UTF-8字节数、UTF-8字节（补齐到4字节）
+     * @return 写入的字节数；缓冲区不足时返回所需字节数的相反数
+     */
+    external fun predictBatchToBuffer(
+        predictorId: Long,
+        contexts: Array<String>,
+        numPredictions: Int,
+        buffer: ByteBuffer,
+    ): Int
+
+    /**
+     * 补全text末尾正在输入的单词，按前面的上下文加权排序
+     */
+    external fun completeWord(
+        predictorId: Long,
+        text: String,
+        numCompletions: Int,
+    ): Array<Pair<String, Double>>
+
+    /**
+     * 创建输入会话，会话持有预测器的引用，需要用destroySession释放
+     * @return 会话ID，预测器不存在时为0
+     */
+    external fun createSession(predictorId: Long): Long
+
+    /**
+     * 在会话文本末尾追加字符
+     */
+    external fun sessionAppend(sessionId: Long, text: String)
+
+    /**
+     * 从会话文本末尾删除count个字符（UTF-16代码单元）
+     */
+    external fun sessionDeleteBackward(sessionId: Long, count: Int)
+
+    /**
+     * 在中间编辑或整体替换后重新设置会话文本
+     */
+    external fun sessionReset(sessionId: Long, text: String)
+
+    /**
+     * 末尾是分隔符时预测下一个词，否则补全正在输入的单词
+     */
+    external fun sessionSuggest(sessionId: Long, numSuggestions: Int): Array<Pair<String, Double>>?
+
+    external fun destroySession(sessionId: Long)
+
+    /**
+     * 立即训练当前历史，阻塞到后台线程完成本轮训练
+     */
     external fun forceTraining(predictorId: Long): Boolean
 
+    /**
+     * 设置模型内存预算，每轮训练后估算内存超出预算时自动剪枝
+     * @param memoryBudget 估算内存上限（字节），0表示不自动剪枝
+     * @param minCount 剪枝时删除次数低于此值的n元语法
+     */
+    external fun setPruneOptions(predictorId: Long, memoryBudget: Long, minCount: Int)
+
+    /**
+     * 立即按当前选项剪枝并保存模型
+     * @return 回收的估算字节数
+     */
+    external fun pruneModel(predictorId: Long): Long
+
+    /**
+     * @return [状态(0空闲/1训练中), 进度0-100, 已完成轮次, 上一轮是否成功(0/1)]
+     */
+    external fun getTrainingStatus(predictorId: Long): IntArray?
+
+    external fun setTrainingListener(predictorId: Long, listener: TrainingListener?)
+
     external fun clearHistory(predictorId: Long)
 
     external fun getModelInfo(predictorId: Long): String
 
+    /**
+     * 运行统计：各阶命中次数、各阶规模、计数器和延迟直方图，布局见ngram_stats.h。
+     * 需要遍历模型统计规模，不要在输入路径上调用
+     */
+    external fun getStats(predictorId: Long): LongArray?
+
     external fun destroyPredictor(predictorId: Long)
 
     external fun isEnableLogging(isEnable: Boolean)
 
+    /**
+     * 后台训练进度回调，在native训练线程中调用
+     */
+    fun interface TrainingListener {
+        /**
+         * @param progress 当前轮次进度 0-100
+         * @param finished 本轮是否结束
+         * @param success 本轮模型是否保存成功
+         */
+        fun onTrainingProgress(progress: Int, finished: Boolean, success: Boolean)
+    }
+
 }
@@ -0,0 +1,56 @@
+package com.tokyonth.textpredictor
+
+/**
+ * 输入会话：native层增量维护末尾的几个单词，每次按键的开销与文本长度无关
+ */
+class TypingSession internal constructor(
+    private val predictor: TextPredictorNative,
+    private val sessionId: Long,
+) : AutoCloseable {
+
+    /**
+     * 同步一次编辑，参数与TextWatcher.onTextChanged一致。
+     * 编辑发生在末尾时只传递变化的字符，否则整体重新设置
+     */
+    fun onTextChanged(text: CharSequence, start: Int, before: Int, count: Int) {
+        if (start + count == text.length) {
+            if (before > 0) {
+                predictor.sessionDeleteBackward(sessionId, before)
+            }
+            if (count > 0) {
+                predictor.sessionAppend(sessionId, text.substring(start, start + count))
+            }
+        } else {
+            reset(text.toString())
+        }
+    }
+
+    fun append(text: String) {
+        predictor.sessionAppend(sessionId, text)
+    }
+
+    fun deleteBackward(count: Int) {
+        predictor.sessionDeleteBackward(sessionId, count)
+    }
+
+    fun reset(text: String) {
+        predictor.sessionReset(sessionId, text)
+    }
+
+    /**
+     * 文本以分隔符结尾时为下一个词的预测，否则为正在输入的单词的补全
+     */
+    fun suggest(count: Int = 3): List<String> {
+        return try {
+            predictor.sessionSuggest(sessionId, count)?.mapNotNull { it.first } ?: emptyList()
+        } catch (e: Exception) {
+            e.printStackTrace()
+            emptyList()
+        }
+    }
+
+    override fun close() {
+        predictor.destroySession(sessionId)
+    }
+
+}